@@ -0,0 +1,616 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains containers for arrays of fixed-point numbers, with
+ * vectorized elementwise operations.
+ */
+
+#ifndef FIXEDARRAY_H
+#define FIXEDARRAY_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include "fixedpoint/parallel.h"
+#include "fixedpoint/dispatch.h"
+
+// Fwd decl
+template <int I2, int F2, int I, int F>
+Fract<I2,F2> dot(const Fract<I,F>* a, const Fract<I,F>* b, int n);
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FractSpan -- view on a contiguous array of Fract, which it does not own
+//
+// The elementwise operations work in place and go through the batch kernels, so
+// they are vectorized when possible. Each of them takes an overflow policy, which
+// applies to the range of the format (I+F bits, even when the underlying integer is
+// wider): FRACT_OVERFLOW_CHECK reports an overflow error like the scalar operators,
+// FRACT_OVERFLOW_SATURATE clamps to the range, and FRACT_OVERFLOW_WRAP keeps the low
+// I+F bits. Products are rounded toward minus infinity, like Fract::operator*.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class FractSpan
+{
+public:
+    typedef Fract<I,F> VFract;
+
+protected:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::Batch<IntType> Batch;
+    STATIC_ASSERT(sizeof(VFract) == sizeof(IntType), "Fract must be a plain wrapper of its integer");
+
+    VFract* p;
+    int n;
+
+    IntType* raw() const { return reinterpret_cast<IntType*>(p); }
+    static detail::Limits<IntType> limits(FractOverflowPolicy policy)
+    { return detail::Limits<IntType>(I+F, policy); }
+
+public:
+    FractSpan() : p(NULL), n(0) {}
+    FractSpan(VFract* data, int size) : p(data), n(size) {}
+
+    int size() const { return n; }
+    VFract* data() const { return p; }
+    VFract& operator[](int i) const { return p[i]; }
+
+    // View on the count elements starting at begin
+    FractSpan slice(int begin, int count) const
+    {
+        assert(begin >= 0 && count >= 0 && begin + count <= n);
+        return FractSpan(p + begin, count);
+    }
+
+    void fill(VFract f)
+    {
+        for (int i=0;i<n;i++)
+            p[i] = f;
+    }
+
+public:
+    // v[i] = v[i] + a[i]
+    void add(FractSpan a, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        assert(a.n == n);
+        Batch::add(raw(), raw(), a.raw(), n, limits(policy));
+    }
+
+    // v[i] = v[i] - a[i]
+    void sub(FractSpan a, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        assert(a.n == n);
+        Batch::sub(raw(), raw(), a.raw(), n, limits(policy));
+    }
+
+    // v[i] = v[i] * a[i]
+    void mul(FractSpan a, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        assert(a.n == n);
+        Batch::mul(raw(), raw(), a.raw(), F, n, limits(policy));
+    }
+
+    // v[i] = v[i] * f
+    void scale(VFract f, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        Batch::scale(raw(), raw(), detail::FractAccess::raw(f), F, n, limits(policy));
+    }
+
+    // Dot product with a, see ::dot()
+    template <int I2, int F2>
+    Fract<I2,F2> dot(FractSpan a) const
+    {
+        assert(a.n == n);
+        return ::dot<I2,F2>(p, a.p, n);
+    }
+
+    // v[i] = min(v[i], a[i])
+    void min(FractSpan a)
+    {
+        assert(a.n == n);
+        Batch::min(raw(), raw(), a.raw(), n);
+    }
+
+    // v[i] = max(v[i], a[i])
+    void max(FractSpan a)
+    {
+        assert(a.n == n);
+        Batch::max(raw(), raw(), a.raw(), n);
+    }
+
+    // v[i] = min(max(v[i], lo), hi)
+    void clamp(VFract lo, VFract hi)
+    {
+        Batch::clamp(raw(), raw(), detail::FractAccess::raw(lo), detail::FractAccess::raw(hi), n);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// dot -- dot product of a[0..n) and b[0..n)
+//
+// The products are summed exactly at double width (with 2F fractional bits), and the
+// sum is converted only once to Fract<I2,F2>, like an explicit conversion between Fract
+// formats. Thus the result is exact when F2 >= 2F (eg: dot<32,32> of Fract<16,16>
+// arrays), and rounded toward minus infinity otherwise. An overflow is reported only
+// if the final result does not fit, whatever the intermediate sums.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I2, int F2, int I, int F>
+Fract<I2,F2> dot(const Fract<I,F>* a, const Fract<I,F>* b, int n)
+{
+    typedef detail::FractAccess::Traits<I,F> Traits;
+    typedef typename Traits::IntType IntType;
+    typedef typename Traits::DIntType DIntType;
+
+    detail::WideSum<DIntType> sum;
+    detail::Batch<IntType>::dot(sum, reinterpret_cast<const IntType*>(a),
+                                reinterpret_cast<const IntType*>(b), n);
+    return Fract<I2,F2>(typename AnyInt::Bigger<DIntType, int64_t>::type(sum.value()), 2*F);
+}
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // Reduce -- parallel reductions of raw arrays. Each chunk is reduced with
+    // the batch kernels, and the partial results are merged serially. The
+    // reductions are all exact, so the results do not depend on how the
+    // array is split.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct Reduce
+    {
+        typedef Batch<IntType> B;
+        typedef typename BatchScalar<IntType>::SumType SumType;
+        enum { CHUNK = 65536 };
+
+        static SumType sum(const IntType* a, int n)
+        {
+            int nchunks = NumChunks(n, CHUNK, MaxThreads());
+            AlignedBuffer<SumType> part(nchunks);
+            SumType* ps = part.get();
+
+            FRACT_OMP(omp parallel for schedule(static))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, t, begin, end);
+                ps[t] = B::sum(a + begin, end - begin);
+            }
+
+            SumType s = 0;
+            for (int t=0;t<nchunks;t++)
+                s += ps[t];
+            return s;
+        }
+
+        // Prefix sums (see Batch::scan) in two passes: the sums of the chunks,
+        // and then the scan of each chunk starting from the total of the
+        // previous ones. Return true if any of the results did not fit.
+        template <class OutType>
+        static bool scan(OutType* r, const IntType* a, int n, int bits, bool exclusive)
+        {
+            int nchunks = NumChunks(n, CHUNK, MaxThreads());
+            if (nchunks == 1)
+                return B::scan(r, a, n, SumType(0), bits, exclusive);
+
+            AlignedBuffer<SumType> part(nchunks);
+            SumType* ps = part.get();
+
+            FRACT_OMP(omp parallel for schedule(static))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, t, begin, end);
+                ps[t] = B::sum(a + begin, end - begin);
+            }
+
+            SumType carry = 0;
+            for (int t=0;t<nchunks;t++)
+            {
+                SumType s = ps[t];
+                ps[t] = carry;
+                carry += s;
+            }
+
+            int ovf = 0;
+            FRACT_OMP(omp parallel for schedule(static) reduction(|:ovf))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, t, begin, end);
+                ovf |= B::scan(r + begin, a + begin, end - begin, ps[t], bits, exclusive);
+            }
+            return ovf;
+        }
+
+        // Smallest (or largest) element, n >= 1. If index is not NULL, it
+        // receives the index of its first occurrence.
+        static IntType extreme(const IntType* a, int n, bool largest, int* index)
+        {
+            int nchunks = NumChunks(n, CHUNK, MaxThreads());
+            AlignedBuffer<IntType> part(nchunks);
+            IntType* pm = part.get();
+
+            FRACT_OMP(omp parallel for schedule(static))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, t, begin, end);
+                pm[t] = largest ? B::max(a + begin, end - begin) : B::min(a + begin, end - begin);
+            }
+
+            int best = 0;
+            for (int t=1;t<nchunks;t++)
+                if (largest ? (pm[best] < pm[t]) : (pm[t] < pm[best]))
+                    best = t;
+
+            if (index)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, best, begin, end);
+                *index = begin + B::find(a + begin, pm[best], end - begin);
+            }
+            return pm[best];
+        }
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Reductions over a[0..n)
+//
+// These functions split the work across threads (see fixedpoint/parallel.h) and are
+// vectorized within each thread. All of them are exact, so they give the same result
+// for any number of threads. The sum is accumulated at double width and converted
+// once to Fract<I2,F2>; the mean is rounded toward minus infinity, like the product.
+// min, max, mean, argmin and argmax require n >= 1; argmin and argmax return the
+// first index in case of ties.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I2, int F2, int I, int F>
+Fract<I2,F2> sum(const Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    return Fract<I2,F2>(detail::Reduce<IntType>::sum(reinterpret_cast<const IntType*>(a), n), F);
+}
+
+template <int I, int F>
+Fract<I,F> mean(const Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename detail::Reduce<IntType>::SumType SumType;
+    DOMAIN_IF(n <= 0);
+
+    SumType s = detail::Reduce<IntType>::sum(reinterpret_cast<const IntType*>(a), n);
+    SumType q = s / n;
+    if (q * n != s && s < 0)
+        --q;
+    return detail::FractAccess::gen<I,F>(IntType(q));
+}
+
+template <int I, int F>
+Fract<I,F> min(const Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    DOMAIN_IF(n <= 0);
+    return detail::FractAccess::gen<I,F>(
+        detail::Reduce<IntType>::extreme(reinterpret_cast<const IntType*>(a), n, false, NULL));
+}
+
+template <int I, int F>
+Fract<I,F> max(const Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    DOMAIN_IF(n <= 0);
+    return detail::FractAccess::gen<I,F>(
+        detail::Reduce<IntType>::extreme(reinterpret_cast<const IntType*>(a), n, true, NULL));
+}
+
+template <int I, int F>
+int argmin(const Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    DOMAIN_IF(n <= 0);
+    int index;
+    detail::Reduce<IntType>::extreme(reinterpret_cast<const IntType*>(a), n, false, &index);
+    return index;
+}
+
+template <int I, int F>
+int argmax(const Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    DOMAIN_IF(n <= 0);
+    int index;
+    detail::Reduce<IntType>::extreme(reinterpret_cast<const IntType*>(a), n, true, &index);
+    return index;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Prefix sums of a[0..n) into out[0..n)
+//
+// inclusive_scan computes out[i] = a[0] + ... + a[i], and exclusive_scan computes
+// out[i] = a[0] + ... + a[i-1] (so out[0] is zero). The output may have more integer
+// bits than the input, so that long scans do not overflow, and it may also be the input
+// itself. Results that do not fit the output format wrap around: if overflow is not
+// NULL, *overflow is set to true (and never cleared) when this happens, otherwise an
+// overflow error is reported. The work is split across threads, with identical results.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F, int I2>
+void inclusive_scan(const Fract<I,F>* a, Fract<I2,F>* out, int n, bool* overflow = NULL)
+{
+    STATIC_ASSERT(I2 >= I, "The output format cannot be narrower than the input one");
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename detail::FractAccess::Traits<I2,F>::IntType OutType;
+
+    bool ovf = detail::Reduce<IntType>::scan(reinterpret_cast<OutType*>(out),
+                                             reinterpret_cast<const IntType*>(a), n, I2+F, false);
+    if (overflow)
+        *overflow |= ovf;
+    else
+        OVERFLOW_IF(ovf);
+}
+
+template <int I, int F, int I2>
+void exclusive_scan(const Fract<I,F>* a, Fract<I2,F>* out, int n, bool* overflow = NULL)
+{
+    STATIC_ASSERT(I2 >= I, "The output format cannot be narrower than the input one");
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename detail::FractAccess::Traits<I2,F>::IntType OutType;
+
+    bool ovf = detail::Reduce<IntType>::scan(reinterpret_cast<OutType*>(out),
+                                             reinterpret_cast<const IntType*>(a), n, I2+F, true);
+    if (overflow)
+        *overflow |= ovf;
+    else
+        OVERFLOW_IF(ovf);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// histogram -- count the elements of a[0..n) in nbins bins of equal width
+//
+// Bin k holds the values in [lo + k*width, lo + (k+1)*width), and counts[k] receives
+// the number of elements which fall into it; the elements outside of all bins are not
+// counted, and the function returns how many there were. The bin of a value is
+// computed exactly from its raw integer, with a shift when the width is a power of two
+// (in units of the format, eg: 0.25 or 4) and otherwise with a reciprocal of the width
+// computed once. Each thread counts a chunk of the array into its own histogram, and
+// they are merged at the end.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+    template <class IntType>
+    struct Histogram
+    {
+        enum { CHUNK = 65536, BLOCK = 256 };
+
+        static int count(int* counts, const IntType* a, int n, const Bins<IntType>& b)
+        {
+            const int nbins = b.nbins;
+            const int nchunks = NumChunks(n, CHUNK, MaxThreads());
+            AlignedBuffer<int> part(nchunks * (nbins+1));
+            int* ph = part.get();
+
+            FRACT_OMP(omp parallel for schedule(static))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, t, begin, end);
+                int* h = ph + t*(nbins+1);
+                int idx[BLOCK];
+                memset(h, 0, (nbins+1) * sizeof(int));
+
+                // The last bin counts the elements outside
+                for (int i=begin;i<end;i+=BLOCK)
+                {
+                    int m = (end - i < BLOCK) ? end - i : BLOCK;
+                    Batch<IntType>::bin(idx, a + i, m, b);
+                    for (int j=0;j<m;j++)
+                        h[idx[j]]++;
+                }
+            }
+
+            int outside = 0;
+            memset(counts, 0, nbins * sizeof(int));
+            for (int t=0;t<nchunks;t++)
+            {
+                const int* h = ph + t*(nbins+1);
+                for (int k=0;k<nbins;k++)
+                    counts[k] += h[k];
+                outside += h[nbins];
+            }
+            return outside;
+        }
+    };
+}
+
+template <int I, int F>
+int histogram(const Fract<I,F>* a, int n, Fract<I,F> lo, Fract<I,F> width, int* counts, int nbins)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+    DOMAIN_IF(nbins <= 0 || !(Fract<I,F>(0) < width));
+
+    detail::Bins<IntType> b(detail::FractAccess::raw(lo), UIntType(detail::FractAccess::raw(width)), nbins);
+    return detail::Histogram<IntType>::count(counts, reinterpret_cast<const IntType*>(a), n, b);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FractArray -- array of Fract which owns its storage, aligned to a cache line
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class FractArray : public FractSpan<I,F>
+{
+public:
+    typedef Fract<I,F> VFract;
+
+private:
+    typedef typename FractSpan<I,F>::IntType IntType;
+
+    void alloc(int size)
+    {
+        this->n = size;
+        this->p = static_cast<VFract*>(detail::AlignedAlloc(size * sizeof(VFract)));
+        memset(this->raw(), 0, size * sizeof(IntType));
+    }
+
+public:
+    explicit FractArray(int size = 0)
+    {
+        alloc(size);
+    }
+
+    FractArray(const VFract* v, int size)
+    {
+        alloc(size);
+        memcpy(this->p, v, size * sizeof(VFract));
+    }
+
+    FractArray(const FractArray& a)
+        : FractSpan<I,F>()
+    {
+        alloc(a.n);
+        memcpy(this->p, a.p, this->n * sizeof(VFract));
+    }
+
+    ~FractArray()
+    {
+        detail::AlignedFree(this->p);
+    }
+
+    FractArray& operator=(const FractArray& a)
+    {
+        if (this != &a)
+        {
+            detail::AlignedFree(this->p);
+            alloc(a.n);
+            memcpy(this->p, a.p, this->n * sizeof(VFract));
+        }
+        return *this;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// reciprocal, sqrt -- elementwise functions of a[0..n), into out[0..n)
+//
+// These run the kernels dispatched at runtime (see fixedpoint/dispatch.h), for formats
+// stored in 32-bit integers. Both give the same results as the scalar functions: sqrt
+// is exact, rounded toward minus infinity, and reciprocal runs the same division-free
+// Newton-Raphson iteration as the scalar reciprocal(). A domain error is reported for
+// a zero (reciprocal) or a negative number (sqrt), and an overflow when a reciprocal
+// does not fit the format. out may be a itself.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+    inline void RaiseKernelErrors(int err)
+    {
+        DOMAIN_IF(err & FRACT_KERNEL_DOMAIN);
+        OVERFLOW_IF(err & FRACT_KERNEL_OVERFLOW);
+    }
+}
+
+template <int I, int F>
+void reciprocal(const Fract<I,F>* a, Fract<I,F>* out, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    STATIC_ASSERT(sizeof(IntType) == 4, "Batch reciprocal needs a format stored in 32 bits");
+
+    detail::RaiseKernelErrors(detail::Dispatch::table().reciprocal(
+        reinterpret_cast<int32_t*>(out), reinterpret_cast<const int32_t*>(a), n, F, I+F));
+}
+
+template <int I, int F>
+void sqrt(const Fract<I,F>* a, Fract<I,F>* out, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    STATIC_ASSERT(sizeof(IntType) == 4, "Batch sqrt needs a format stored in 32 bits");
+
+    detail::RaiseKernelErrors(detail::Dispatch::table().sqrt(
+        reinterpret_cast<int32_t*>(out), reinterpret_cast<const int32_t*>(a), n, F));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// convert -- conversion of a[0..n) to another format
+//
+// Each element is converted like the Fract conversion constructor (the fractional bits
+// that do not fit are truncated, that is rounded toward minus infinity), but results
+// which do not fit the output format are saturated instead of reporting an overflow.
+// Both functions return the number of saturated elements (through overflows, for the
+// one which returns a new array). Conversions between int8 and int32 formats are
+// vectorized, including the narrowing ones: with the AVX2 batch kernels when the build
+// targets AVX2, and otherwise with the kernels dispatched at runtime.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+    // Conversion kernel: the batch one, or the one dispatched at runtime for
+    // int8 and int32 formats when the build does not target AVX2 already
+    template <class IntType, class OutType>
+    struct Convert
+    {
+        static int run(OutType* r, const IntType* a, int n, int shift, const Limits<OutType>& lim)
+        { return Batch<IntType>::convert(r, a, n, shift, lim); }
+    };
+
+#ifndef FRACT_HAS_AVX2
+    template <class IntType, class OutType>
+    struct ConvertDispatch
+    {
+        static int run(OutType* r, const IntType* a, int n, int shift, const Limits<OutType>& lim)
+        { return Dispatch::convert(r, a, n, shift, lim.lo, lim.hi); }
+    };
+
+    template <> struct Convert<int32_t,int32_t> : public ConvertDispatch<int32_t,int32_t> {};
+    template <> struct Convert<int32_t,int8_t> : public ConvertDispatch<int32_t,int8_t> {};
+    template <> struct Convert<int8_t,int32_t> : public ConvertDispatch<int8_t,int32_t> {};
+    template <> struct Convert<int8_t,int8_t> : public ConvertDispatch<int8_t,int8_t> {};
+#endif
+}
+
+template <int I2, int F2, int I, int F>
+int convert(const Fract<I,F>* a, Fract<I2,F2>* out, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename detail::FractAccess::Traits<I2,F2>::IntType OutType;
+
+    return detail::Convert<IntType,OutType>::run(reinterpret_cast<OutType*>(out), reinterpret_cast<const IntType*>(a),
+                                                 n, F - F2, detail::Limits<OutType>(I2+F2, FRACT_OVERFLOW_SATURATE));
+}
+
+template <int I2, int F2, int I, int F>
+FractArray<I2,F2> convert(FractSpan<I,F> a, int* overflows = NULL)
+{
+    FractArray<I2,F2> r(a.size());
+    int count = convert(a.data(), r.data(), a.size());
+    if (overflows)
+        *overflows = count;
+    return r;
+}
+
+#endif /* FIXEDARRAY_H */
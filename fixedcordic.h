@@ -0,0 +1,536 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains a CORDIC engine for rotations, polar coordinates and
+ * trigonometric and hyperbolic functions of fixed-point numbers.
+ */
+
+#ifndef FIXEDCORDIC_H
+#define FIXEDCORDIC_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include <algorithm>
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // CordicScalar -- CORDIC iterations on lanes of raw values (int32_t or
+    // int64_t). Angles have FZ fractional bits (|z| < 4); the coordinates
+    // can have any format with enough headroom for the gain of the
+    // iterations. Each iteration only shifts and adds: a rotation by
+    // +-atan(2^-i) (or +-atanh(2^-i)), without the gain compensation.
+    //
+    // The tables are in Q2.62, and are rounded to the precision in use.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct CordicScalar
+    {
+        enum { W = bitsof(IntType), FZ = W - 3, MAX_ITERATIONS = 64 };
+
+        static const int64_t atan_table[64];
+        static const int64_t atanh_table[64];
+        static const int64_t circular_gain[64];
+        static const int64_t hyperbolic_gain[64];
+
+        // pi/4, 1/(2*pi), ln(2) and 1/ln(2)
+        static const int64_t PI_4 = 0x3243f6a8885a308dLL;
+        static const int64_t INV_2PI = 0x0a2f9836e4e44153LL;
+        static const int64_t LN2 = 0x2c5c85fdf473de6bLL;
+        static const int64_t INV_LN2 = 0x5c551d94ae0bf85eLL;
+
+        // A Q2.62 constant with frac (up to 62) fractional bits, rounded to nearest
+        static IntType constant(int64_t c, int frac)
+        {
+            if (frac == 62)
+                return IntType(c);
+            return IntType((c + (int64_t(1) << (61 - frac))) >> (62 - frac));
+        }
+
+        enum { ROTATE, VECTOR, HYPERBOLIC };
+
+        // Shifts and angles of the iterations of a mode: 0..iters-1 for the
+        // circular ones, and 1..iters with 4, 13 and 40 repeated (which is
+        // needed for convergence) for the hyperbolic one. Returns their number.
+        static int schedule(int mode, int iters, int* s, IntType* a)
+        {
+            int m = 0;
+            for (int i=0;i<iters;i++)
+            {
+                if (mode != HYPERBOLIC)
+                {
+                    s[m] = i;
+                    a[m++] = constant(atan_table[i], FZ);
+                    continue;
+                }
+                for (int r=0; r < ((i+1 == 4 || i+1 == 13 || i+1 == 40) ? 2 : 1); r++)
+                {
+                    s[m] = i+1;
+                    a[m++] = constant(atanh_table[i+1], FZ);
+                }
+            }
+            return m;
+        }
+
+        // v + x if d is 0, v - x if d is -1: lanes can take different
+        // directions without branches
+        static IntType step(IntType v, IntType x, IntType d)
+        {
+            return v + ((x ^ d) - d);
+        }
+
+        // Iterations on the lanes (x, y, z), driving z to zero (ROTATE,
+        // HYPERBOLIC) or y to zero (VECTOR, with x >= 0) and accumulating
+        // the rotation in z. The gain is 1.6468 (circular) or 0.8282
+        // (hyperbolic), not compensated.
+        template <int MODE>
+        static void run(IntType* x, IntType* y, IntType* z, int n, const int* s, const IntType* a, int m)
+        {
+            for (int k=0;k<n;k++)
+            {
+                IntType xk = x[k], yk = y[k], zk = z[k];
+                for (int j=0;j<m;j++)
+                {
+                    IntType d = (MODE == VECTOR ? yk : zk) >> (W-1), dx = yk >> s[j], dy = xk >> s[j];
+                    switch (MODE)
+                    {
+                    case ROTATE:
+                        xk = step(xk, dx, ~d); yk = step(yk, dy, d); zk = step(zk, a[j], ~d);
+                        break;
+                    case VECTOR:
+                        xk = step(xk, dx, d); yk = step(yk, dy, ~d); zk = step(zk, a[j], d);
+                        break;
+                    default:
+                        xk = step(xk, dx, d); yk = step(yk, dy, d); zk = step(zk, a[j], ~d);
+                        break;
+                    }
+                }
+                x[k] = xk; y[k] = yk; z[k] = zk;
+            }
+        }
+    };
+
+    // atan(2^-i)
+    template <class IntType>
+    const int64_t CordicScalar<IntType>::atan_table[64] =
+    {
+        0x3243f6a8885a308dLL, 0x1dac670561bb4f69LL, 0x0fadbafc96406eb1LL, 0x07f56ea6ab0bdb72LL,
+        0x03feab76e59fbd39LL, 0x01ffd55bba97624bLL, 0x00fffaaadddb94d6LL, 0x007fff5556eeea5dLL,
+        0x003fffeaaab7776eLL, 0x001ffffd5555bbbcLL, 0x000fffffaaaaaddeLL, 0x0007fffff555556fLL,
+        0x0003fffffeaaaaabLL, 0x0001ffffffd55555LL, 0x0000fffffffaaaabLL, 0x00007fffffff5555LL,
+        0x00003fffffffeaabLL, 0x00001ffffffffd55LL, 0x00000fffffffffabLL, 0x000007fffffffff5LL,
+        0x000003ffffffffffLL, 0x0000020000000000LL, 0x0000010000000000LL, 0x0000008000000000LL,
+        0x0000004000000000LL, 0x0000002000000000LL, 0x0000001000000000LL, 0x0000000800000000LL,
+        0x0000000400000000LL, 0x0000000200000000LL, 0x0000000100000000LL, 0x0000000080000000LL,
+        0x0000000040000000LL, 0x0000000020000000LL, 0x0000000010000000LL, 0x0000000008000000LL,
+        0x0000000004000000LL, 0x0000000002000000LL, 0x0000000001000000LL, 0x0000000000800000LL,
+        0x0000000000400000LL, 0x0000000000200000LL, 0x0000000000100000LL, 0x0000000000080000LL,
+        0x0000000000040000LL, 0x0000000000020000LL, 0x0000000000010000LL, 0x0000000000008000LL,
+        0x0000000000004000LL, 0x0000000000002000LL, 0x0000000000001000LL, 0x0000000000000800LL,
+        0x0000000000000400LL, 0x0000000000000200LL, 0x0000000000000100LL, 0x0000000000000080LL,
+        0x0000000000000040LL, 0x0000000000000020LL, 0x0000000000000010LL, 0x0000000000000008LL,
+        0x0000000000000004LL, 0x0000000000000002LL, 0x0000000000000001LL, 0x0000000000000000LL,
+    };
+
+    // atanh(2^-i), i > 0
+    template <class IntType>
+    const int64_t CordicScalar<IntType>::atanh_table[64] =
+    {
+        0x0000000000000000LL, 0x2327d4f55a06152fLL, 0x1058aefa811451a7LL, 0x080ac48e4f577bb5LL,
+        0x04015622b4dd6b37LL, 0x02002ab11235dc49LL, 0x01000555888ad1caLL, 0x008000aaac4448d7LL,
+        0x004000155562222bLL, 0x00200002aaab1111LL, 0x0010000055555889LL, 0x000800000aaaaac4LL,
+        0x0004000001555556LL, 0x00020000002aaaabLL, 0x0001000000055555LL, 0x000080000000aaabLL,
+        0x0000400000001555LL, 0x00002000000002abLL, 0x0000100000000055LL, 0x000008000000000bLL,
+        0x0000040000000001LL, 0x0000020000000000LL, 0x0000010000000000LL, 0x0000008000000000LL,
+        0x0000004000000000LL, 0x0000002000000000LL, 0x0000001000000000LL, 0x0000000800000000LL,
+        0x0000000400000000LL, 0x0000000200000000LL, 0x0000000100000000LL, 0x0000000080000000LL,
+        0x0000000040000000LL, 0x0000000020000000LL, 0x0000000010000000LL, 0x0000000008000000LL,
+        0x0000000004000000LL, 0x0000000002000000LL, 0x0000000001000000LL, 0x0000000000800000LL,
+        0x0000000000400000LL, 0x0000000000200000LL, 0x0000000000100000LL, 0x0000000000080000LL,
+        0x0000000000040000LL, 0x0000000000020000LL, 0x0000000000010000LL, 0x0000000000008000LL,
+        0x0000000000004000LL, 0x0000000000002000LL, 0x0000000000001000LL, 0x0000000000000800LL,
+        0x0000000000000400LL, 0x0000000000000200LL, 0x0000000000000100LL, 0x0000000000000080LL,
+        0x0000000000000040LL, 0x0000000000000020LL, 0x0000000000000010LL, 0x0000000000000008LL,
+        0x0000000000000004LL, 0x0000000000000002LL, 0x0000000000000001LL, 0x0000000000000001LL,
+    };
+
+    // 1/K after N iterations
+    template <class IntType>
+    const int64_t CordicScalar<IntType>::circular_gain[64] =
+    {
+        0x4000000000000000LL, 0x2d413cccfe779921LL, 0x287a26c490921db6LL, 0x2744c374daf46d30LL,
+        0x26f72283bd67fbdbLL, 0x26e3b58305ddeb19LL, 0x26ded9f57b2c3e7bLL, 0x26dda30d3e4fd186LL,
+        0x26dd5552e1641defLL, 0x26dd41e4454da117LL, 0x26dd3d089dfa47c8LL, 0x26dd3bd1b42095cfLL,
+        0x26dd3b83f9a9db96LL, 0x26dd3b708b0c282cLL, 0x26dd3b6baf64bb04LL, 0x26dd3b6a787adfb5LL,
+        0x26dd3b6a2ac068e1LL, 0x26dd3b6a1751cb2cLL, 0x26dd3b6a127623beLL, 0x26dd3b6a113f39e3LL,
+        0x26dd3b6a10f17f6cLL, 0x26dd3b6a10de10cfLL, 0x26dd3b6a10d93527LL, 0x26dd3b6a10d7fe3dLL,
+        0x26dd3b6a10d7b083LL, 0x26dd3b6a10d79d14LL, 0x26dd3b6a10d79839LL, 0x26dd3b6a10d79702LL,
+        0x26dd3b6a10d796b4LL, 0x26dd3b6a10d796a0LL, 0x26dd3b6a10d7969cLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+        0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL, 0x26dd3b6a10d7969aLL,
+    };
+
+    // 1/K after N iterations (shifts 1..N, 4, 13 and 40 twice)
+    template <class IntType>
+    const int64_t CordicScalar<IntType>::hyperbolic_gain[64] =
+    {
+        0x4000000000000000LL, 0x49e69d1640cc7135LL, 0x4c530f64aa7a4339LL, 0x4ced8581784e96d8LL,
+        0x4d3ac041ba089f77LL, 0x4d446969835ffe0cLL, 0x4d46d3a9c9d60bceLL, 0x4d476e3940d89f12LL,
+        0x4d4794dd14f020fbLL, 0x4d479e86095b7176LL, 0x4d47a0f0466c9c9eLL, 0x4d47a18ad5b04cd9LL,
+        0x4d47a1b179812f3fLL, 0x4d47a1c4cb69a071LL, 0x4d47a1c735a6aeb5LL, 0x4d47a1c7d035f245LL,
+        0x4d47a1c7f6d9c329LL, 0x4d47a1c80082b762LL, 0x4d47a1c802ecf470LL, 0x4d47a1c8038783b4LL,
+        0x4d47a1c803ae2785LL, 0x4d47a1c803b7d079LL, 0x4d47a1c803ba3ab6LL, 0x4d47a1c803bad545LL,
+        0x4d47a1c803bafbe9LL, 0x4d47a1c803bb0592LL, 0x4d47a1c803bb07fcLL, 0x4d47a1c803bb0897LL,
+        0x4d47a1c803bb08bdLL, 0x4d47a1c803bb08c7LL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+        0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL, 0x4d47a1c803bb08caLL,
+    };
+
+    template <class IntType>
+    struct CordicLanes : public CordicScalar<IntType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    /////////////////////////////////////////////////////////////////////////
+    // CordicLanes<int32_t> -- eight independent rotations at a time
+    /////////////////////////////////////////////////////////////////////////
+    template <>
+    struct CordicLanes<int32_t> : public CordicScalar<int32_t>
+    {
+        typedef CordicScalar<int32_t> Scalar;
+
+        static __m256i step(__m256i v, __m256i x, __m256i d)
+        {
+            return _mm256_add_epi32(v, _mm256_sub_epi32(_mm256_xor_si256(x, d), d));
+        }
+
+        template <int MODE>
+        static void run(int32_t* x, int32_t* y, int32_t* z, int n, const int* s, const int32_t* a, int m)
+        {
+            const __m256i ones = _mm256_set1_epi32(-1);
+            int k = 0;
+            for (;k+8<=n;k+=8)
+            {
+                __m256i xk = avx2::load(x+k), yk = avx2::load(y+k), zk = avx2::load(z+k);
+                for (int j=0;j<m;j++)
+                {
+                    __m128i c = _mm_cvtsi32_si128(s[j]);
+                    __m256i dx = _mm256_sra_epi32(yk, c), dy = _mm256_sra_epi32(xk, c);
+                    __m256i aj = _mm256_set1_epi32(a[j]);
+                    __m256i d = _mm256_srai_epi32(MODE == VECTOR ? yk : zk, 31);
+                    __m256i nd = _mm256_xor_si256(d, ones);
+                    switch (MODE)
+                    {
+                    case ROTATE:
+                        xk = step(xk, dx, nd); yk = step(yk, dy, d); zk = step(zk, aj, nd);
+                        break;
+                    case VECTOR:
+                        xk = step(xk, dx, d); yk = step(yk, dy, nd); zk = step(zk, aj, d);
+                        break;
+                    default:
+                        xk = step(xk, dx, d); yk = step(yk, dy, d); zk = step(zk, aj, nd);
+                        break;
+                    }
+                }
+                avx2::store(x+k, xk);
+                avx2::store(y+k, yk);
+                avx2::store(z+k, zk);
+            }
+            Scalar::run<MODE>(x+k, y+k, z+k, n-k, s, a, m);
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Cordic -- CORDIC engine on Fract<I,F>, with N iterations
+//
+// Each iteration rotates by +-atan(2^-i) (or +-atanh(2^-i)) with shifts and adds only,
+// and gains about one bit of precision; the default is F+2 iterations. The tables of
+// the angles and of the gains are constants of the header, rounded to the precision
+// of the computation, and the gain of the iterations is compensated in the initial
+// vector (sincos, sinhcosh) or with a single rounded product at the end (rotate,
+// polar). Angles are in radians.
+//
+// The computations are done with integers twice as wide as the format needs, so that
+// there is room for the gain and for some guard bits: int32_t for formats up to 23
+// bits, int64_t for larger ones (up to 55 bits). The functions on arrays process many
+// independent rotations at once (eight per instruction with AVX2, for the formats
+// computed with int32_t), and give the same results as the scalar ones.
+//
+// Results which do not fit the format follow the overflow policy (eg: cos(0) with
+// Fract<1,15>).
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F, int N = F + 2>
+class Cordic
+{
+public:
+    typedef Fract<I,F> VFract;
+    enum { ITERATIONS = N };
+
+private:
+    enum { GUARD = 6 };
+    typedef typename detail::FractAccess::Traits<I,F>::IntType RawType;
+    typedef typename detail::if_t<(I+F+3+GUARD <= 32), int32_t, int64_t>::type IntType;
+    typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+    typedef detail::CordicLanes<IntType> Kernel;
+    typedef detail::Limits<RawType> Limits;
+
+    // Fractional bits of the angles, of the coordinates (circular and
+    // hyperbolic) and of the gains
+    enum { W = bitsof(IntType), FZ = Kernel::FZ, FX = W - I - 3, FH = W - 3, FG = W - 2, CHUNK = 256 };
+
+    STATIC_ASSERT(I+F+3+GUARD <= 64 && N >= 1 && N <= FZ - 2,
+                  "Format too large for the CORDIC engine, or unsupported number of iterations");
+
+    struct Schedule
+    {
+        int s[2*Kernel::MAX_ITERATIONS];
+        IntType a[2*Kernel::MAX_ITERATIONS];
+        int m;
+
+        explicit Schedule(int mode) { m = Kernel::schedule(mode, N, s, a); }
+    };
+
+    static DIntType shl(DIntType x, int s)
+    {
+        return s >= 0 ? x * (DIntType(1) << s) : x >> -s;
+    }
+
+    static IntType negate(IntType x, IntType flip)
+    {
+        return (x ^ flip) - flip;
+    }
+
+    // Angle in radians from the format to FZ fractional bits, reduced by
+    // multiples of 2*pi into [-pi, pi] (within a few units)
+    static IntType reduce(RawType z)
+    {
+        const IntType inv = Kernel::constant(Kernel::INV_2PI, FG);
+        const DIntType twopi = DIntType(Kernel::constant(Kernel::PI_4, FZ)) * 8;
+        DIntType q = (DIntType(z) * inv + (DIntType(1) << (FG + F - 1))) >> (FG + F);
+        return IntType(shl(z, FZ - F) - q * twopi);
+    }
+
+    // Fold z into [-pi/2, pi/2]; flip is -1 if the vector must be flipped
+    static IntType fold(IntType z, IntType& flip)
+    {
+        const IntType half = Kernel::constant(Kernel::PI_4, FZ) * 2, pi = half * 2;
+        flip = (z > half || z < -half) ? -1 : 0;
+        return z > half ? z - pi : z < -half ? z + pi : z;
+    }
+
+    static RawType fix(DIntType x, const Limits& lim)
+    {
+        if (x >= lim.lo && x <= lim.hi)
+            return RawType(x);
+        switch (lim.policy)
+        {
+        case FRACT_OVERFLOW_SATURATE:
+            return (x < lim.lo) ? lim.lo : lim.hi;
+        case FRACT_OVERFLOW_WRAP:
+            return detail::BatchScalar<RawType>::wrap(typename detail::BatchScalar<RawType>::DIntType(x), lim.bits);
+        default:
+            OVERFLOW_IF(true);
+            return RawType(x);
+        }
+    }
+
+    // Round x, with frac fractional bits, to nearest in the format
+    static RawType round(DIntType x, int frac, const Limits& lim)
+    {
+        return fix((x + (DIntType(1) << (frac - F - 1))) >> (frac - F), lim);
+    }
+
+    static const RawType* raw(const VFract* p) { return reinterpret_cast<const RawType*>(p); }
+    static RawType* raw(VFract* p) { return reinterpret_cast<RawType*>(p); }
+
+public:
+    // Rotation of the vectors (x[i], y[i]) by angle[i], into (xo[i], yo[i])
+    static void rotate(const VFract* x, const VFract* y, const VFract* angle, VFract* xo, VFract* yo, int n,
+                       FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        const Limits lim(I+F, policy);
+        const Schedule sch(Kernel::ROTATE);
+        const IntType g = Kernel::constant(Kernel::circular_gain[N], FG);
+        IntType bx[CHUNK], by[CHUNK], bz[CHUNK];
+
+        for (int b=0;b<n;b+=CHUNK)
+        {
+            int m = std::min(n - b, int(CHUNK));
+            for (int k=0;k<m;k++)
+            {
+                IntType flip;
+                bz[k] = fold(reduce(raw(angle)[b+k]), flip);
+                bx[k] = negate(IntType(shl(raw(x)[b+k], FX - F)), flip);
+                by[k] = negate(IntType(shl(raw(y)[b+k], FX - F)), flip);
+            }
+            Kernel::template run<Kernel::ROTATE>(bx, by, bz, m, sch.s, sch.a, sch.m);
+            for (int k=0;k<m;k++)
+            {
+                raw(xo)[b+k] = round(DIntType(bx[k]) * g, FX + FG, lim);
+                raw(yo)[b+k] = round(DIntType(by[k]) * g, FX + FG, lim);
+            }
+        }
+    }
+
+    static void rotate(VFract& x, VFract& y, VFract angle, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        rotate(&x, &y, &angle, &x, &y, 1, policy);
+    }
+
+    // Sine and cosine of angle[i]
+    static void sincos(const VFract* angle, VFract* s, VFract* c, int n,
+                       FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        const Limits lim(I+F, policy);
+        const Schedule sch(Kernel::ROTATE);
+        const IntType g = Kernel::constant(Kernel::circular_gain[N], FX);
+        IntType bx[CHUNK], by[CHUNK], bz[CHUNK];
+
+        for (int b=0;b<n;b+=CHUNK)
+        {
+            int m = std::min(n - b, int(CHUNK));
+            for (int k=0;k<m;k++)
+            {
+                IntType flip;
+                bz[k] = fold(reduce(raw(angle)[b+k]), flip);
+                bx[k] = negate(g, flip);
+                by[k] = 0;
+            }
+            Kernel::template run<Kernel::ROTATE>(bx, by, bz, m, sch.s, sch.a, sch.m);
+            for (int k=0;k<m;k++)
+            {
+                raw(s)[b+k] = round(by[k], FX, lim);
+                raw(c)[b+k] = round(bx[k], FX, lim);
+            }
+        }
+    }
+
+    static void sincos(VFract angle, VFract& s, VFract& c, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        sincos(&angle, &s, &c, 1, policy);
+    }
+
+    // Magnitude and phase (in (-pi, pi]) of the vectors (x[i], y[i]); the
+    // phase of (0, 0) is zero
+    static void polar(const VFract* x, const VFract* y, VFract* r, VFract* phase, int n,
+                      FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        const Limits lim(I+F, policy);
+        const Schedule sch(Kernel::VECTOR);
+        const IntType g = Kernel::constant(Kernel::circular_gain[N], FG);
+        const IntType pi = Kernel::constant(Kernel::PI_4, FZ) * 4;
+        IntType bx[CHUNK], by[CHUNK], bz[CHUNK], off[CHUNK];
+
+        for (int b=0;b<n;b+=CHUNK)
+        {
+            int m = std::min(n - b, int(CHUNK));
+            for (int k=0;k<m;k++)
+            {
+                // Vectors with x < 0 are flipped, and pi added back to the phase
+                IntType vx = IntType(shl(raw(x)[b+k], FX - F)), vy = IntType(shl(raw(y)[b+k], FX - F));
+                IntType flip = (vx < 0) ? -1 : 0;
+                off[k] = flip & (vy < 0 ? -pi : pi);
+                bx[k] = negate(vx, flip);
+                by[k] = negate(vy, flip);
+                bz[k] = 0;
+            }
+            Kernel::template run<Kernel::VECTOR>(bx, by, bz, m, sch.s, sch.a, sch.m);
+            for (int k=0;k<m;k++)
+            {
+                bool zero = (raw(x)[b+k] == 0 && raw(y)[b+k] == 0);
+                raw(r)[b+k] = round(DIntType(bx[k]) * g, FX + FG, lim);
+                raw(phase)[b+k] = zero ? 0 : round(DIntType(bz[k]) + off[k], FZ, lim);
+            }
+        }
+    }
+
+    static void polar(VFract x, VFract y, VFract& r, VFract& phase, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        polar(&x, &y, &r, &phase, 1, policy);
+    }
+
+    // Hyperbolic sine and cosine of z[i]. The argument is reduced to
+    // z = q*ln(2) + t, with |t| <= ln(2)/2, and the results are put back
+    // together from cosh(t) and sinh(t): cosh(z) = (2^q e^t + 2^-q e^-t)/2.
+    // Results too large for the format are not exact with FRACT_OVERFLOW_WRAP.
+    static void sinhcosh(const VFract* z, VFract* sh, VFract* ch, int n,
+                         FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        const Limits lim(I+F, policy);
+        const Schedule sch(Kernel::HYPERBOLIC);
+        const IntType g = Kernel::constant(Kernel::hyperbolic_gain[N], FH);
+        const IntType inv = Kernel::constant(Kernel::INV_LN2, FG), ln2 = Kernel::constant(Kernel::LN2, FZ);
+        const int F2 = F + GUARD;
+        IntType bx[CHUNK], by[CHUNK], bz[CHUNK];
+        int bq[CHUNK];
+
+        for (int b=0;b<n;b+=CHUNK)
+        {
+            int m = std::min(n - b, int(CHUNK));
+            for (int k=0;k<m;k++)
+            {
+                RawType v = raw(z)[b+k];
+                DIntType q = (DIntType(v) * inv + (DIntType(1) << (FG + F - 1))) >> (FG + F);
+                bz[k] = IntType(shl(v, FZ - F) - q * ln2);
+                bq[k] = int(std::max(std::min(q, DIntType(I+2)), DIntType(-I-2)));
+                bx[k] = g;
+                by[k] = 0;
+            }
+            Kernel::template run<Kernel::HYPERBOLIC>(bx, by, bz, m, sch.s, sch.a, sch.m);
+            for (int k=0;k<m;k++)
+            {
+                DIntType ep = shl(DIntType(bx[k]) + by[k], F2 - FH - 1 + bq[k]);
+                DIntType em = shl(DIntType(bx[k]) - by[k], F2 - FH - 1 - bq[k]);
+                raw(sh)[b+k] = round(ep - em, F2, lim);
+                raw(ch)[b+k] = round(ep + em, F2, lim);
+            }
+        }
+    }
+
+    static void sinhcosh(VFract z, VFract& sh, VFract& ch, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+    {
+        sinhcosh(&z, &sh, &ch, 1, policy);
+    }
+};
+
+#endif // FIXEDCORDIC_H
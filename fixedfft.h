@@ -0,0 +1,465 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains the fast Fourier transform of fixed-point data.
+ */
+
+#ifndef FIXEDFFT_H
+#define FIXEDFFT_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include <math.h>
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // FftScalar -- reference kernels of FractFFT, on split real and imaginary
+    // parts. Twiddles have TW fractional bits, and each product by a twiddle
+    // is rounded once (toward minus infinity); the caller guarantees enough
+    // headroom for the butterflies not to overflow.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct FftScalar
+    {
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+        enum { TW = bitsof(IntType) - 2 };
+
+        // (ar + i*ai) * (wr + i*wi)
+        static void cmul(IntType& r, IntType& i, IntType ar, IntType ai, IntType wr, IntType wi)
+        {
+            r = IntType((DIntType(ar)*wr - DIntType(ai)*wi) >> TW);
+            i = IntType((DIntType(ar)*wi + DIntType(ai)*wr) >> TW);
+        }
+
+        // Bitwise OR of the magnitudes of a[0..n) (one's complement of the
+        // negative values): its bit length bounds all of them
+        static IntType magnitude(const IntType* a, int n)
+        {
+            IntType m = 0;
+            for (int i=0;i<n;i++)
+                m |= a[i] ^ (a[i] >> (bitsof(IntType)-1));
+            return m;
+        }
+
+        // Shift a[0..n) right by s, or left by -s (which must not overflow)
+        static void shift(IntType* a, int n, int s)
+        {
+            typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+            if (s > 0)
+                for (int i=0;i<n;i++)
+                    a[i] >>= s;
+            else
+                for (int i=0;i<n;i++)
+                    a[i] = IntType(UIntType(a[i]) << -s);
+        }
+
+        // Radix-2 DIT stage on groups of 2h points; tw[h+j] is W(2h)^j
+        static void pass2(IntType* re, IntType* im, int n, int h,
+                          const IntType* twr, const IntType* twi)
+        {
+            for (int g=0;g<n;g+=2*h)
+                for (int j=0;j<h;j++)
+                {
+                    int a = g + j, b = a + h;
+                    IntType tr, ti;
+                    cmul(tr, ti, re[b], im[b], twr[h+j], twi[h+j]);
+                    re[b] = re[a] - tr; im[b] = im[a] - ti;
+                    re[a] += tr; im[a] += ti;
+                }
+        }
+
+        // Two radix-2 DIT stages (h and 2h) in one pass over groups of 4h
+        // points. The twiddle of the second stage for the odd points is the
+        // one of the even points times -i, which is exact.
+        static void pass4(IntType* re, IntType* im, int n, int h,
+                          const IntType* twr, const IntType* twi)
+        {
+            // The first pass has only trivial twiddles (1 and -i)
+            if (h == 1)
+            {
+                for (int a=0;a<n;a+=4)
+                {
+                    IntType ar = re[a] + re[a+1], ai = im[a] + im[a+1];
+                    IntType br = re[a] - re[a+1], bi = im[a] - im[a+1];
+                    IntType cr = re[a+2] + re[a+3], ci = im[a+2] + im[a+3];
+                    IntType dr = re[a+2] - re[a+3], di = im[a+2] - im[a+3];
+                    re[a] = ar + cr; im[a] = ai + ci; re[a+2] = ar - cr; im[a+2] = ai - ci;
+                    re[a+1] = br + di; im[a+1] = bi - dr; re[a+3] = br - di; im[a+3] = bi + dr;
+                }
+                return;
+            }
+
+            for (int g=0;g<n;g+=4*h)
+                for (int j=0;j<h;j++)
+                {
+                    int a = g + j, b = a + h, c = b + h, d = c + h;
+                    IntType tr, ti, ur, ui;
+
+                    cmul(tr, ti, re[b], im[b], twr[h+j], twi[h+j]);
+                    cmul(ur, ui, re[d], im[d], twr[h+j], twi[h+j]);
+                    IntType ar = re[a] + tr, ai = im[a] + ti, br = re[a] - tr, bi = im[a] - ti;
+                    IntType cr = re[c] + ur, ci = im[c] + ui, dr = re[c] - ur, di = im[c] - ui;
+
+                    cmul(tr, ti, cr, ci, twr[2*h+j], twi[2*h+j]);
+                    cmul(ur, ui, di, -dr, twr[2*h+j], twi[2*h+j]);
+                    re[a] = ar + tr; im[a] = ai + ti; re[c] = ar - tr; im[c] = ai - ti;
+                    re[b] = br + ur; im[b] = bi + ui; re[d] = br - ur; im[d] = bi - ui;
+                }
+        }
+    };
+
+    template <class IntType>
+    struct Fft : public FftScalar<IntType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    /////////////////////////////////////////////////////////////////////////
+    // Fft<int32_t> -- butterflies on eight points at a time, for the stages
+    // with at least eight butterflies per group
+    /////////////////////////////////////////////////////////////////////////
+    template <>
+    struct Fft<int32_t> : public FftScalar<int32_t>
+    {
+        typedef FftScalar<int32_t> Scalar;
+
+        static int32_t magnitude(const int32_t* a, int n)
+        {
+            __m256i m = _mm256_setzero_si256();
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i x = avx2::load(a+i);
+                m = _mm256_or_si256(m, _mm256_xor_si256(x, _mm256_srai_epi32(x, 31)));
+            }
+            int32_t lanes[8];
+            avx2::store(lanes, m);
+            int32_t r = Scalar::magnitude(a+i, n-i);
+            for (int k=0;k<8;k++)
+                r |= lanes[k];
+            return r;
+        }
+
+        static void shift(int32_t* a, int n, int s)
+        {
+            __m128i c = _mm_cvtsi32_si128(s > 0 ? s : -s);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i x = avx2::load(a+i);
+                avx2::store(a+i, s > 0 ? _mm256_sra_epi32(x, c) : _mm256_sll_epi32(x, c));
+            }
+            Scalar::shift(a+i, n-i, s);
+        }
+
+        // Only the low 32 bits of each shifted product are kept, so a logical
+        // shift is as good as an arithmetic one (see avx2::Range::narrow)
+        static void cmul(__m256i& r, __m256i& i, __m256i ar, __m256i ai, __m256i wr, __m256i wi)
+        {
+            __m256i re = _mm256_sub_epi64(avx2::mul_even(ar, wr), avx2::mul_even(ai, wi));
+            __m256i ro = _mm256_sub_epi64(avx2::mul_odd(ar, wr), avx2::mul_odd(ai, wi));
+            __m256i ie = _mm256_add_epi64(avx2::mul_even(ar, wi), avx2::mul_even(ai, wr));
+            __m256i io = _mm256_add_epi64(avx2::mul_odd(ar, wi), avx2::mul_odd(ai, wr));
+            r = _mm256_blend_epi32(_mm256_srli_epi64(re, TW), _mm256_slli_epi64(ro, 32 - TW), 0xAA);
+            i = _mm256_blend_epi32(_mm256_srli_epi64(ie, TW), _mm256_slli_epi64(io, 32 - TW), 0xAA);
+        }
+
+        static void pass2(int32_t* re, int32_t* im, int n, int h, const int32_t* twr, const int32_t* twi)
+        {
+            if (h < 8)
+                return Scalar::pass2(re, im, n, h, twr, twi);
+
+            for (int g=0;g<n;g+=2*h)
+                for (int j=0;j<h;j+=8)
+                {
+                    int a = g + j, b = a + h;
+                    __m256i ar = avx2::load(re+a), ai = avx2::load(im+a), tr, ti;
+                    cmul(tr, ti, avx2::load(re+b), avx2::load(im+b), avx2::load(twr+h+j), avx2::load(twi+h+j));
+                    avx2::store(re+b, _mm256_sub_epi32(ar, tr));
+                    avx2::store(im+b, _mm256_sub_epi32(ai, ti));
+                    avx2::store(re+a, _mm256_add_epi32(ar, tr));
+                    avx2::store(im+a, _mm256_add_epi32(ai, ti));
+                }
+        }
+
+        static void pass4(int32_t* re, int32_t* im, int n, int h, const int32_t* twr, const int32_t* twi)
+        {
+            if (h < 8)
+                return Scalar::pass4(re, im, n, h, twr, twi);
+
+            for (int g=0;g<n;g+=4*h)
+                for (int j=0;j<h;j+=8)
+                {
+                    int a = g + j, b = a + h, c = b + h, d = c + h;
+                    __m256i w1r = avx2::load(twr+h+j), w1i = avx2::load(twi+h+j);
+                    __m256i w2r = avx2::load(twr+2*h+j), w2i = avx2::load(twi+2*h+j);
+                    __m256i tr, ti, ur, ui;
+
+                    cmul(tr, ti, avx2::load(re+b), avx2::load(im+b), w1r, w1i);
+                    cmul(ur, ui, avx2::load(re+d), avx2::load(im+d), w1r, w1i);
+                    __m256i xr = avx2::load(re+a), xi = avx2::load(im+a);
+                    __m256i yr = avx2::load(re+c), yi = avx2::load(im+c);
+                    __m256i ar = _mm256_add_epi32(xr, tr), ai = _mm256_add_epi32(xi, ti);
+                    __m256i br = _mm256_sub_epi32(xr, tr), bi = _mm256_sub_epi32(xi, ti);
+                    __m256i cr = _mm256_add_epi32(yr, ur), ci = _mm256_add_epi32(yi, ui);
+                    __m256i dr = _mm256_sub_epi32(yr, ur), di = _mm256_sub_epi32(yi, ui);
+
+                    cmul(tr, ti, cr, ci, w2r, w2i);
+                    cmul(ur, ui, di, _mm256_sub_epi32(_mm256_setzero_si256(), dr), w2r, w2i);
+                    avx2::store(re+a, _mm256_add_epi32(ar, tr));
+                    avx2::store(im+a, _mm256_add_epi32(ai, ti));
+                    avx2::store(re+c, _mm256_sub_epi32(ar, tr));
+                    avx2::store(im+c, _mm256_sub_epi32(ai, ti));
+                    avx2::store(re+b, _mm256_add_epi32(br, ur));
+                    avx2::store(im+b, _mm256_add_epi32(bi, ui));
+                    avx2::store(re+d, _mm256_sub_epi32(br, ur));
+                    avx2::store(im+d, _mm256_sub_epi32(bi, ui));
+                }
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FractFFT -- fast Fourier transform of size n (a power of two) on Fract data
+//
+// Complex data is kept in split arrays of real and imaginary parts, which are
+// transformed in place. Twiddle factors are precomputed with bitsof(IntType)-2
+// fractional bits (eg: Q30 for formats stored in 32 bits), and the stages are
+// computed two at a time (radix 4), plus a radix-2 stage when log2(n) is odd.
+//
+// Scaling is block floating point. The data is first normalized to the whole width of
+// the underlying integer (so Fract<1,15> is transformed with 32-bit precision); before
+// each pass, the largest magnitude is found (with AnyInt::clz) and all the data is
+// shifted right only as much as the pass needs not to overflow; at the end, the data
+// is normalized again to the whole range of the format. The transforms return the
+// exponent e of their result: the exact transform is the output times 2^e.
+//
+// The forward transform is the unnormalized DFT X[k] = sum x[j] W^(jk), with W =
+// exp(-2*pi*i/n); the inverse one includes the 1/n factor in the exponent, so that the
+// exponents of forward and inverse add up to the one of the original data (zero).
+// Products by the twiddles are rounded toward minus infinity, and so are the shifts.
+//
+// The real transforms compute the n/2+1 non-redundant bins of the transform of n real
+// samples, through a complex transform of size n/2.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class FractFFT
+{
+public:
+    typedef Fract<I,F> VFract;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+    typedef typename AnyInt::Bigger<IntType, int32_t>::type MagType;
+    typedef detail::Fft<IntType> Kernel;
+    enum { TW = Kernel::TW, BITS = I+F, WIDTH = bitsof(IntType) };
+
+    int n, logn;
+    detail::AlignedBuffer<IntType> twr, twi;    // tw[h+j] = W(2h)^j, h = 1, 2, ..., n/2
+    detail::AlignedBuffer<int> rev, rev_half;   // bit reversal for n and n/2
+
+    static void bit_reversal(int* r, int size)
+    {
+        r[0] = 0;
+        for (int i=1, j=0; i<size; i++)
+        {
+            int bit = size >> 1;
+            for (;j & bit; bit >>= 1)
+                j ^= bit;
+            r[i] = j ^= bit;
+        }
+    }
+
+    // Shift a[0..size) and b[0..size) so that the bit length of their largest
+    // magnitude is len (if grow) or at most len (otherwise); return the shift
+    // to the right
+    static int scale(IntType* a, IntType* b, int size, int len, bool grow)
+    {
+        MagType m = MagType(Kernel::magnitude(a, size) | Kernel::magnitude(b, size));
+        int s = AnyInt::Log2Ceil(m) - len;
+        if (m == 0 || s == 0 || (s < 0 && !grow))
+            return 0;
+        Kernel::shift(a, size, s);
+        Kernel::shift(b, size, s);
+        return s;
+    }
+
+    // Forward complex transform of size (a power of two, up to n) in place,
+    // on data normalized to the whole integer
+    int transform(IntType* re, IntType* im, int size, const int* r) const
+    {
+        for (int i=0;i<size;i++)
+            if (i < r[i])
+            {
+                std::swap(re[i], re[r[i]]);
+                std::swap(im[i], im[r[i]]);
+            }
+
+        // A radix-2 butterfly grows the parts by less than 1+sqrt(2), so two
+        // bits of headroom are enough for it, and three for two of them
+        int e = scale(re, im, size, WIDTH-4, true), h = 1;
+        for (;4*h <= size; h *= 4)
+        {
+            e += scale(re, im, size, WIDTH-4, false);
+            Kernel::pass4(re, im, size, h, twr.get(), twi.get());
+        }
+        if (2*h <= size)
+        {
+            e += scale(re, im, size, WIDTH-3, false);
+            Kernel::pass2(re, im, size, h, twr.get(), twi.get());
+        }
+        return e;
+    }
+
+    // One bin of the real transform from Z[k] = a and Z[m-k] = b, with W(n)^k = w
+    static void split(IntType& xr, IntType& xi, IntType ar, IntType ai, IntType br, IntType bi,
+                      IntType wr, IntType wi)
+    {
+        DIntType sr = DIntType(ar) + br, si = DIntType(ai) + bi;
+        DIntType dr = DIntType(ar) - br, di = DIntType(ai) - bi;
+        xr = IntType((sr * (DIntType(1) << TW) + wr*si + wi*dr) >> (TW+1));
+        xi = IntType((di * (DIntType(1) << TW) - wr*dr + wi*si) >> (TW+1));
+    }
+
+    // Inverse of split: Z[k] from the bins X[k] = a and X[m-k] = b
+    static void unsplit(IntType& zr, IntType& zi, IntType ar, IntType ai, IntType br, IntType bi,
+                        IntType wr, IntType wi)
+    {
+        DIntType pr = DIntType(ar) + br, pi = DIntType(ai) - bi;
+        DIntType qr = DIntType(ar) - br, qi = DIntType(ai) + bi;
+        zr = IntType((pr * (DIntType(1) << TW) - wr*qi + wi*qr) >> (TW+1));
+        zi = IntType((pi * (DIntType(1) << TW) + wr*qr + wi*qi) >> (TW+1));
+    }
+
+public:
+    explicit FractFFT(int size)
+        : n(size), logn(AnyInt::Log2Ceil(size) - 1), twr(size), twi(size), rev(size), rev_half(size/2)
+    {
+        DOMAIN_IF(size < 2 || (size & (size - 1)));
+
+        const double one = ldexp(1.0, TW);
+        twr.get()[0] = twi.get()[0] = 0;
+        for (int h=1;h<n;h*=2)
+            for (int j=0;j<h;j++)
+            {
+                double t = -M_PI * j / h;
+                twr.get()[h+j] = IntType(floor(cos(t) * one + 0.5));
+                twi.get()[h+j] = IntType(floor(sin(t) * one + 0.5));
+            }
+        bit_reversal(rev.get(), n);
+        bit_reversal(rev_half.get(), n/2);
+    }
+
+    int size() const { return n; }
+
+    // Complex transforms of re[0..n) + i*im[0..n), in place
+    int forward(VFract* re, VFract* im) const
+    {
+        IntType* xr = reinterpret_cast<IntType*>(re);
+        IntType* xi = reinterpret_cast<IntType*>(im);
+        int e = transform(xr, xi, n, rev.get());
+        return e + scale(xr, xi, n, BITS-1, true);
+    }
+
+    // The inverse transform is the forward one with real and imaginary parts
+    // swapped, which is exact
+    int inverse(VFract* re, VFract* im) const
+    {
+        return forward(im, re) - logn;
+    }
+
+    // Transform of the real x[0..n) into the bins re[0..n/2] + i*im[0..n/2]
+    int forward_real(const VFract* x, VFract* re, VFract* im) const
+    {
+        const IntType* xs = reinterpret_cast<const IntType*>(x);
+        IntType* zr = reinterpret_cast<IntType*>(re);
+        IntType* zi = reinterpret_cast<IntType*>(im);
+        const int m = n / 2;
+
+        // Even and odd samples as a complex sequence of size n/2
+        for (int k=0;k<m;k++)
+        {
+            zr[k] = xs[2*k];
+            zi[k] = xs[2*k+1];
+        }
+        int e = transform(zr, zi, m, rev_half.get());
+        e += scale(zr, zi, m, WIDTH-3, false);
+        zr[m] = zr[0];
+        zi[m] = zi[0];
+
+        // X[k] = (Z[k] + conj(Z[m-k]))/2 - i/2 W(n)^k (Z[k] - conj(Z[m-k])), for
+        // the pairs k, m-k at once; W(n)^(m-k) = -conj(W(n)^k)
+        for (int k=0;k<=m/2;k++)
+        {
+            IntType ar = zr[k], ai = zi[k], br = zr[m-k], bi = zi[m-k];
+            IntType wr = twr.get()[m+k], wi = twi.get()[m+k];
+            split(zr[k], zi[k], ar, ai, br, bi, wr, wi);
+            if (k != m-k)
+                split(zr[m-k], zi[m-k], br, bi, ar, ai, -wr, wi);
+        }
+        return e + scale(zr, zi, m+1, BITS-1, true);
+    }
+
+    // Inverse of forward_real: the real x[0..n) from the bins re[0..n/2] + i*im[0..n/2]
+    int inverse_real(const VFract* re, const VFract* im, VFract* x) const
+    {
+        const int m = n / 2;
+        detail::AlignedBuffer<IntType> buf(2*m + 2);
+        IntType *zr = buf.get(), *zi = buf.get() + m + 1;
+
+        memcpy(zr, re, (m+1) * sizeof(IntType));
+        memcpy(zi, im, (m+1) * sizeof(IntType));
+        int e = scale(zr, zi, m+1, WIDTH-3, true);
+
+        // Z[k] = (X[k] + conj(X[m-k]))/2 + i/2 conj(W(n)^k) (X[k] - conj(X[m-k]))
+        for (int k=0;k<=m/2;k++)
+        {
+            IntType ar = zr[k], ai = zi[k], br = zr[m-k], bi = zi[m-k];
+            IntType wr = twr.get()[m+k], wi = twi.get()[m+k];
+            unsplit(zr[k], zi[k], ar, ai, br, bi, wr, wi);
+            if (k != m-k)
+                unsplit(zr[m-k], zi[m-k], br, bi, ar, ai, -wr, wi);
+        }
+
+        // The inverse of size n/2 gives back the even and odd samples
+        e += transform(zi, zr, m, rev_half.get()) - (logn - 1);
+        e += scale(zr, zi, m, BITS-1, true);
+        IntType* xs = reinterpret_cast<IntType*>(x);
+        for (int k=0;k<m;k++)
+        {
+            xs[2*k] = zr[k];
+            xs[2*k+1] = zi[k];
+        }
+        return e;
+    }
+};
+
+#endif // FIXEDFFT_H
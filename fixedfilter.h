@@ -0,0 +1,652 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains digital filters on streams of fixed-point samples.
+ */
+
+#ifndef FIXEDFILTER_H
+#define FIXEDFILTER_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include <complex>
+#include <math.h>
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // FirDelay -- delay line of a FIR filter, kept in a linear buffer right
+    // before the block of new samples, so that every output is computed on
+    // contiguous memory. After each block, the last samples are moved back
+    // to the front.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    class FirDelay
+    {
+        AlignedBuffer<IntType> buf;
+        int hist;
+
+    public:
+        enum { BLOCK = 1024 };
+
+        explicit FirDelay(int hist_) : buf(hist_ + BLOCK), hist(hist_) { reset(); }
+
+        void reset() { memset(buf.get(), 0, hist * sizeof(IntType)); }
+
+        // Append m <= BLOCK samples to the delay line, and return the start of
+        // the hist + m samples
+        const IntType* push(const IntType* in, int m)
+        {
+            memcpy(buf.get() + hist, in, m * sizeof(IntType));
+            return buf.get();
+        }
+
+        // Drop the oldest m samples
+        void pop(int m) { memmove(buf.get(), buf.get() + m, hist * sizeof(IntType)); }
+    };
+
+    // Copy the taps h[first], h[first+step], ... in reverse order into r[0..n),
+    // zero-padded, so that the filter is a dot product with the samples in
+    // increasing time order.
+    template <class IntType>
+    void FirReverse(IntType* r, int n, const IntType* h, int ntaps, int first, int step)
+    {
+        for (int k=0;k<n;k++)
+        {
+            int t = first + k*step;
+            r[n-1-k] = (t < ntaps) ? h[t] : IntType(0);
+        }
+    }
+
+    // Check that the sums of products of the taps by any samples of a format of
+    // bits bits fit the double-width accumulator: they are bounded by
+    // sum(|h[k]|) * 2^(bits-1).
+    template <class IntType>
+    void FirCheckGain(const IntType* h, int ntaps, int bits)
+    {
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+        const DIntType limit = DIntType(1) << (bitsof(DIntType) - bits);
+        DIntType g = 0;
+        for (int k=0;k<ntaps;k++)
+        {
+            g += (h[k] < 0) ? -DIntType(h[k]) : DIntType(h[k]);
+            OVERFLOW_IF(g >= limit);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FirFilter -- FIR filter y[n] = h[0]*x[n] + h[1]*x[n-1] + ... + h[N-1]*x[n-N+1]
+//
+// Samples are processed in blocks, through the batch kernels: the products are summed
+// exactly at double width and each output is rounded once (toward minus infinity),
+// instead of rounding and checking every tap like Fract::operator* and +=. Outputs
+// which do not fit the format follow the overflow policy (see FractSpan). The
+// constructor reports an overflow if the taps are so large that the sums could exceed
+// the accumulator (for formats which fill their integer, if the sum of |h[k]| reaches
+// 2^I). The delay line starts at zero, and it is kept across calls to process(), so a
+// stream can be filtered in pieces of any length.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class FirFilter
+{
+public:
+    typedef Fract<I,F> VFract;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::FirDelay<IntType> Delay;
+
+    detail::AlignedBuffer<IntType> h;
+    Delay delay;
+    detail::Limits<IntType> lim;
+    int n;
+
+public:
+    FirFilter(const VFract* taps, int ntaps, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : h(ntaps), delay(ntaps - 1), lim(I+F, policy), n(ntaps)
+    {
+        const IntType* t = reinterpret_cast<const IntType*>(taps);
+        detail::FirCheckGain(t, ntaps, I+F);
+        detail::FirReverse(h.get(), ntaps, t, ntaps, 0, 1);
+    }
+
+    int ntaps() const { return n; }
+
+    // Clear the delay line
+    void reset() { delay.reset(); }
+
+    // Filter in[0..count) into out[0..count); out may be in itself
+    void process(const VFract* in, VFract* out, int count)
+    {
+        const IntType* x = reinterpret_cast<const IntType*>(in);
+        IntType* y = reinterpret_cast<IntType*>(out);
+
+        for (int i=0;i<count;i+=Delay::BLOCK)
+        {
+            int m = (count - i < Delay::BLOCK) ? count - i : Delay::BLOCK;
+            const IntType* w = delay.push(x + i, m);
+            detail::Batch<IntType>::fir(y + i, 1, w, 1, h.get(), n, m, F, lim);
+            delay.pop(m);
+        }
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FirDecimator -- FIR filter which keeps one output every factor samples
+//
+// The outputs are those of FirFilter for the input samples 0, factor, 2*factor, ...
+// of the stream (counted across calls), but only they are computed.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class FirDecimator
+{
+public:
+    typedef Fract<I,F> VFract;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::FirDelay<IntType> Delay;
+
+    detail::AlignedBuffer<IntType> h;
+    Delay delay;
+    detail::Limits<IntType> lim;
+    int n, factor, phase;
+
+public:
+    FirDecimator(const VFract* taps, int ntaps, int factor_,
+                 FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : h(ntaps), delay(ntaps - 1), lim(I+F, policy), n(ntaps), factor(factor_), phase(0)
+    {
+        const IntType* t = reinterpret_cast<const IntType*>(taps);
+        DOMAIN_IF(factor < 1);
+        detail::FirCheckGain(t, ntaps, I+F);
+        detail::FirReverse(h.get(), ntaps, t, ntaps, 0, 1);
+    }
+
+    int ntaps() const { return n; }
+
+    // Clear the delay line, and restart from the first output
+    void reset() { delay.reset(); phase = 0; }
+
+    // Filter in[0..count), and return the number of outputs written to out (at
+    // most count / factor + 1)
+    int process(const VFract* in, VFract* out, int count)
+    {
+        const IntType* x = reinterpret_cast<const IntType*>(in);
+        IntType* y = reinterpret_cast<IntType*>(out);
+        int written = 0;
+
+        for (int i=0;i<count;i+=Delay::BLOCK)
+        {
+            int m = (count - i < Delay::BLOCK) ? count - i : Delay::BLOCK;
+            const IntType* w = delay.push(x + i, m);
+
+            // Outputs for the samples phase, phase + factor, ... of this block
+            int k = (phase < m) ? (m - phase + factor - 1) / factor : 0;
+            detail::Batch<IntType>::fir(y + written, 1, w + phase, factor, h.get(), n, k, F, lim);
+            written += k;
+            phase += k*factor - m;
+            delay.pop(m);
+        }
+        return written;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FirInterpolator -- FIR filter on the input stream upsampled by factor
+//
+// Each input sample is followed by factor-1 zeros, and the result is filtered, so
+// process() writes factor outputs for each input. The filter is split into factor
+// polyphase filters of ntaps/factor taps (rounded up), which run on the input samples
+// without computing the products by the zeros.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class FirInterpolator
+{
+public:
+    typedef Fract<I,F> VFract;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::FirDelay<IntType> Delay;
+
+    detail::AlignedBuffer<IntType> h;
+    detail::Limits<IntType> lim;
+    int n, factor, nphase;
+    Delay delay;
+
+public:
+    FirInterpolator(const VFract* taps, int ntaps, int factor_,
+                    FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : h(ntaps + factor_), lim(I+F, policy), n(ntaps), factor(factor_),
+          nphase((ntaps + factor_ - 1) / factor_), delay(nphase - 1)
+    {
+        const IntType* t = reinterpret_cast<const IntType*>(taps);
+        DOMAIN_IF(factor < 1);
+        detail::FirCheckGain(t, ntaps, I+F);
+        for (int p=0;p<factor;p++)
+            detail::FirReverse(h.get() + p*nphase, nphase, t, ntaps, p, factor);
+    }
+
+    int ntaps() const { return n; }
+
+    // Clear the delay line
+    void reset() { delay.reset(); }
+
+    // Filter in[0..count) into out[0..count*factor)
+    void process(const VFract* in, VFract* out, int count)
+    {
+        const IntType* x = reinterpret_cast<const IntType*>(in);
+        IntType* y = reinterpret_cast<IntType*>(out);
+
+        for (int i=0;i<count;i+=Delay::BLOCK)
+        {
+            int m = (count - i < Delay::BLOCK) ? count - i : Delay::BLOCK;
+            const IntType* w = delay.push(x + i, m);
+            for (int p=0;p<factor;p++)
+                detail::Batch<IntType>::fir(y + i*factor + p, factor, w, 1,
+                                            h.get() + p*nphase, nphase, m, F, lim);
+            delay.pop(m);
+        }
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// BiquadCoeffs -- second-order section
+//
+//              b0 + b1 z^-1 + b2 z^-2
+//      H(z) = ------------------------
+//              1  + a1 z^-1 + a2 z^-2
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+struct BiquadCoeffs
+{
+    double b0, b1, b2, a1, a2;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// biquad_quantize -- quantize the coefficients of a cascade of n biquads to bits bits
+//
+// All the coefficients are rounded to nearest with the same number of fractional bits,
+// the largest for which they all fit: Fract<bits - frac, frac> is the best format for
+// them. If raw is not NULL, it receives the quantized coefficients as integers (b0, b1,
+// b2, a1, a2 for each section). The result also tells how much the quantization moved
+// the poles and the zeros (the largest distance in the z-plane, within a section),
+// and the largest radius of the quantized poles, which must be below 1 for the filter
+// to be stable. A domain error is reported if the coefficients do not fit bits bits
+// even without fractional bits.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+struct BiquadQuantization
+{
+    int bits, frac;
+    double pole_shift, zero_shift;
+    double pole_radius;
+};
+
+namespace detail {
+
+    // Roots of a*z^2 + b*z + c; return how many are finite
+    inline int QuadRoots(double a, double b, double c, std::complex<double>* r)
+    {
+        if (a == 0)
+        {
+            if (b == 0)
+                return 0;
+            r[0] = -c / b;
+            return 1;
+        }
+        std::complex<double> d = std::sqrt(std::complex<double>(b*b - 4*a*c, 0));
+        r[0] = (-b + d) / (2*a);
+        r[1] = (-b - d) / (2*a);
+        return 2;
+    }
+
+    // Largest distance between the roots of two quadratics, paired at best
+    inline double RootShift(double a, double b, double c, double qa, double qb, double qc)
+    {
+        std::complex<double> r[2], q[2];
+        int n = QuadRoots(a, b, c, r);
+        if (n != QuadRoots(qa, qb, qc, q))
+            return HUGE_VAL;
+        if (n < 2)
+            return n ? std::abs(r[0] - q[0]) : 0;
+        double d1 = std::max(std::abs(r[0] - q[0]), std::abs(r[1] - q[1]));
+        double d2 = std::max(std::abs(r[0] - q[1]), std::abs(r[1] - q[0]));
+        return std::min(d1, d2);
+    }
+}
+
+inline BiquadQuantization biquad_quantize(const BiquadCoeffs* s, int n, int bits, int64_t* raw = NULL)
+{
+    DOMAIN_IF(bits < 2 || bits > 63);
+    const double hi = ldexp(1.0, bits-1);
+
+    BiquadQuantization q;
+    q.bits = bits;
+    for (q.frac = bits-1; q.frac >= 0; q.frac--)
+    {
+        bool fit = true;
+        for (int k=0;k<n && fit;k++)
+        {
+            const double* c = &s[k].b0;
+            for (int j=0;j<5;j++)
+            {
+                double v = floor(ldexp(c[j], q.frac) + 0.5);
+                fit = fit && (v >= -hi && v < hi);
+            }
+        }
+        if (fit)
+            break;
+    }
+    DOMAIN_IF(q.frac < 0);
+
+    q.pole_shift = q.zero_shift = q.pole_radius = 0;
+    for (int k=0;k<n;k++)
+    {
+        const double* c = &s[k].b0;
+        double r[5];
+        for (int j=0;j<5;j++)
+        {
+            double v = floor(ldexp(c[j], q.frac) + 0.5);
+            if (raw)
+                raw[5*k + j] = int64_t(v);
+            r[j] = ldexp(v, -q.frac);
+        }
+
+        std::complex<double> p[2];
+        int np = detail::QuadRoots(1, r[3], r[4], p);
+        for (int j=0;j<np;j++)
+            q.pole_radius = std::max(q.pole_radius, std::abs(p[j]));
+        q.pole_shift = std::max(q.pole_shift, detail::RootShift(1, c[3], c[4], 1, r[3], r[4]));
+        q.zero_shift = std::max(q.zero_shift, detail::RootShift(c[0], c[1], c[2], r[0], r[1], r[2]));
+    }
+    return q;
+}
+
+enum BiquadForm
+{
+    BIQUAD_DF1,         // Direct Form I: the state is the last two inputs and outputs
+    BIQUAD_DF2T         // Direct Form II transposed: the state is two wide partial sums
+};
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // BiquadScalar -- reference kernel of BiquadCascade, one channel at a
+    // time. Sums are exact in SumType, and rounded once per section output;
+    // with error feedback, the bits dropped by the rounding are added to
+    // the next sum of the section. The state of section k and channel c is
+    // st[(k*NSTATE + slot)*nch + c].
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct BiquadScalar
+    {
+        typedef typename BatchScalar<IntType>::SumType SumType;
+        enum { X1, X2, Y1, Y2, E, NSTATE };     // DF2T keeps its sums in X1 and X2
+
+        static IntType fix(SumType v, const Limits<IntType>& lim)
+        {
+            if (v >= lim.lo && v <= lim.hi)
+                return IntType(v);
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                return (v < lim.lo) ? lim.lo : lim.hi;
+            case FRACT_OVERFLOW_WRAP:
+                return BatchScalar<IntType>::wrap(typename BatchScalar<IntType>::DIntType(v), lim.bits);
+            default:
+                OVERFLOW_IF(true);
+                return IntType(v);
+            }
+        }
+
+        static void channel(IntType* out, const IntType* in, int frames, int nch,
+                            const IntType* cf, int nsec, SumType* st, int frac,
+                            BiquadForm form, bool ef, const Limits<IntType>& lim)
+        {
+            const SumType mask = ef ? (SumType(1) << frac) - 1 : 0;
+
+            for (int i=0;i<frames;i++)
+            {
+                SumType x = in[i*nch];
+                for (int k=0;k<nsec;k++)
+                {
+                    const IntType* b = cf + 5*k;
+                    SumType* s = st + k*NSTATE*nch;
+                    SumType acc;
+                    IntType y;
+
+                    if (form == BIQUAD_DF1)
+                    {
+                        acc = b[0]*x + b[1]*s[X1*nch] + b[2]*s[X2*nch]
+                            - b[3]*s[Y1*nch] - b[4]*s[Y2*nch] + s[E*nch];
+                        y = fix(acc >> frac, lim);
+                        s[X2*nch] = s[X1*nch];
+                        s[X1*nch] = x;
+                        s[Y2*nch] = s[Y1*nch];
+                        s[Y1*nch] = y;
+                    }
+                    else
+                    {
+                        acc = b[0]*x + s[X1*nch] + s[E*nch];
+                        y = fix(acc >> frac, lim);
+                        s[X1*nch] = b[1]*x - b[3]*SumType(y) + s[X2*nch];
+                        s[X2*nch] = b[2]*x - b[4]*SumType(y);
+                    }
+                    s[E*nch] = acc & mask;
+                    x = y;
+                }
+                out[i*nch] = IntType(x);
+            }
+        }
+
+        static void run(IntType* out, const IntType* in, int frames, int nch,
+                        const IntType* cf, int nsec, SumType* st, int frac,
+                        BiquadForm form, bool ef, const Limits<IntType>& lim)
+        {
+            for (int c=0;c<nch;c++)
+                channel(out + c, in + c, frames, nch, cf, nsec, st + c, frac, form, ef, lim);
+        }
+    };
+
+    template <class IntType>
+    struct Biquad : public BiquadScalar<IntType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    /////////////////////////////////////////////////////////////////////////
+    // Biquad<int32_t> -- four channels at a time, one in each 64-bit lane
+    /////////////////////////////////////////////////////////////////////////
+    template <>
+    struct Biquad<int32_t> : public BiquadScalar<int32_t>
+    {
+        typedef BiquadScalar<int32_t> Scalar;
+
+        static __m256i fix(__m256i v, const Limits<int32_t>& lim)
+        {
+            __m256i lo = _mm256_set1_epi64x(lim.lo), hi = _mm256_set1_epi64x(lim.hi);
+            __m256i under = _mm256_cmpgt_epi64(lo, v), over = _mm256_cmpgt_epi64(v, hi);
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                return _mm256_blendv_epi8(_mm256_blendv_epi8(v, lo, under), hi, over);
+            case FRACT_OVERFLOW_WRAP:
+                {
+                    __m256i sh = _mm256_set1_epi64x(64 - lim.bits);
+                    return avx2::srav64(_mm256_sllv_epi64(v, sh), sh);
+                }
+            default:
+                OVERFLOW_IF(avx2::any(_mm256_or_si256(under, over)));
+                return v;
+            }
+        }
+
+        static __m256i load(const int64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+        static void store(int64_t* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+        static __m256i mul(int32_t c, __m256i x) { return _mm256_mul_epi32(_mm256_set1_epi64x(c), x); }
+
+        static void group(int32_t* out, const int32_t* in, int frames, int nch,
+                          const int32_t* cf, int nsec, int64_t* st, int frac,
+                          BiquadForm form, bool ef, const Limits<int32_t>& lim)
+        {
+            const __m256i mask = _mm256_set1_epi64x(ef ? (int64_t(1) << frac) - 1 : 0);
+            const __m256i sh = _mm256_set1_epi64x(frac);
+            const __m256i pick = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+            for (int i=0;i<frames;i++)
+            {
+                __m256i x = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(in + i*nch)));
+                for (int k=0;k<nsec;k++)
+                {
+                    const int32_t* b = cf + 5*k;
+                    int64_t* s = st + k*NSTATE*nch;
+                    __m256i acc, y;
+
+                    if (form == BIQUAD_DF1)
+                    {
+                        __m256i x1 = load(s + X1*nch), y1 = load(s + Y1*nch);
+                        acc = _mm256_add_epi64(mul(b[0], x), mul(b[1], x1));
+                        acc = _mm256_add_epi64(acc, mul(b[2], load(s + X2*nch)));
+                        acc = _mm256_sub_epi64(acc, mul(b[3], y1));
+                        acc = _mm256_sub_epi64(acc, mul(b[4], load(s + Y2*nch)));
+                        acc = _mm256_add_epi64(acc, load(s + E*nch));
+                        y = fix(avx2::srav64(acc, sh), lim);
+                        store(s + X2*nch, x1);
+                        store(s + X1*nch, x);
+                        store(s + Y2*nch, y1);
+                        store(s + Y1*nch, y);
+                    }
+                    else
+                    {
+                        acc = _mm256_add_epi64(mul(b[0], x), load(s + X1*nch));
+                        acc = _mm256_add_epi64(acc, load(s + E*nch));
+                        y = fix(avx2::srav64(acc, sh), lim);
+                        store(s + X1*nch, _mm256_add_epi64(_mm256_sub_epi64(mul(b[1], x), mul(b[3], y)),
+                                                           load(s + X2*nch)));
+                        store(s + X2*nch, _mm256_sub_epi64(mul(b[2], x), mul(b[4], y)));
+                    }
+                    store(s + E*nch, _mm256_and_si256(acc, mask));
+                    x = y;
+                }
+                _mm_storeu_si128((__m128i*)(out + i*nch),
+                                 _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(x, pick)));
+            }
+        }
+
+        static void run(int32_t* out, const int32_t* in, int frames, int nch,
+                        const int32_t* cf, int nsec, int64_t* st, int frac,
+                        BiquadForm form, bool ef, const Limits<int32_t>& lim)
+        {
+            int c = 0;
+            for (;c+4<=nch;c+=4)
+                group(out + c, in + c, frames, nch, cf, nsec, st + c, frac, form, ef, lim);
+            for (;c<nch;c++)
+                Scalar::channel(out + c, in + c, frames, nch, cf, nsec, st + c, frac, form, ef, lim);
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// BiquadCascade -- IIR filter made of a cascade of biquads (see BiquadCoeffs)
+//
+// The coefficients are quantized by biquad_quantize() to COEFF_BITS bits, which is
+// I+F unless the samples are so wide that the sums would not fit the accumulator:
+// quantization() reports the result, and the displacement of poles and zeros. Each
+// section sums its products exactly in a wide accumulator, and rounds its output once
+// toward minus infinity; in Direct Form II transposed, the two states are also kept
+// wide. With error feedback, the bits dropped by the rounding are added to the next
+// sum (first-order noise shaping), which lowers the noise of narrow formats at low
+// frequencies. Outputs which do not fit the format follow the overflow policy (see
+// FractSpan).
+//
+// Samples of several channels are interleaved (one frame is a sample of each
+// channel), and each channel has its own state; with AVX2, formats stored in 32 bits
+// are filtered four channels at a time.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class BiquadCascade
+{
+public:
+    typedef Fract<I,F> VFract;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::Biquad<IntType> Kernel;
+    typedef typename Kernel::SumType SumType;
+
+    enum { SUM_BITS = bitsof(SumType) - 3 - (I+F) };
+
+public:
+    enum { COEFF_BITS = (I+F < SUM_BITS) ? I+F : SUM_BITS };
+
+private:
+    detail::AlignedBuffer<IntType> cf;
+    detail::AlignedBuffer<SumType> st;
+    detail::Limits<IntType> lim;
+    BiquadQuantization q;
+    int nsec, nch;
+    BiquadForm form;
+    bool ef;
+
+public:
+    BiquadCascade(const BiquadCoeffs* sections, int nsections, int channels = 1,
+                  BiquadForm form_ = BIQUAD_DF2T, bool error_feedback = false,
+                  FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : cf(5*nsections), st(Kernel::NSTATE * nsections * channels), lim(I+F, policy),
+          nsec(nsections), nch(channels), form(form_), ef(error_feedback)
+    {
+        DOMAIN_IF(nsections < 1 || channels < 1);
+        detail::AlignedBuffer<int64_t> raw(5*nsections);
+        q = biquad_quantize(sections, nsections, COEFF_BITS, raw.get());
+        for (int i=0;i<5*nsections;i++)
+            cf.get()[i] = IntType(raw.get()[i]);
+        reset();
+    }
+
+    const BiquadQuantization& quantization() const { return q; }
+    int channels() const { return nch; }
+
+    // Clear the state of all channels
+    void reset() { memset(st.get(), 0, Kernel::NSTATE * nsec * nch * sizeof(SumType)); }
+
+    // Filter frames frames of interleaved samples from in to out; out may be in itself
+    void process(const VFract* in, VFract* out, int frames)
+    {
+        Kernel::run(reinterpret_cast<IntType*>(out), reinterpret_cast<const IntType*>(in), frames,
+                    nch, cf.get(), nsec, st.get(), q.frac, form, ef, lim);
+    }
+};
+
+#endif // FIXEDFILTER_H
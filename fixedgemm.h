@@ -0,0 +1,695 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains the product of dense matrices of fixed-point numbers.
+ */
+
+#ifndef FIXEDGEMM_H
+#define FIXEDGEMM_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include "fixedpoint/parallel.h"
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // GemmScalar -- reference implementation of the matrix product. Each
+    // element is accumulated exactly at double width and rounded once, like
+    // the Matrix product; rows are split across threads.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct GemmScalar
+    {
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+
+        // Rows [i0,i1) of C = A*B. Overflows are reported through ovf.
+        static void rows(int i0, int i1, int n, int k,
+                         const IntType* A, int lda, const IntType* B, int ldb,
+                         IntType* C, int ldc, int shift, int ibits, int& ovf)
+        {
+            for (int i=i0;i<i1;i++)
+                for (int j=0;j<n;j++)
+                {
+                    WideSum<DIntType> s;
+                    for (int p=0;p<k;p++)
+                        s.add(DIntType(A[i*lda + p]) * B[p*ldb + j]);
+                    DIntType acc = DIntType(s.acc);
+                    ovf |= s.overflow() || !AnyInt::FitIn(DIntType(acc >> (shift*2)), ibits);
+                    C[i*ldc + j] = IntType(acc >> shift);
+                }
+        }
+
+        static void run(int m, int n, int k,
+                        const IntType* A, int lda, const IntType* B, int ldb,
+                        IntType* C, int ldc, int shift, int ibits)
+        {
+            int nchunks = NumChunks(m, 16, MaxThreads());
+            int ovf = 0;
+
+            FRACT_OMP(omp parallel for schedule(static) reduction(|:ovf))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(m, nchunks, t, begin, end);
+                rows(begin, end, n, k, A, lda, B, ldb, C, ldc, shift, ibits, ovf);
+            }
+
+            OVERFLOW_IF(ovf);
+        }
+    };
+
+    template <class IntType>
+    struct Gemm : public GemmScalar<IntType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    /////////////////////////////////////////////////////////////////////////
+    // Gemm<int32_t> -- blocked product with packed panels. Threads take
+    // blocks of MC rows of A; for each block of NC columns and KC rows of B,
+    // the panels of A and B are packed into contiguous strips of MR rows and
+    // NR columns, which are multiplied by the micro-kernel into 64-bit
+    // accumulators. The accumulators are rounded once, after the last panel.
+    //
+    // The 64-bit accumulators are exact only if no partial sum can exceed
+    // 2^63. This is checked beforehand from the magnitude of the inputs, and
+    // the exact scalar kernel is used otherwise, so the results are always
+    // the same.
+    /////////////////////////////////////////////////////////////////////////
+    template <>
+    struct Gemm<int32_t> : public GemmScalar<int32_t>
+    {
+        typedef GemmScalar<int32_t> Scalar;
+        enum { MR = 4, NR = 8, MC = 64, KC = 256, NC = 256 };
+
+        // Number of bits needed by the largest magnitude in a rows x cols matrix
+        static int magnitude(const int32_t* a, int rows, int cols, int ld)
+        {
+            int32_t m = 0;
+            for (int i=0;i<rows;i++)
+                for (int j=0;j<cols;j++)
+                    m |= a[i*ld + j] ^ (a[i*ld + j] >> 31);
+            return AnyInt::Log2Ceil(m);
+        }
+
+        // Pack mc x kc of A into strips of MR rows, column by column
+        static void packA(int32_t* ap, const int32_t* A, int lda, int mc, int kc)
+        {
+            for (int ir=0;ir<mc;ir+=MR)
+                for (int p=0;p<kc;p++)
+                    for (int r=0;r<MR;r++)
+                        *ap++ = (ir + r < mc) ? A[(ir + r)*lda + p] : 0;
+        }
+
+        // Pack kc x nc of B into strips of NR columns, row by row
+        static void packB(int32_t* bp, const int32_t* B, int ldb, int kc, int nc)
+        {
+            for (int jr=0;jr<nc;jr+=NR)
+                for (int p=0;p<kc;p++)
+                    for (int c=0;c<NR;c++)
+                        *bp++ = (jr + c < nc) ? B[p*ldb + jr + c] : 0;
+        }
+
+        // acc += ap * bp, for a strip of MR rows and one of NR columns. The
+        // accumulators of each row keep the even columns in the first four
+        // lanes, and the odd ones in the last four.
+        static void kernel(const int32_t* ap, const int32_t* bp, int kc, int64_t* acc, int ldacc)
+        {
+            __m256i e[MR], o[MR];
+            for (int r=0;r<MR;r++)
+            {
+                e[r] = _mm256_load_si256((const __m256i*)(acc + r*ldacc));
+                o[r] = _mm256_load_si256((const __m256i*)(acc + r*ldacc + 4));
+            }
+            for (int p=0;p<kc;p++)
+            {
+                __m256i b = _mm256_load_si256((const __m256i*)(bp + p*NR));
+                __m256i bo = _mm256_srli_epi64(b, 32);
+                for (int r=0;r<MR;r++)
+                {
+                    __m256i a = _mm256_set1_epi32(ap[p*MR + r]);
+                    e[r] = _mm256_add_epi64(e[r], _mm256_mul_epi32(a, b));
+                    o[r] = _mm256_add_epi64(o[r], _mm256_mul_epi32(a, bo));
+                }
+            }
+            for (int r=0;r<MR;r++)
+            {
+                _mm256_store_si256((__m256i*)(acc + r*ldacc), e[r]);
+                _mm256_store_si256((__m256i*)(acc + r*ldacc + 4), o[r]);
+            }
+        }
+
+        // Round the mc x nc accumulators into C
+        static void store(int32_t* C, int ldc, const int64_t* acc, int mc, int nc,
+                          const avx2::Range& rng, int& ovf)
+        {
+            __m256i vovf = _mm256_setzero_si256();
+            for (int i=0;i<mc;i++)
+                for (int j=0;j<nc;j+=NR)
+                {
+                    const int64_t* a = acc + i*NC + j;
+                    __m256i r = rng.narrow(_mm256_load_si256((const __m256i*)a),
+                                           _mm256_load_si256((const __m256i*)(a + 4)), vovf);
+                    if (j + NR <= nc)
+                        avx2::store(C + i*ldc + j, r);
+                    else
+                    {
+                        int32_t tmp[NR];
+                        avx2::store(tmp, r);
+                        memcpy(C + i*ldc + j, tmp, (nc - j) * sizeof(int32_t));
+                    }
+                }
+            ovf |= avx2::any(vovf);
+        }
+
+        static void run(int m, int n, int k,
+                        const int32_t* A, int lda, const int32_t* B, int ldb,
+                        int32_t* C, int ldc, int shift, int ibits)
+        {
+            if (magnitude(A, m, k, lda) + magnitude(B, k, n, ldb) + AnyInt::Log2Ceil(k) > 63)
+            {
+                Scalar::run(m, n, k, A, lda, B, ldb, C, ldc, shift, ibits);
+                return;
+            }
+
+            avx2::Range rng(ibits + shift*2, shift);
+            int nblocks = (m + MC - 1) / MC;
+            int ovf = 0;
+
+            FRACT_OMP(omp parallel reduction(|:ovf))
+            {
+                AlignedBuffer<int32_t> ap(MC * KC), bp(KC * NC);
+                AlignedBuffer<int64_t> acc(MC * NC);
+
+                FRACT_OMP(omp for schedule(static))
+                for (int ib=0;ib<nblocks;ib++)
+                {
+                    int i0 = ib * MC;
+                    int mc = (m - i0 < MC) ? m - i0 : MC;
+                    for (int j0=0;j0<n;j0+=NC)
+                    {
+                        int nc = (n - j0 < NC) ? n - j0 : NC;
+                        memset(acc.get(), 0, MC * NC * sizeof(int64_t));
+                        for (int p0=0;p0<k;p0+=KC)
+                        {
+                            int kc = (k - p0 < KC) ? k - p0 : KC;
+                            packA(ap.get(), A + i0*lda + p0, lda, mc, kc);
+                            packB(bp.get(), B + p0*ldb + j0, ldb, kc, nc);
+                            for (int jr=0;jr<nc;jr+=NR)
+                                for (int ir=0;ir<mc;ir+=MR)
+                                    kernel(ap.get() + ir*kc, bp.get() + jr*kc, kc, acc.get() + ir*NC + jr, NC);
+                        }
+                        store(C + i0*ldc + j0, ldc, acc.get(), mc, nc, rng, ovf);
+                    }
+                }
+            }
+
+            OVERFLOW_IF(ovf);
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// gemm -- product of dense matrices: C = A * B
+//
+// A is m x k, B is k x n and C is m x n, all of them stored by rows, with lda, ldb and
+// ldc elements between the starts of two consecutive rows. C must not overlap A or B.
+// Each element of C is accumulated exactly at double width and rounded once (toward
+// minus infinity, like the Matrix product); an overflow is reported if it does not fit
+// the format. The work is split across threads (see fixedpoint/parallel.h), and the
+// results do not depend on the number of threads.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+void gemm(int m, int n, int k,
+          const Fract<I,F>* A, int lda, const Fract<I,F>* B, int ldb,
+          Fract<I,F>* C, int ldc)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    STATIC_ASSERT(sizeof(Fract<I,F>) == sizeof(IntType), "Fract must be a plain wrapper of its integer");
+
+    detail::Gemm<IntType>::run(m, n, k,
+                               reinterpret_cast<const IntType*>(A), lda,
+                               reinterpret_cast<const IntType*>(B), ldb,
+                               reinterpret_cast<IntType*>(C), ldc, F, I);
+}
+
+#ifdef FRACT_HAS_128BITS
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // Requant -- conversion of the exact sums of products of quantized
+    // numbers (with accfrac fractional bits) to the output format, after a
+    // multiplication by the scale factor of the row (or by one, if scale is
+    // NULL). The result is rounded toward minus infinity, and the overflow
+    // policy applies to the I+F bits of the output format; overflows with
+    // FRACT_OVERFLOW_CHECK are only flagged, since the conversion runs
+    // inside parallel regions.
+    /////////////////////////////////////////////////////////////////////////
+    template <class OutType, class ScaleType>
+    struct Requant
+    {
+        typedef AnyInt::DoubleType<int64_t>::type WideType;
+        typedef AnyInt::Unsigned<WideType>::type UWideType;
+
+        const ScaleType* scale;
+        int shift;
+        Limits<OutType> lim;
+
+        Requant(const ScaleType* scale_, int accfrac, int scalefrac, int F, int bits,
+                FractOverflowPolicy policy)
+            : scale(scale_), shift(accfrac + (scale_ ? scalefrac : 0) - F), lim(bits, policy)
+        {}
+
+        OutType operator()(int64_t acc, int row, int& ovf) const
+        {
+            WideType x = scale ? WideType(acc) * scale[row] : WideType(acc);
+            if (shift >= 0)
+                x >>= shift;
+            else
+            {
+                WideType lo = WideType(lim.lo) >> -shift, hi = WideType(lim.hi) >> -shift;
+                if (x < lo || x > hi)
+                    return fix(x < lo ? WideType(lim.lo) - 1 : WideType(lim.hi) + 1,
+                               OutType(UWideType(x) << -shift), ovf);
+                x = WideType(UWideType(x) << -shift);
+            }
+            return fix(x, OutType(x), ovf);
+        }
+
+        // Apply the policy to x, whose low bits are in low
+        OutType fix(WideType x, OutType low, int& ovf) const
+        {
+            if (x >= lim.lo && x <= lim.hi)
+                return OutType(x);
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                return (x < lim.lo) ? lim.lo : lim.hi;
+            case FRACT_OVERFLOW_WRAP:
+                return BatchScalar<OutType>::wrap(low, lim.bits);
+            default:
+                ovf = 1;
+                return low;
+            }
+        }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // QGemmScalar -- reference kernels for the quantized formats Fract<1,QF>
+    // (QF is 7 or 15). Sums of products are computed exactly in 64 bits.
+    //
+    // Packed holds B in the form used by block(); the scalar kernel uses B
+    // as it is.
+    /////////////////////////////////////////////////////////////////////////
+    template <int QF>
+    struct QGemmScalar
+    {
+        typedef typename FractAccess::Traits<1,QF>::IntType IntType;
+        enum { MR = 4 };
+
+        struct Packed
+        {
+            const IntType* b;
+            int ldb;
+
+            Packed(const IntType* B, int ldb_, int, int) : b(B), ldb(ldb_) {}
+        };
+
+        // acc[r*n + j] = sum of A[r][p] * B[p][j], for the first mr <= MR rows of A
+        static void block(int64_t* acc, int mr, int n, int k, const IntType* A, int lda, const Packed& B)
+        {
+            memset(acc, 0, mr * n * sizeof(int64_t));
+            for (int r=0;r<mr;r++)
+                for (int p=0;p<k;p++)
+                {
+                    int32_t a = A[r*lda + p];
+                    const IntType* b = B.b + p*B.ldb;
+                    for (int j=0;j<n;j++)
+                        acc[r*n + j] += a * int32_t(b[j]);
+                }
+        }
+
+        // Sum of a[p] * x[p]
+        static int64_t dot(const IntType* a, const IntType* x, int k)
+        {
+            int64_t s = 0;
+            for (int p=0;p<k;p++)
+                s += int32_t(a[p]) * int32_t(x[p]);
+            return s;
+        }
+    };
+
+    template <int QF>
+    struct QGemm : public QGemmScalar<QF>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    namespace avx2
+    {
+        // Sums of products of adjacent pairs of int16 lanes. The sums are
+        // at most 2^31 (only for two products of -2^15 by -2^15), which
+        // pmaddwd wraps to -2^31; they are returned minus 2^16, which
+        // always fits, and split into their high and low 16 bits.
+        inline void madd16(__m256i& hi, __m256i& lo, __m256i a, __m256i b)
+        {
+            __m256i y = _mm256_sub_epi32(_mm256_madd_epi16(a, b), _mm256_set1_epi32(65536));
+            hi = _mm256_add_epi32(hi, _mm256_srai_epi32(y, 16));
+            lo = _mm256_add_epi32(lo, _mm256_and_si256(y, _mm256_set1_epi32(0xFFFF)));
+        }
+
+        // Eight int32 lanes of v, widened and added to acc[0..8)
+        inline void widen_add(int64_t* acc, __m256i v)
+        {
+            int32_t t[8];
+            store(t, v);
+            for (int c=0;c<8;c++)
+                acc[c] += t[c];
+        }
+
+        // Sixteen int16 from int8 or int32 (which must fit in 16 bits). The
+        // int32 ones are packed in a permuted order, which is harmless as
+        // long as both operands of a product come out in the same order.
+        inline __m256i load16(const int8_t* p)
+        { return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)p)); }
+        inline __m256i load16(const int32_t* p)
+        { return _mm256_packs_epi32(load(p), load(p + 8)); }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // QGemmAvx2 -- pmaddwd kernels. B is packed into strips of NR columns,
+    // interleaving the int16 values of pairs of consecutive rows, so that a
+    // pmaddwd by a broadcast pair of A computes two steps of the product
+    // for NR columns. The int8 sums (at most 2^15 each) are accumulated in
+    // 32-bit lanes, the int16 ones are split by madd16(); both are flushed
+    // to 64 bits every KQ pairs, so there is no limit on k.
+    /////////////////////////////////////////////////////////////////////////
+    template <int QF>
+    struct QGemmAvx2 : public QGemmScalar<QF>
+    {
+        typedef typename QGemmScalar<QF>::IntType IntType;
+        enum { MR = 4, NR = 8, KQ = 16384 };
+
+        struct Packed
+        {
+            AlignedBuffer<int16_t> buf;
+            int kp;
+
+            static int size(int k, int n) { return ((k + 1) / 2) * 2 * ((n + NR - 1) / NR) * NR; }
+
+            Packed(const IntType* B, int ldb, int k, int n)
+                : buf(size(k, n)), kp((k + 1) / 2)
+            {
+                int16_t* bp = buf.get();
+                for (int jr=0;jr<n;jr+=NR)
+                    for (int p=0;p<kp*2;p+=2)
+                        for (int c=0;c<NR;c++)
+                        {
+                            bool in = (jr + c < n);
+                            *bp++ = in ? int16_t(B[p*ldb + jr + c]) : 0;
+                            *bp++ = (in && p + 1 < k) ? int16_t(B[(p+1)*ldb + jr + c]) : 0;
+                        }
+            }
+        };
+
+        static void block(int64_t* acc, int mr, int n, int k, const IntType* A, int lda, const Packed& B)
+        {
+            int kp = B.kp;
+            AlignedBuffer<int32_t> ap(kp * MR);
+            int32_t* a = ap.get();
+            for (int q=0;q<kp;q++)
+                for (int r=0;r<MR;r++)
+                {
+                    int p = q*2;
+                    int16_t a0 = (r < mr) ? int16_t(A[r*lda + p]) : 0;
+                    int16_t a1 = (r < mr && p + 1 < k) ? int16_t(A[r*lda + p + 1]) : 0;
+                    a[q*MR + r] = int32_t(uint16_t(a0) | (uint32_t(uint16_t(a1)) << 16));
+                }
+
+            memset(acc, 0, mr * n * sizeof(int64_t));
+            for (int jr=0;jr<n;jr+=NR)
+            {
+                const int16_t* bp = B.buf.get() + jr*kp*2;
+                int nr = (n - jr < NR) ? n - jr : NR;
+                int64_t tmp[MR][NR] = {{0}};
+
+                for (int q0=0;q0<kp;q0+=KQ)
+                {
+                    int q1 = (kp - q0 < KQ) ? kp : q0 + KQ;
+                    flush(tmp, bp, a, q0, q1);
+                }
+
+                for (int r=0;r<mr;r++)
+                    memcpy(acc + r*n + jr, tmp[r], nr * sizeof(int64_t));
+            }
+        }
+
+        static void flush(int64_t (*tmp)[NR], const int16_t* bp, const int32_t* a, int q0, int q1);
+
+        static int64_t dot(const IntType* a, const IntType* x, int k)
+        {
+            int p = 0;
+            int64_t s = 0;
+            for (int p0=0;p0+16<=k;p0=p)
+            {
+                int p1 = (k - p0 < KQ*2) ? k : p0 + KQ*2;
+                s += dot16(a, x, p0, p1, p);
+            }
+            return s + QGemmScalar<QF>::dot(a + p, x + p, k - p);
+        }
+
+        // Sum of a[p] * x[p] for p in [p0,end), where end is the last
+        // multiple of 16 elements that fits within p1
+        static int64_t dot16(const IntType* a, const IntType* x, int p0, int p1, int& end);
+    };
+
+    template <>
+    inline void QGemmAvx2<7>::flush(int64_t (*tmp)[NR], const int16_t* bp, const int32_t* a, int q0, int q1)
+    {
+        __m256i s[MR];
+        for (int r=0;r<MR;r++)
+            s[r] = _mm256_setzero_si256();
+        for (int q=q0;q<q1;q++)
+        {
+            __m256i b = _mm256_load_si256((const __m256i*)(bp + q*NR*2));
+            for (int r=0;r<MR;r++)
+                s[r] = _mm256_add_epi32(s[r], _mm256_madd_epi16(_mm256_set1_epi32(a[q*MR + r]), b));
+        }
+        for (int r=0;r<MR;r++)
+            avx2::widen_add(tmp[r], s[r]);
+    }
+
+    template <>
+    inline void QGemmAvx2<15>::flush(int64_t (*tmp)[NR], const int16_t* bp, const int32_t* a, int q0, int q1)
+    {
+        __m256i hi[MR], lo[MR];
+        for (int r=0;r<MR;r++)
+            hi[r] = lo[r] = _mm256_setzero_si256();
+        for (int q=q0;q<q1;q++)
+        {
+            __m256i b = _mm256_load_si256((const __m256i*)(bp + q*NR*2));
+            for (int r=0;r<MR;r++)
+                avx2::madd16(hi[r], lo[r], _mm256_set1_epi32(a[q*MR + r]), b);
+        }
+        for (int r=0;r<MR;r++)
+        {
+            // Restore the 2^16 subtracted by madd16() at each step
+            int64_t t[NR] = {0};
+            avx2::widen_add(t, _mm256_add_epi32(hi[r], _mm256_set1_epi32(q1 - q0)));
+            for (int c=0;c<NR;c++)
+                tmp[r][c] += t[c] << 16;
+            avx2::widen_add(tmp[r], lo[r]);
+        }
+    }
+
+    template <>
+    inline int64_t QGemmAvx2<7>::dot16(const int8_t* a, const int8_t* x, int p0, int p1, int& end)
+    {
+        __m256i s = _mm256_setzero_si256();
+        int p = p0;
+        for (;p+16<=p1;p+=16)
+            s = _mm256_add_epi32(s, _mm256_madd_epi16(avx2::load16(a + p), avx2::load16(x + p)));
+        end = p;
+
+        int64_t t[8] = {0};
+        avx2::widen_add(t, s);
+        return t[0] + t[1] + t[2] + t[3] + t[4] + t[5] + t[6] + t[7];
+    }
+
+    template <>
+    inline int64_t QGemmAvx2<15>::dot16(const int32_t* a, const int32_t* x, int p0, int p1, int& end)
+    {
+        __m256i hi = _mm256_setzero_si256(), lo = _mm256_setzero_si256();
+        int p = p0;
+        for (;p+16<=p1;p+=16)
+            avx2::madd16(hi, lo, avx2::load16(a + p), avx2::load16(x + p));
+        end = p;
+
+        int64_t th[8] = {0}, tl[8] = {0};
+        avx2::widen_add(th, hi);
+        avx2::widen_add(tl, lo);
+        int64_t s = int64_t(end - p0) / 16 * 8 * 65536;
+        for (int c=0;c<8;c++)
+            s += th[c] * 65536 + tl[c];
+        return s;
+    }
+
+    template <>
+    struct QGemm<7> : public QGemmAvx2<7>
+    {};
+
+    template <>
+    struct QGemm<15> : public QGemmAvx2<15>
+    {};
+#endif
+
+    /////////////////////////////////////////////////////////////////////////
+    // QGemmRun -- drivers of the quantized kernels. Blocks of rows are split
+    // across threads; the results do not depend on the number of threads.
+    /////////////////////////////////////////////////////////////////////////
+    template <int QF>
+    struct QGemmRun
+    {
+        typedef QGemm<QF> K;
+        typedef typename K::IntType IntType;
+
+        template <class OutType, class ScaleType>
+        static void gemm(int m, int n, int k, const IntType* A, int lda, const IntType* B, int ldb,
+                         OutType* C, int ldc, const Requant<OutType,ScaleType>& rq)
+        {
+            typename K::Packed bp(B, ldb, k, n);
+            int nblocks = (m + K::MR - 1) / K::MR;
+            int nchunks = NumChunks(nblocks, 4, MaxThreads());
+            int ovf = 0;
+
+            FRACT_OMP(omp parallel for schedule(static) reduction(|:ovf))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(nblocks, nchunks, t, begin, end);
+                AlignedBuffer<int64_t> acc(K::MR * n);
+                for (int ib=begin;ib<end;ib++)
+                {
+                    int i0 = ib * K::MR;
+                    int mr = (m - i0 < K::MR) ? m - i0 : K::MR;
+                    K::block(acc.get(), mr, n, k, A + i0*lda, lda, bp);
+                    for (int r=0;r<mr;r++)
+                        for (int j=0;j<n;j++)
+                            C[(i0 + r)*ldc + j] = rq(acc.get()[r*n + j], i0 + r, ovf);
+                }
+            }
+
+            OVERFLOW_IF(ovf);
+        }
+
+        template <class OutType, class ScaleType>
+        static void gemv(int m, int k, const IntType* A, int lda, const IntType* x,
+                         OutType* y, const Requant<OutType,ScaleType>& rq)
+        {
+            int nchunks = NumChunks(m, 64, MaxThreads());
+            int ovf = 0;
+
+            FRACT_OMP(omp parallel for schedule(static) reduction(|:ovf))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(m, nchunks, t, begin, end);
+                for (int i=begin;i<end;i++)
+                    y[i] = rq(K::dot(A + i*lda, x, k), i, ovf);
+            }
+
+            OVERFLOW_IF(ovf);
+        }
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// qgemm -- product of quantized matrices: C = diag(scale) * A * B
+// qgemv -- product of a quantized matrix by a vector: y = diag(scale) * A * x
+//
+// The inputs are in one of the quantized formats Fract<1,7> (int8) or Fract<1,15>
+// (Q15); matrices are stored by rows as for gemm(). The products are summed exactly
+// (eg: int8 x int8 -> int32, Q15 x Q15 -> Q30 with a 64-bit accumulator), then each
+// row is multiplied by its scale factor scale[i] and requantized to the output format,
+// rounding toward minus infinity. Without a scale, the exact sums are just converted to
+// the output format (so Fract<1,31> gives the usual Q15 x Q15 -> Q31 product). The
+// overflow policy applies to the output format, like the FractSpan operations.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F, int QF, int SI, int SF>
+void qgemm(int m, int n, int k,
+           const Fract<1,QF>* A, int lda, const Fract<1,QF>* B, int ldb,
+           Fract<I,F>* C, int ldc, const Fract<SI,SF>* scale,
+           FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+{
+    STATIC_ASSERT(QF == 7 || QF == 15, "Quantized formats are Fract<1,7> and Fract<1,15>");
+    typedef typename detail::FractAccess::Traits<1,QF>::IntType QIntType;
+    typedef typename detail::FractAccess::Traits<I,F>::IntType OutType;
+    typedef typename detail::FractAccess::Traits<SI,SF>::IntType ScaleType;
+
+    detail::Requant<OutType,ScaleType> rq(reinterpret_cast<const ScaleType*>(scale), QF*2, SF, F, I+F, policy);
+    detail::QGemmRun<QF>::gemm(m, n, k,
+                               reinterpret_cast<const QIntType*>(A), lda,
+                               reinterpret_cast<const QIntType*>(B), ldb,
+                               reinterpret_cast<OutType*>(C), ldc, rq);
+}
+
+template <int I, int F, int QF>
+void qgemm(int m, int n, int k,
+           const Fract<1,QF>* A, int lda, const Fract<1,QF>* B, int ldb,
+           Fract<I,F>* C, int ldc, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+{
+    qgemm(m, n, k, A, lda, B, ldb, C, ldc, (const Fract<32,0>*)NULL, policy);
+}
+
+template <int I, int F, int QF, int SI, int SF>
+void qgemv(int m, int k, const Fract<1,QF>* A, int lda, const Fract<1,QF>* x,
+           Fract<I,F>* y, const Fract<SI,SF>* scale,
+           FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+{
+    STATIC_ASSERT(QF == 7 || QF == 15, "Quantized formats are Fract<1,7> and Fract<1,15>");
+    typedef typename detail::FractAccess::Traits<1,QF>::IntType QIntType;
+    typedef typename detail::FractAccess::Traits<I,F>::IntType OutType;
+    typedef typename detail::FractAccess::Traits<SI,SF>::IntType ScaleType;
+
+    detail::Requant<OutType,ScaleType> rq(reinterpret_cast<const ScaleType*>(scale), QF*2, SF, F, I+F, policy);
+    detail::QGemmRun<QF>::gemv(m, k, reinterpret_cast<const QIntType*>(A), lda,
+                               reinterpret_cast<const QIntType*>(x),
+                               reinterpret_cast<OutType*>(y), rq);
+}
+
+template <int I, int F, int QF>
+void qgemv(int m, int k, const Fract<1,QF>* A, int lda, const Fract<1,QF>* x,
+           Fract<I,F>* y, FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+{
+    qgemv(m, k, A, lda, x, y, (const Fract<32,0>*)NULL, policy);
+}
+#endif
+
+#endif /* FIXEDGEMM_H */
@@ -34,68 +34,194 @@
 #define FIXEDGEOM_H
 
 #include "fixedpoint.h"
+#include "fixedpoint/simd.h"
 
-template <int I, int F>
-class Vector3D
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // VecLoop<K> -- loops over the first K components of a vector, fully
+    // unrolled at compile time through template recursion.
+    /////////////////////////////////////////////////////////////////////////
+    template <int K>
+    struct VecLoop
+    {
+        template <class T>
+        static void INLINE add(T* r, const T* a, const T* b)
+        { VecLoop<K-1>::add(r, a, b); r[K-1] = a[K-1] + b[K-1]; }
+
+        template <class T>
+        static void INLINE sub(T* r, const T* a, const T* b)
+        { VecLoop<K-1>::sub(r, a, b); r[K-1] = a[K-1] - b[K-1]; }
+
+        template <class T>
+        static void INLINE mul(T* r, const T* a, const T* b)
+        { VecLoop<K-1>::mul(r, a, b); r[K-1] = a[K-1] * b[K-1]; }
+
+        template <class T>
+        static void INLINE scale(T* r, const T* a, T f)
+        { VecLoop<K-1>::scale(r, a, f); r[K-1] = a[K-1] * f; }
+
+        template <class T>
+        static bool INLINE equal(const T* a, const T* b)
+        { return VecLoop<K-1>::equal(a, b) && a[K-1] == b[K-1]; }
+
+        // Sum of the products of the raw components, computed at double
+        // width (DIntType) without any intermediate rounding. The components
+        // of b can be strided (eg: a matrix column). Each product fits
+        // DIntType, but their sum may not: that raises an overflow error.
+        template <class DIntType, int I, int F>
+        static DIntType INLINE dot(const Fract<I,F>* a, const Fract<I,F>* b, int bstride=1)
+        {
+            WideSum<DIntType> s;
+            accumulate(s, a, b, bstride);
+            return s.value();
+        }
+
+        template <class DIntType, int I, int F>
+        static void INLINE accumulate(WideSum<DIntType>& s, const Fract<I,F>* a, const Fract<I,F>* b, int bstride)
+        {
+            VecLoop<K-1>::accumulate(s, a, b, bstride);
+            s.add(DIntType(FractAccess::raw(a[K-1])) * FractAccess::raw(b[(K-1)*bstride]));
+        }
+    };
+
+    template <>
+    struct VecLoop<0>
+    {
+        template <class T> static void add(T*, const T*, const T*) {}
+        template <class T> static void sub(T*, const T*, const T*) {}
+        template <class T> static void mul(T*, const T*, const T*) {}
+        template <class T> static void scale(T*, const T*, T) {}
+        template <class T> static bool equal(const T*, const T*) { return true; }
+
+        template <class DIntType, int I, int F>
+        static void accumulate(WideSum<DIntType>&, const Fract<I,F>*, const Fract<I,F>*, int) {}
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Vector -- N-dimensional vector of fixed point numbers
+//    Template arguments:
+//        N - number of dimensions
+//        I, F - format of each component (see Fract)
+//
+// The class has no user-defined copy constructor or assignment operator, so it is
+// trivially copyable: arrays of vectors can be moved around with memcpy().
+// Dot products (and thus mod2()) and cross products are accumulated at double width
+// and rounded only once at the end; results which do not fit the format raise an
+// overflow error, even when the sum does not fit the double width either.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int N, int I, int F>
+class Vector
 {
-    enum { DIMS = 3 };
+    STATIC_ASSERT(N > 0, "At least one dimension is needed");
+
+public:
+    enum { DIMS = N };
     typedef Fract<I,F> VFract;
 
+    template <int R2, int C2, int I2, int F2>
+    friend class Matrix;
+
+protected:
+    typedef typename detail::FractAccess::Traits<I,F>::DIntType DIntType;
+
     VFract c[DIMS];
 
+    // Build a Fract from a double-width accumulator with 2*F fractional bits
+    static VFract fromWide(DIntType acc)
+    {
+        return VFract(acc, F*2);
+    }
+
 public:
-    Vector3D() {}
+    Vector() {}
 
+    // Components not specified are set to zero
     template <class T0, class T1>
-    Vector3D(T0 a0, T1 a1)
+    Vector(T0 a0, T1 a1)
     {
+        STATIC_ASSERT(N >= 2, "Too many components for this vector");
         c[0] = a0;
         c[1] = a1;
+        for (int i=2;i<DIMS;i++)
+            c[i] = 0;
     }
     template <class T0, class T1, class T2>
-    Vector3D(T0 a0, T1 a1, T2 a2)
+    Vector(T0 a0, T1 a1, T2 a2)
     {
+        STATIC_ASSERT(N >= 3, "Too many components for this vector");
         c[0] = a0;
         c[1] = a1;
         c[2] = a2;
+        for (int i=3;i<DIMS;i++)
+            c[i] = 0;
     }
-
-    Vector3D(const Vector3D& v)
+    template <class T0, class T1, class T2, class T3>
+    Vector(T0 a0, T1 a1, T2 a2, T3 a3)
     {
-        *this = v;
+        STATIC_ASSERT(N >= 4, "Too many components for this vector");
+        c[0] = a0;
+        c[1] = a1;
+        c[2] = a2;
+        c[3] = a3;
+        for (int i=4;i<DIMS;i++)
+            c[i] = 0;
     }
 
 public:
-    Vector3D& operator=(const Vector3D& v)
+    VFract operator[](int i) const { return c[i]; }
+    VFract& operator[](int i) { return c[i]; }
+
+    Vector operator+(const Vector& v) const
     {
-        for (int i=0;i<DIMS;i++)
-            c[i] = v.c[i];
+        Vector r;
+        detail::VecLoop<N>::add(r.c, c, v.c);
+        return r;
+    }
+    Vector operator-(const Vector& v) const
+    {
+        Vector r;
+        detail::VecLoop<N>::sub(r.c, c, v.c);
+        return r;
+    }
+    Vector operator-() const
+    {
+        return Vector() - *this;
+    }
+    Vector& operator+=(const Vector& v)
+    {
+        detail::VecLoop<N>::add(c, c, v.c);
+        return *this;
+    }
+    Vector& operator-=(const Vector& v)
+    {
+        detail::VecLoop<N>::sub(c, c, v.c);
         return *this;
     }
 
     template <int I2, int F2>
-    Vector3D operator*(Fract<I2,F2> f)
+    Vector operator*(Fract<I2,F2> f) const
     {
-        Vector3D m;
-        for (int i=0;i<DIMS;i++)
-            m.c[i] = c[i]*f;
+        Vector m;
+        detail::VecLoop<N>::scale(m.c, c, VFract(f));
         return m;
     }
     template <int I2, int F2>
-    Vector3D& operator*=(Fract<I2,F2> f)
+    Vector& operator*=(Fract<I2,F2> f)
     {
-        for (int i=0;i<DIMS;i++)
-            c[i] *= f;
+        detail::VecLoop<N>::scale(c, c, VFract(f));
         return *this;
     }
 
+    bool operator==(const Vector& v) const { return detail::VecLoop<N>::equal(c, v.c); }
+    bool operator!=(const Vector& v) const { return !(*this == v); }
+
     // Return the square of the vector modulus
     VFract mod2() const
     {
-        VFract m = 0;
-        for (int i=0;i<DIMS;i++)
-            m += c[i]*c[i];
-        return m;
+        return dot(*this, *this);
     }
 
     // Return the vector modulus (length)
@@ -104,18 +230,744 @@ public:
         return sqrt(mod2());
     }
 
-    // Return the normalized vector (direction)
-    VFract dir() const
+    // Return the normalized vector (direction). The inverse modulus is kept at
+    // full precision (see detail::RSqrt) and applied with a wide multiplication.
+    // Vectors too short for mod2() to be representable give a null vector.
+    Vector dir() const
     {
-        return *this * rsqrt(mod2());
+        typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+        typedef detail::RSqrt<typename AnyInt::Bigger<IntType, int32_t>::type> RSqrt;
+
+        int frac;
+        typename RSqrt::UIntType inv = RSqrt::eval0(detail::FractAccess::raw(mod2()), F, frac);
+
+        Vector r;
+        for (int i=0;i<DIMS;i++)
+            r.c[i] = detail::FractAccess::gen<I,F>(
+                detail::BatchScalar<IntType>::scale_wide(detail::FractAccess::raw(c[i]), inv, frac, F, I));
+        return r;
     }
 
 public:
     // Alias for vector's length
-    friend VFract abs(const Vector3D& v)
+    friend VFract abs(const Vector& v)
     {
         return v.mod();
     }
+
+    // Dot product
+    friend VFract dot(const Vector& a, const Vector& b)
+    {
+        return fromWide(detail::VecLoop<N>::template dot<DIntType>(a.c, b.c));
+    }
+
+    // Cross product (only defined for 3D vectors)
+    friend Vector cross(const Vector& a, const Vector& b)
+    {
+        STATIC_ASSERT(N == 3, "Cross product is only defined for 3D vectors");
+        using detail::FractAccess;
+
+        Vector r;
+        for (int i=0;i<3;i++)
+        {
+            int j = (i+1)%3, k = (i+2)%3;
+            r.c[i] = fromWide(DIntType(FractAccess::raw(a.c[j])) * FractAccess::raw(b.c[k]) -
+                              DIntType(FractAccess::raw(a.c[k])) * FractAccess::raw(b.c[j]));
+        }
+        return r;
+    }
+
+    // Component-wise product
+    friend Vector mul(const Vector& a, const Vector& b)
+    {
+        Vector r;
+        detail::VecLoop<N>::mul(r.c, a.c, b.c);
+        return r;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Vector2D, Vector3D, Vector4D -- shortcuts for the most common dimensions
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class Vector2D : public Vector<2,I,F>
+{
+public:
+    Vector2D() {}
+    Vector2D(const Vector<2,I,F>& v) : Vector<2,I,F>(v) {}
+
+    template <class T0, class T1>
+    Vector2D(T0 a0, T1 a1) : Vector<2,I,F>(a0, a1) {}
+};
+
+template <int I, int F>
+class Vector3D : public Vector<3,I,F>
+{
+public:
+    Vector3D() {}
+    Vector3D(const Vector<3,I,F>& v) : Vector<3,I,F>(v) {}
+
+    template <class T0, class T1>
+    Vector3D(T0 a0, T1 a1) : Vector<3,I,F>(a0, a1) {}
+    template <class T0, class T1, class T2>
+    Vector3D(T0 a0, T1 a1, T2 a2) : Vector<3,I,F>(a0, a1, a2) {}
+};
+
+template <int I, int F>
+class Vector4D : public Vector<4,I,F>
+{
+public:
+    Vector4D() {}
+    Vector4D(const Vector<4,I,F>& v) : Vector<4,I,F>(v) {}
+
+    template <class T0, class T1, class T2>
+    Vector4D(T0 a0, T1 a1, T2 a2) : Vector<4,I,F>(a0, a1, a2) {}
+    template <class T0, class T1, class T2, class T3>
+    Vector4D(T0 a0, T1 a1, T2 a2, T3 a3) : Vector<4,I,F>(a0, a1, a2, a3) {}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Matrix -- RxC matrix of fixed point numbers
+//    Template arguments:
+//        R, C - number of rows and columns
+//        I, F - format of each element (see Fract)
+//
+// Products (matrix-matrix and matrix-vector) compute each element as a dot product
+// accumulated at double width, which is rounded only once. Like Vector, the class is
+// trivially copyable.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+
+    // Copy m into sub, skipping row r and column c
+    template <int N, class T>
+    void Minor(const T (&m)[N][N], T (&sub)[N-1][N-1], int r, int c)
+    {
+        for (int i=0,si=0;i<N;i++)
+        {
+            if (i == r)
+                continue;
+            for (int j=0,sj=0;j<N;j++)
+                if (j != c)
+                    sub[si][sj++] = m[i][j];
+            si++;
+        }
+    }
+
+    // num / den, through reciprocal() (whose lazy product only handles a positive num)
+    template <int I, int F>
+    Fract<I,F> Divide(Fract<I,F> num, Fract<I,F> den)
+    {
+        bool neg = false;
+        if (num < 0) { num = Fract<I,F>() - num; neg = !neg; }
+        if (den < 0) { den = Fract<I,F>() - den; neg = !neg; }
+
+        Fract<I,F> q = reciprocal(den) * num;
+        return neg ? Fract<I,F>() - q : q;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // Det<N> -- determinant of a NxN array, by cofactor expansion along the
+    // first row. Each level of the expansion is accumulated at double width,
+    // and raises an overflow error if the sum does not fit.
+    /////////////////////////////////////////////////////////////////////////
+    template <int N>
+    struct Det
+    {
+        template <int I, int F>
+        static Fract<I,F> eval(const Fract<I,F> (&m)[N][N])
+        {
+            typedef typename FractAccess::Traits<I,F>::DIntType DIntType;
+
+            WideSum<DIntType> acc;
+            for (int j=0;j<N;j++)
+            {
+                Fract<I,F> sub[N-1][N-1];
+                Minor(m, sub, 0, j);
+                DIntType p = DIntType(FractAccess::raw(m[0][j])) * FractAccess::raw(Det<N-1>::eval(sub));
+                acc.add((j & 1) ? -p : p);
+            }
+            return Fract<I,F>(acc.value(), F*2);
+        }
+    };
+
+    template <>
+    struct Det<2>
+    {
+        template <int I, int F>
+        static Fract<I,F> eval(const Fract<I,F> (&m)[2][2])
+        {
+            typedef typename FractAccess::Traits<I,F>::DIntType DIntType;
+            return Fract<I,F>(DIntType(FractAccess::raw(m[0][0])) * FractAccess::raw(m[1][1]) -
+                              DIntType(FractAccess::raw(m[0][1])) * FractAccess::raw(m[1][0]), F*2);
+        }
+    };
+
+    template <>
+    struct Det<1>
+    {
+        template <int I, int F>
+        static Fract<I,F> eval(const Fract<I,F> (&m)[1][1])
+        {
+            return m[0][0];
+        }
+    };
+}
+
+template <int R, int C, int I, int F>
+class Matrix
+{
+    STATIC_ASSERT(R > 0 && C > 0, "At least one row and one column are needed");
+
+public:
+    enum { ROWS = R, COLS = C };
+    typedef Fract<I,F> MFract;
+
+    template <int R2, int C2, int I2, int F2>
+    friend class Matrix;
+
+protected:
+    typedef typename detail::FractAccess::Traits<I,F>::DIntType DIntType;
+
+    MFract m[R][C];
+
+public:
+    // Null matrix
+    Matrix() {}
+
+    static Matrix identity(void)
+    {
+        Matrix r;
+        for (int i=0;i<R && i<C;i++)
+            r.m[i][i] = 1;
+        return r;
+    }
+
+public:
+    MFract operator()(int r, int c) const { return m[r][c]; }
+    MFract& operator()(int r, int c) { return m[r][c]; }
+
+    Vector<C,I,F> row(int r) const
+    {
+        Vector<C,I,F> v;
+        for (int j=0;j<C;j++)
+            v.c[j] = m[r][j];
+        return v;
+    }
+
+    Vector<R,I,F> col(int c) const
+    {
+        Vector<R,I,F> v;
+        for (int i=0;i<R;i++)
+            v.c[i] = m[i][c];
+        return v;
+    }
+
+    void setRow(int r, const Vector<C,I,F>& v)
+    {
+        for (int j=0;j<C;j++)
+            m[r][j] = v.c[j];
+    }
+
+    Matrix operator+(const Matrix& b) const
+    {
+        Matrix r;
+        for (int i=0;i<R;i++)
+            detail::VecLoop<C>::add(r.m[i], m[i], b.m[i]);
+        return r;
+    }
+    Matrix operator-(const Matrix& b) const
+    {
+        Matrix r;
+        for (int i=0;i<R;i++)
+            detail::VecLoop<C>::sub(r.m[i], m[i], b.m[i]);
+        return r;
+    }
+
+    template <int C2>
+    Matrix<R,C2,I,F> operator*(const Matrix<C,C2,I,F>& b) const
+    {
+        Matrix<R,C2,I,F> r;
+        for (int i=0;i<R;i++)
+            for (int j=0;j<C2;j++)
+                r.m[i][j] = MFract(detail::VecLoop<C>::template dot<DIntType>(m[i], &b.m[0][j], C2), F*2);
+        return r;
+    }
+
+    Vector<R,I,F> operator*(const Vector<C,I,F>& v) const
+    {
+        Vector<R,I,F> r;
+        for (int i=0;i<R;i++)
+            r.c[i] = MFract(detail::VecLoop<C>::template dot<DIntType>(m[i], v.c), F*2);
+        return r;
+    }
+
+    bool operator==(const Matrix& b) const
+    {
+        for (int i=0;i<R;i++)
+            if (!detail::VecLoop<C>::equal(m[i], b.m[i]))
+                return false;
+        return true;
+    }
+    bool operator!=(const Matrix& b) const { return !(*this == b); }
+
+    Matrix<C,R,I,F> transpose() const
+    {
+        Matrix<C,R,I,F> t;
+        for (int i=0;i<R;i++)
+            for (int j=0;j<C;j++)
+                t.m[j][i] = m[i][j];
+        return t;
+    }
+
+public:
+    friend MFract det(const Matrix& a)
+    {
+        STATIC_ASSERT(R == C, "Determinant is only defined for square matrices");
+        return detail::Det<R>::eval(a.m);
+    }
+
+    // Inverse matrix, computed as the adjugate divided by the determinant.
+    // The division is performed through reciprocal(), which is evaluated to
+    // the full precision needed by each element.
+    friend Matrix inverse(const Matrix& a)
+    {
+        STATIC_ASSERT(R == C && R > 1, "Inverse is only defined for square matrices");
+
+        MFract d = det(a);
+        DOMAIN_IF(d == 0);
+
+        Matrix r;
+        for (int i=0;i<R;i++)
+            for (int j=0;j<C;j++)
+            {
+                MFract sub[R-1][R-1];
+                detail::Minor(a.m, sub, i, j);
+                MFract cof = detail::Det<R-1>::eval(sub);
+                if ((i+j) & 1)
+                    cof = MFract() - cof;
+                r.m[j][i] = detail::Divide(cof, d);
+            }
+        return r;
+    }
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// Matrix3x3, Matrix4x4 -- shortcuts for the most common sizes
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class Matrix3x3 : public Matrix<3,3,I,F>
+{
+public:
+    Matrix3x3() {}
+    Matrix3x3(const Matrix<3,3,I,F>& m) : Matrix<3,3,I,F>(m) {}
+
+    // Build from rows
+    Matrix3x3(const Vector<3,I,F>& r0, const Vector<3,I,F>& r1, const Vector<3,I,F>& r2)
+    {
+        this->setRow(0, r0);
+        this->setRow(1, r1);
+        this->setRow(2, r2);
+    }
+};
+
+template <int I, int F>
+class Matrix4x4 : public Matrix<4,4,I,F>
+{
+public:
+    Matrix4x4() {}
+    Matrix4x4(const Matrix<4,4,I,F>& m) : Matrix<4,4,I,F>(m) {}
+
+    // Build from rows
+    Matrix4x4(const Vector<4,I,F>& r0, const Vector<4,I,F>& r1,
+              const Vector<4,I,F>& r2, const Vector<4,I,F>& r3)
+    {
+        this->setRow(0, r0);
+        this->setRow(1, r1);
+        this->setRow(2, r2);
+        this->setRow(3, r3);
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Quaternion -- quaternion of fixed point numbers, stored as (w, x, y, z)
+//
+// Products and the rotation matrix are accumulated at double width and rounded only
+// once per component, and every operation uses integer arithmetic only, so results
+// are exactly reproducible on every machine.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class Quaternion : public Vector<4,I,F>
+{
+public:
+    typedef Fract<I,F> QFract;
+    typedef Vector3D<I,F> QVector;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::DIntType DIntType;
+
+    DIntType wide(int i, int j) const
+    {
+        return DIntType(detail::FractAccess::raw(this->c[i])) * detail::FractAccess::raw(this->c[j]);
+    }
+
+    // Exact sum of double-width products, which raises an overflow error if
+    // it does not fit DIntType
+    static DIntType sum(DIntType a, DIntType b, DIntType c = 0, DIntType d = 0, DIntType e = 0)
+    {
+        detail::WideSum<DIntType> s;
+        s.add(a);
+        s.add(b);
+        s.add(c);
+        s.add(d);
+        s.add(e);
+        return s.value();
+    }
+
+    // Coefficients of the polynomial approximation used by slerp(), rounded
+    // once from Q2.62 constants to the format
+    struct SlerpCoeffs
+    {
+        QFract u[8], v[8];
+
+        static QFract round(int64_t c)
+        {
+            typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+            int s = 62 - F;
+            return detail::FractAccess::gen<I,F>(IntType(s ? (c + (int64_t(1) << (s - 1))) >> s : c));
+        }
+
+        SlerpCoeffs()
+        {
+            // u[i] = 1/(i*(2i+1)), v[i] = i/(2i+1), for i = 1..8; the last
+            // ones are scaled by mu = 1.85298109240830
+            static const int64_t cu[8] = {
+                0x1555555555555555LL, 0x0666666666666666LL, 0x030c30c30c30c30cLL, 0x01c71c71c71c71c7LL,
+                0x0129e4129e4129e4LL, 0x00d20d20d20d20d2LL, 0x009c09c09c09c09cLL, 0x00df3acf12d2d2e6LL,
+            };
+            static const int64_t cv[8] = {
+                0x1555555555555555LL, 0x199999999999999aLL, 0x1b6db6db6db6db6eLL, 0x1c71c71c71c71c72LL,
+                0x1d1745d1745d1746LL, 0x1d89d89d89d89d8aLL, 0x1ddddddddddddddeLL, 0x37ceb3c4b4b4b967LL,
+            };
+            for (int i=0;i<8;i++)
+            {
+                u[i] = round(cu[i]);
+                v[i] = round(cv[i]);
+            }
+        }
+    };
+
+public:
+    // Identity rotation
+    Quaternion() : Vector<4,I,F>(1, 0, 0, 0) {}
+    Quaternion(const Vector<4,I,F>& v) : Vector<4,I,F>(v) {}
+
+    template <class T0, class T1, class T2, class T3>
+    Quaternion(T0 w, T1 x, T2 y, T3 z) : Vector<4,I,F>(w, x, y, z) {}
+
+    template <class T0>
+    Quaternion(T0 w, const QVector& v) : Vector<4,I,F>(w, v[0], v[1], v[2]) {}
+
+public:
+    using Vector<4,I,F>::operator*;
+
+    QFract w() const { return this->c[0]; }
+    QVector vec() const { return QVector(this->c[1], this->c[2], this->c[3]); }
+
+    // Hamilton product
+    Quaternion operator*(const Quaternion& b) const
+    {
+        using detail::FractAccess;
+        DIntType a0 = FractAccess::raw(this->c[0]), a1 = FractAccess::raw(this->c[1]),
+                 a2 = FractAccess::raw(this->c[2]), a3 = FractAccess::raw(this->c[3]);
+        DIntType b0 = FractAccess::raw(b.c[0]), b1 = FractAccess::raw(b.c[1]),
+                 b2 = FractAccess::raw(b.c[2]), b3 = FractAccess::raw(b.c[3]);
+
+        Quaternion r;
+        r.c[0] = this->fromWide(sum(a0*b0, -a1*b1, -a2*b2, -a3*b3));
+        r.c[1] = this->fromWide(sum(a0*b1, a1*b0, a2*b3, -a3*b2));
+        r.c[2] = this->fromWide(sum(a0*b2, -a1*b3, a2*b0, a3*b1));
+        r.c[3] = this->fromWide(sum(a0*b3, a1*b2, -a2*b1, a3*b0));
+        return r;
+    }
+
+    // Rotation matrix equivalent to this (unit) quaternion
+    Matrix3x3<I,F> toMatrix() const
+    {
+        DIntType one = DIntType(1) << (F*2);
+        DIntType w01 = wide(0,1), w02 = wide(0,2), w03 = wide(0,3), w11 = wide(1,1), w12 = wide(1,2);
+        DIntType w13 = wide(1,3), w22 = wide(2,2), w23 = wide(2,3), w33 = wide(3,3);
+        Matrix3x3<I,F> m;
+
+        m(0,0) = this->fromWide(sum(one, -w22, -w22, -w33, -w33));
+        m(0,1) = this->fromWide(sum(w12, w12, -w03, -w03));
+        m(0,2) = this->fromWide(sum(w13, w13, w02, w02));
+        m(1,0) = this->fromWide(sum(w12, w12, w03, w03));
+        m(1,1) = this->fromWide(sum(one, -w11, -w11, -w33, -w33));
+        m(1,2) = this->fromWide(sum(w23, w23, -w01, -w01));
+        m(2,0) = this->fromWide(sum(w13, w13, -w02, -w02));
+        m(2,1) = this->fromWide(sum(w23, w23, w01, w01));
+        m(2,2) = this->fromWide(sum(one, -w11, -w11, -w22, -w22));
+        return m;
+    }
+
+    // Rotate a vector by this (unit) quaternion. This is computed through the
+    // rotation matrix, so that rotating many vectors at once gives the very
+    // same results.
+    QVector rotate(const QVector& v) const
+    {
+        return toMatrix() * v;
+    }
+
+    // Rotate an array of vectors in place
+    void rotate(QVector* v, int n) const
+    {
+        Matrix3x3<I,F> m = toMatrix();
+        for (int i=0;i<n;i++)
+            v[i] = m * v[i];
+    }
+
+public:
+    friend Quaternion conj(const Quaternion& q)
+    {
+        return Quaternion(q.c[0], QFract() - q.c[1], QFract() - q.c[2], QFract() - q.c[3]);
+    }
+
+    friend Quaternion normalize(const Quaternion& q)
+    {
+        return q * rsqrt(q.mod2());
+    }
+
+    // Normalized linear interpolation, along the shortest path
+    friend Quaternion nlerp(const Quaternion& a, const Quaternion& b, QFract t)
+    {
+        Quaternion b2 = (dot(a, b) < 0) ? Quaternion(-b) : b;
+        return normalize(Quaternion(a + (b2 - a) * t));
+    }
+
+    // Spherical linear interpolation, along the shortest path.
+    // Since there are no fixed point trigonometric functions, this uses the
+    // polynomial approximation of the slerp coefficients described in
+    // "A Fast and Accurate Algorithm for Computing SLERP" (D. Eberly, 2011),
+    // which needs only multiplications and additions. The coefficients are
+    // integer constants, so the whole computation is bit-reproducible.
+    friend Quaternion slerp(const Quaternion& a, const Quaternion& b, QFract t)
+    {
+        static const SlerpCoeffs k;
+        const QFract* u = k.u;
+        const QFract* v = k.v;
+
+        QFract x = dot(a, b);
+        bool neg = x < 0;
+        if (neg)
+            x = QFract() - x;
+
+        QFract one(1), xm1 = x - one;
+        QFract d = one - t, t2 = t*t, d2 = d*d;
+        QFract ct = one, cd = one;
+        for (int i=7;i>=0;i--)
+        {
+            ct = one + ((u[i]*t2 - v[i]) * xm1) * ct;
+            cd = one + ((u[i]*d2 - v[i]) * xm1) * cd;
+        }
+        ct = ct * t;
+        cd = cd * d;
+        if (neg)
+            ct = QFract() - ct;
+
+        using detail::FractAccess;
+        Quaternion r;
+        for (int i=0;i<4;i++)
+            r.c[i] = r.fromWide(sum(DIntType(FractAccess::raw(a.c[i])) * FractAccess::raw(cd),
+                                    DIntType(FractAccess::raw(b.c[i])) * FractAccess::raw(ct)));
+        return r;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Vector3DArray -- array of 3D vectors stored as structure of arrays
+//
+// Each axis is kept in its own aligned column, so that batch operations can be
+// vectorized. All the batch operations give results which are bit-identical to the
+// corresponding Vector3D operations, applied one vector at a time.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class Vector3DArray
+{
+public:
+    typedef Fract<I,F> VFract;
+    typedef Vector3D<I,F> VVector;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::Batch<IntType> Batch;
+    STATIC_ASSERT(sizeof(VFract) == sizeof(IntType), "Fract must be a plain wrapper of its integer");
+
+    int n;
+    VFract* c[3];
+
+    void alloc(int size)
+    {
+        n = size;
+        for (int i=0;i<3;i++)
+        {
+            c[i] = static_cast<VFract*>(detail::AlignedAlloc(n * sizeof(VFract)));
+            memset(raw(i), 0, n * sizeof(IntType));
+        }
+    }
+
+    void release(void)
+    {
+        for (int i=0;i<3;i++)
+            detail::AlignedFree(c[i]);
+    }
+
+    IntType* raw(int axis) { return reinterpret_cast<IntType*>(c[axis]); }
+    const IntType* raw(int axis) const { return reinterpret_cast<const IntType*>(c[axis]); }
+
+public:
+    explicit Vector3DArray(int size = 0)
+    {
+        alloc(size);
+    }
+
+    Vector3DArray(const VVector* v, int size)
+    {
+        alloc(size);
+        for (int i=0;i<n;i++)
+            set(i, v[i]);
+    }
+
+    Vector3DArray(const Vector3DArray& a)
+    {
+        alloc(a.n);
+        for (int i=0;i<3;i++)
+            memcpy(c[i], a.c[i], n * sizeof(VFract));
+    }
+
+    ~Vector3DArray()
+    {
+        release();
+    }
+
+    Vector3DArray& operator=(const Vector3DArray& a)
+    {
+        if (this != &a)
+        {
+            release();
+            alloc(a.n);
+            for (int i=0;i<3;i++)
+                memcpy(c[i], a.c[i], n * sizeof(VFract));
+        }
+        return *this;
+    }
+
+public:
+    int size() const { return n; }
+
+    VVector operator[](int i) const
+    {
+        return VVector(c[0][i], c[1][i], c[2][i]);
+    }
+
+    void set(int i, const VVector& v)
+    {
+        for (int k=0;k<3;k++)
+            c[k][i] = v[k];
+    }
+
+    // Direct access to the column of a single axis (0=x, 1=y, 2=z)
+    VFract* column(int axis) { return c[axis]; }
+    const VFract* column(int axis) const { return c[axis]; }
+
+public:
+    // v[i] = v[i] * f
+    void scale(VFract f)
+    {
+        for (int k=0;k<3;k++)
+            Batch::scale(raw(k), raw(k), detail::FractAccess::raw(f), F, n);
+    }
+
+    // v[i] = v[i] + a[i]
+    void add(const Vector3DArray& a)
+    {
+        assert(a.n == n);
+        for (int k=0;k<3;k++)
+            Batch::add(raw(k), raw(k), a.raw(k), n);
+    }
+
+    // out[i] = dot(v[i], a[i])
+    void dot(const Vector3DArray& a, VFract* out) const
+    {
+        assert(a.n == n);
+        Batch::dot3(reinterpret_cast<IntType*>(out), raw(0), raw(1), raw(2),
+                    a.raw(0), a.raw(1), a.raw(2), F, I, n);
+    }
+
+    // out[i] = v[i].mod2()
+    void mod2(VFract* out) const
+    {
+        dot(*this, out);
+    }
+
+    // v[i] = v[i].dir()
+    void normalize(void)
+    {
+        Batch::normalize3(raw(0), raw(1), raw(2), 1, F, I, n);
+    }
+
+    // Affine transform: v[i] = VVector(dot(row0, v[i]) + t[0], dot(row1, v[i]) + t[1],
+    // dot(row2, v[i]) + t[2])
+    void transform(const VVector& row0, const VVector& row1, const VVector& row2, const VVector& t)
+    {
+        using detail::FractAccess;
+        const VVector* rows[3] = { &row0, &row1, &row2 };
+
+        detail::AlignedBuffer<VFract> t0(n), t1(n), t2(n);
+        VFract* tmp[3] = { t0.get(), t1.get(), t2.get() };
+        for (int k=0;k<3;k++)
+        {
+            const VVector& m = *rows[k];
+            Batch::affine3(reinterpret_cast<IntType*>(tmp[k]), raw(0), raw(1), raw(2),
+                           FractAccess::raw(m[0]), FractAccess::raw(m[1]), FractAccess::raw(m[2]),
+                           FractAccess::raw(t[k]), F, I, n);
+        }
+
+        // Replace the columns only once all of them have been computed
+        release();
+        c[0] = t0.release();
+        c[1] = t1.release();
+        c[2] = t2.release();
+    }
+
+    // Affine transform: v[i] = m * v[i] + t
+    void transform(const Matrix<3,3,I,F>& m, const VVector& t)
+    {
+        transform(m.row(0), m.row(1), m.row(2), t);
+    }
+
+    // v[i] = q.rotate(v[i])
+    void rotate(const Quaternion<I,F>& q)
+    {
+        transform(q.toMatrix(), VVector());
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// normalize -- normalize an array of vectors in place (v[i] = v[i].dir()).
+// The squared moduli, inverse square roots and scaling are computed in batch, without
+// branches (short vectors are handled like in dir()).
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+void normalize(Vector3D<I,F>* v, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    STATIC_ASSERT(sizeof(Vector3D<I,F>) == 3*sizeof(IntType), "Vector3D must be a plain array of components");
+
+    IntType* p = reinterpret_cast<IntType*>(v);
+    detail::Batch<IntType>::normalize3(p, p+1, p+2, 3, F, I, n);
+}
+
 #endif // FIXEDGEOM_H
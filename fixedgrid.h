@@ -0,0 +1,394 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains a uniform grid spatial index on fixed-point coordinates.
+ */
+
+#ifndef FIXEDGRID_H
+#define FIXEDGRID_H
+
+#include "fixedgeom.h"
+#include "fixedpoint/parallel.h"
+#include <vector>
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// UniformGrid -- spatial index of 3D points, for radius and nearest-neighbor queries
+//    Template arguments:
+//        I, F - format of the coordinates (see Fract)
+//
+// The grid covers nx*ny*nz cubic cells of side 2^cell_log2, starting at origin. Since
+// the cell side is a power of two, the cell of a point is found with a shift of its
+// raw coordinates. Points outside the grid are clamped into the border cells, so they
+// are still found by queries (just less efficiently).
+//
+// build() sorts the points by cell with a counting sort: the points of a cell (and of
+// consecutive cells along x) are contiguous in memory, with their coordinates stored
+// as structure of arrays. update() moves a single point; points which change cell are
+// kept in a small per-cell list until the next rebuild().
+//
+// Queries are const and can be run concurrently from multiple threads. The results
+// are deterministic: they depend only on the point set, not on the build history or
+// on the number of threads used by build().
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class UniformGrid
+{
+public:
+    typedef Fract<I,F> VFract;
+    typedef Vector3D<I,F> VVector;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename detail::FractAccess::Traits<I,F>::DIntType DIntType;
+    typedef typename AnyInt::Unsigned<DIntType>::type DUIntType;
+
+    IntType org[3];
+    int shift;
+    int dim[3];
+    int ncells;
+
+    std::vector<VVector> pos;       // positions, by point index
+    std::vector<int> cellOf;        // cell of each point
+    std::vector<int> slotOf;        // slot of each point, or -1 if moved
+    std::vector<int> cellStart;     // first slot of each cell (ncells+1 entries)
+    std::vector<int> sorted;        // point index of each slot, or -1 if moved
+    std::vector<IntType> sc[3];     // coordinates of each slot
+    std::vector<int> movedHead;     // first moved point of each cell, or -1
+    std::vector<int> movedNext;     // next moved point in the same cell, or -1
+    int nmoved;
+
+    int cellCoord(DIntType x, int k) const
+    {
+        DIntType c = (x - org[k]) >> shift;
+        return (c < 0) ? 0 : (c >= dim[k]) ? dim[k]-1 : int(c);
+    }
+
+    int cellIndex(const VVector& p) const
+    {
+        return (cellCoord(detail::FractAccess::raw(p[2]), 2) * dim[1] +
+                cellCoord(detail::FractAccess::raw(p[1]), 1)) * dim[0] +
+                cellCoord(detail::FractAccess::raw(p[0]), 0);
+    }
+
+    // Squared distance at double width, saturated: a coordinate difference needs one
+    // bit more than the format, so the sum of the three squares can exceed DUIntType.
+    static DUIntType dist2(const IntType* q, IntType x, IntType y, IntType z)
+    {
+        DIntType d[3] = { DIntType(x) - q[0], DIntType(y) - q[1], DIntType(z) - q[2] };
+        DUIntType r = 0;
+        for (int k=0;k<3;k++)
+        {
+            DUIntType a = DUIntType(d[k] < 0 ? -d[k] : d[k]);
+            DUIntType s = a * a;
+            r = (s > ~r) ? ~DUIntType(0) : r + s;
+        }
+        return r;
+    }
+
+    // Call f(index, dist2) for every point in the cells [x0,x1] of row (y,z)
+    template <class Func>
+    void visitRow(int x0, int x1, int y, int z, const IntType* q, Func& f) const
+    {
+        int base = (z * dim[1] + y) * dim[0];
+        for (int s=cellStart[base+x0];s<cellStart[base+x1+1];s++)
+            if (sorted[s] >= 0)
+                f(sorted[s], dist2(q, sc[0][s], sc[1][s], sc[2][s]));
+
+        for (int c=base+x0;c<=base+x1;c++)
+            for (int i=movedHead[c];i>=0;i=movedNext[i])
+                f(i, dist2(q, detail::FractAccess::raw(pos[i][0]),
+                           detail::FractAccess::raw(pos[i][1]),
+                           detail::FractAccess::raw(pos[i][2])));
+    }
+
+    void unlinkMoved(int i)
+    {
+        int* p = &movedHead[cellOf[i]];
+        while (*p != i)
+            p = &movedNext[*p];
+        *p = movedNext[i];
+    }
+
+    // Keep the maxout smallest indices seen so far. Once out is full, it is a max-heap,
+    // so the largest stored index is replaced by a smaller one.
+    struct RadiusCollector
+    {
+        DUIntType r2;
+        int* out;
+        int maxout, count;
+
+        void operator()(int i, DUIntType d2)
+        {
+            if (d2 > r2)
+                return;
+            if (count < maxout)
+            {
+                out[count] = i;
+                if (count + 1 == maxout)
+                    std::make_heap(out, out + maxout);
+            }
+            else if (maxout > 0 && i < out[0])
+            {
+                std::pop_heap(out, out + maxout);
+                out[maxout-1] = i;
+                std::push_heap(out, out + maxout);
+            }
+            ++count;
+        }
+    };
+
+    // Keep the k nearest points seen so far, sorted by distance (then index)
+    struct NearestCollector
+    {
+        std::vector<DUIntType> d2;
+        int* out;
+        int k, count;
+
+        void operator()(int i, DUIntType d)
+        {
+            int j = count;
+            while (j > 0 && (d < d2[j-1] || (d == d2[j-1] && i < out[j-1])))
+            {
+                if (j < k)
+                {
+                    d2[j] = d2[j-1];
+                    out[j] = out[j-1];
+                }
+                --j;
+            }
+            if (j < k)
+            {
+                d2[j] = d;
+                out[j] = i;
+                if (count < k)
+                    ++count;
+            }
+        }
+    };
+
+public:
+    // Grid of nx*ny*nz cells of side 2^cell_log2 (which can be negative), with the
+    // first cell starting at origin.
+    UniformGrid(const VVector& origin, int cell_log2, int nx, int ny, int nz)
+        : shift(F + cell_log2), ncells(nx*ny*nz), nmoved(0)
+    {
+        assert(shift >= 0 && shift < I+F);
+        assert(nx > 0 && ny > 0 && nz > 0);
+        for (int k=0;k<3;k++)
+            org[k] = detail::FractAccess::raw(origin[k]);
+        dim[0] = nx;
+        dim[1] = ny;
+        dim[2] = nz;
+        cellStart.assign(ncells+1, 0);
+        movedHead.assign(ncells, -1);
+    }
+
+    int size() const { return int(pos.size()); }
+    const VVector& operator[](int i) const { return pos[i]; }
+
+    // Number of points which changed cell since the last build
+    int moved() const { return nmoved; }
+
+    // Index the points p[0..n-1], replacing the current content. With OpenMP, the
+    // counting sort is split among threads: each chunk of points is counted and
+    // scattered independently, in the same order as a sequential stable sort.
+    void build(const VVector* p, int n)
+    {
+        pos.assign(p, p+n);
+        cellOf.resize(n);
+        slotOf.resize(n);
+        sorted.resize(n);
+        for (int k=0;k<3;k++)
+            sc[k].resize(n);
+        movedHead.assign(ncells, -1);
+        movedNext.assign(n, -1);
+        nmoved = 0;
+
+        int nchunks = detail::NumChunks(n, 4096, detail::MaxThreads());
+        std::vector<int> offs(size_t(nchunks) * ncells, 0);
+
+        FRACT_OMP(omp parallel for schedule(static))
+        for (int t=0;t<nchunks;t++)
+        {
+            int begin, end;
+            detail::ChunkRange(n, nchunks, t, begin, end);
+            int* cnt = &offs[size_t(t) * ncells];
+            for (int i=begin;i<end;i++)
+                ++cnt[cellOf[i] = cellIndex(p[i])];
+        }
+
+        // Exclusive prefix sum in (cell, chunk) order
+        int total = 0;
+        for (int c=0;c<ncells;c++)
+        {
+            cellStart[c] = total;
+            for (int t=0;t<nchunks;t++)
+            {
+                int cnt = offs[size_t(t) * ncells + c];
+                offs[size_t(t) * ncells + c] = total;
+                total += cnt;
+            }
+        }
+        cellStart[ncells] = total;
+
+        FRACT_OMP(omp parallel for schedule(static))
+        for (int t=0;t<nchunks;t++)
+        {
+            int begin, end;
+            detail::ChunkRange(n, nchunks, t, begin, end);
+            int* off = &offs[size_t(t) * ncells];
+            for (int i=begin;i<end;i++)
+            {
+                int s = off[cellOf[i]]++;
+                sorted[s] = i;
+                slotOf[i] = s;
+                for (int k=0;k<3;k++)
+                    sc[k][s] = detail::FractAccess::raw(p[i][k]);
+            }
+        }
+    }
+
+    // Rebuild the index, to restore the sorted layout after many updates
+    void rebuild()
+    {
+        std::vector<VVector> p(pos);
+        build(p.empty() ? NULL : &p[0], int(p.size()));
+    }
+
+    // Move point i to position p
+    void update(int i, const VVector& p)
+    {
+        pos[i] = p;
+        int c = cellIndex(p);
+        if (c == cellOf[i])
+        {
+            if (slotOf[i] >= 0)
+                for (int k=0;k<3;k++)
+                    sc[k][slotOf[i]] = detail::FractAccess::raw(p[k]);
+            return;
+        }
+
+        if (slotOf[i] >= 0)
+        {
+            sorted[slotOf[i]] = -1;
+            slotOf[i] = -1;
+            ++nmoved;
+        }
+        else
+            unlinkMoved(i);
+
+        cellOf[i] = c;
+        movedNext[i] = movedHead[c];
+        movedHead[c] = i;
+    }
+
+    // Find the points within distance r (inclusive) from q. The indices are stored into
+    // out in increasing order, keeping the smallest maxout ones; return the total number
+    // of points found.
+    int radius(const VVector& q, VFract r, int* out, int maxout) const
+    {
+        DOMAIN_IF(r < 0);
+
+        IntType qr[3], rr = detail::FractAccess::raw(r);
+        int c0[3], c1[3];
+        for (int k=0;k<3;k++)
+        {
+            qr[k] = detail::FractAccess::raw(q[k]);
+            c0[k] = cellCoord(DIntType(qr[k]) - rr, k);
+            c1[k] = cellCoord(DIntType(qr[k]) + rr, k);
+        }
+
+        RadiusCollector f;
+        f.r2 = DUIntType(DIntType(rr) * rr);
+        f.out = out;
+        f.maxout = maxout;
+        f.count = 0;
+        for (int z=c0[2];z<=c1[2];z++)
+            for (int y=c0[1];y<=c1[1];y++)
+                visitRow(c0[0], c1[0], y, z, qr, f);
+        std::sort(out, out + std::min(f.count, std::max(maxout, 0)));
+        return f.count;
+    }
+
+    // Find the k nearest points to q, sorted by increasing distance (ties are broken
+    // by index). Return the number of points stored into out (less than k only if the
+    // grid contains less than k points).
+    int nearest(const VVector& q, int k, int* out) const
+    {
+        NearestCollector f;
+        f.d2.resize(k);
+        f.out = out;
+        f.k = k;
+        f.count = 0;
+        if (k <= 0)
+            return 0;
+
+        IntType qr[3];
+        int qc[3];
+        for (int j=0;j<3;j++)
+        {
+            qr[j] = detail::FractAccess::raw(q[j]);
+            qc[j] = cellCoord(qr[j], j);
+        }
+
+        // Visit the cells in rings of increasing Chebyshev distance from the cell of q.
+        // The points outside ring d are farther than d-1 cells from q.
+        int maxring = std::max(dim[0], std::max(dim[1], dim[2]));
+        for (int d=0;d<maxring;d++)
+        {
+            int z0 = std::max(qc[2]-d, 0), z1 = std::min(qc[2]+d, dim[2]-1);
+            int y0 = std::max(qc[1]-d, 0), y1 = std::min(qc[1]+d, dim[1]-1);
+            int x0 = std::max(qc[0]-d, 0), x1 = std::min(qc[0]+d, dim[0]-1);
+            for (int z=z0;z<=z1;z++)
+                for (int y=y0;y<=y1;y++)
+                {
+                    if (abs(z-qc[2]) == d || abs(y-qc[1]) == d)
+                        visitRow(x0, x1, y, z, qr, f);
+                    else
+                    {
+                        if (qc[0]-d >= 0)
+                            visitRow(qc[0]-d, qc[0]-d, y, z, qr, f);
+                        if (d > 0 && qc[0]+d < dim[0])
+                            visitRow(qc[0]+d, qc[0]+d, y, z, qr, f);
+                    }
+                }
+
+            if (f.count == k)
+            {
+                DUIntType lb = DUIntType(d) << shift;
+                if (lb >> (bitsof(DUIntType)/2) || f.d2[k-1] < lb * lb)
+                    break;
+            }
+        }
+        return f.count;
+    }
+};
+
+#endif // FIXEDGRID_H
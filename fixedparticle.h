@@ -0,0 +1,393 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains a batch integrator for particle systems, working on the
+ * structure-of-arrays layout of Vector3DArray.
+ */
+
+#ifndef FIXEDPARTICLE_H
+#define FIXEDPARTICLE_H
+
+#include "fixedgeom.h"
+#include "fixedpoint/parallel.h"
+#include <algorithm>
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // ParticleStep<IntType> -- kernels of ParticleIntegrator, on particles
+    // [begin, end). Each new value is computed as a fused multiply-add at
+    // double width, (x*2^shift + a*c) >> shift where c has shift fractional
+    // bits, so it is rounded only once.
+    //
+    // The kernels run inside parallel regions, so they cannot throw: overflows
+    // are reported through ovf. The return value is the number of particles
+    // that have been clamped into the bounds.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct ParticleParams
+    {
+        IntType c;          // dt for euler(), dt^2 for verlet()
+        int shift;          // fractional bits of c
+        IntType rmin, rmax; // range of the format
+        bool bounded;
+        IntType lo[3], hi[3];
+    };
+
+    template <class IntType>
+    struct ParticleStepScalar
+    {
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+        typedef ParticleParams<IntType> Params;
+
+        static DIntType fma(DIntType x, IntType a, IntType c, int shift)
+        {
+            return (x * (DIntType(1) << shift) + DIntType(a) * c) >> shift;
+        }
+
+        static bool out(DIntType x, IntType lo, IntType hi)
+        {
+            return x < lo || x > hi;
+        }
+
+        // Clamp x into the bounds of axis k, or check it for overflow
+        static bool bound(DIntType& x, const Params& p, int k, int& ovf)
+        {
+            if (!p.bounded)
+            {
+                ovf |= out(x, p.rmin, p.rmax);
+                return false;
+            }
+            if (!out(x, p.lo[k], p.hi[k]))
+                return false;
+            x = (x < p.lo[k]) ? p.lo[k] : p.hi[k];
+            return true;
+        }
+
+        static int euler(IntType* const* x, IntType* const* v, const IntType* const* a,
+                         int begin, int end, const Params& p, int& ovf)
+        {
+            int clamped = 0;
+            for (int i=begin;i<end;i++)
+            {
+                bool cl = false;
+                for (int k=0;k<3;k++)
+                {
+                    DIntType nv = fma(v[k][i], a[k][i], p.c, p.shift);
+                    ovf |= out(nv, p.rmin, p.rmax);
+                    DIntType nx = fma(x[k][i], IntType(nv), p.c, p.shift);
+                    if (bound(nx, p, k, ovf))
+                    {
+                        nv = 0;
+                        cl = true;
+                    }
+                    v[k][i] = IntType(nv);
+                    x[k][i] = IntType(nx);
+                }
+                clamped += cl;
+            }
+            return clamped;
+        }
+
+        static int verlet(IntType* const* x, IntType* const* xp, const IntType* const* a,
+                          int begin, int end, const Params& p, int& ovf)
+        {
+            int clamped = 0;
+            for (int i=begin;i<end;i++)
+            {
+                bool cl = false;
+                for (int k=0;k<3;k++)
+                {
+                    DIntType nx = fma(DIntType(x[k][i]) * 2 - xp[k][i], a[k][i], p.c, p.shift);
+                    IntType prev = x[k][i];
+                    if (bound(nx, p, k, ovf))
+                    {
+                        prev = IntType(nx);
+                        cl = true;
+                    }
+                    xp[k][i] = prev;
+                    x[k][i] = IntType(nx);
+                }
+                clamped += cl;
+            }
+            return clamped;
+        }
+    };
+
+    template <class IntType>
+    struct ParticleStep : public ParticleStepScalar<IntType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    template <>
+    struct ParticleStep<int32_t> : public ParticleStepScalar<int32_t>
+    {
+        typedef ParticleStepScalar<int32_t> Scalar;
+
+        // 64-bit lanes of a pair of even/odd vectors
+        struct Wide
+        {
+            __m256i e, o;
+        };
+
+        static Wide widen(__m256i x)
+        {
+            __m256i one = _mm256_set1_epi32(1);
+            Wide w = { avx2::mul_even(x, one), avx2::mul_odd(x, one) };
+            return w;
+        }
+
+        // Vectorized Scalar::fma(), on the 64-bit x
+        static Wide fma(Wide x, __m256i a, __m256i c, int shift)
+        {
+            __m256i sh = _mm256_set1_epi64x(shift);
+            __m128i shl = _mm_cvtsi32_si128(shift);
+            Wide r = {
+                avx2::srav64(_mm256_add_epi64(_mm256_sll_epi64(x.e, shl), avx2::mul_even(a, c)), sh),
+                avx2::srav64(_mm256_add_epi64(_mm256_sll_epi64(x.o, shl), avx2::mul_odd(a, c)), sh)
+            };
+            return r;
+        }
+
+        static __m256i out(Wide x, __m256i lo, __m256i hi)
+        {
+            return _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi64(lo, x.e), _mm256_cmpgt_epi64(x.e, hi)),
+                                   _mm256_or_si256(_mm256_cmpgt_epi64(lo, x.o), _mm256_cmpgt_epi64(x.o, hi)));
+        }
+
+        static __m256i clamp(__m256i x, __m256i lo, __m256i hi)
+        {
+            x = _mm256_blendv_epi8(x, lo, _mm256_cmpgt_epi64(lo, x));
+            return _mm256_blendv_epi8(x, hi, _mm256_cmpgt_epi64(x, hi));
+        }
+
+        // Vectorized Scalar::bound(): return the narrowed x, and the mask of the
+        // clamped lanes in cl
+        static __m256i bound(Wide x, const Params& p, int k, __m256i& ovf, __m256i& cl)
+        {
+            if (!p.bounded)
+            {
+                ovf = _mm256_or_si256(ovf, out(x, _mm256_set1_epi64x(p.rmin), _mm256_set1_epi64x(p.rmax)));
+                cl = _mm256_setzero_si256();
+                return avx2::pack(x.e, x.o);
+            }
+
+            __m256i lo = _mm256_set1_epi64x(p.lo[k]), hi = _mm256_set1_epi64x(p.hi[k]);
+            __m256i ce = _mm256_or_si256(_mm256_cmpgt_epi64(lo, x.e), _mm256_cmpgt_epi64(x.e, hi));
+            __m256i co = _mm256_or_si256(_mm256_cmpgt_epi64(lo, x.o), _mm256_cmpgt_epi64(x.o, hi));
+            cl = avx2::pack(ce, co);
+            return avx2::pack(clamp(x.e, lo, hi), clamp(x.o, lo, hi));
+        }
+
+        static int count(__m256i cl)
+        {
+            return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(cl)));
+        }
+
+        static int euler(int32_t* const* x, int32_t* const* v, const int32_t* const* a,
+                         int begin, int end, const Params& p, int& ovf)
+        {
+            __m256i vc = _mm256_set1_epi32(p.c);
+            __m256i rmin = _mm256_set1_epi64x(p.rmin), rmax = _mm256_set1_epi64x(p.rmax);
+            __m256i vovf = _mm256_setzero_si256();
+            int clamped = 0;
+            int i = begin;
+            for (;i+8<=end;i+=8)
+            {
+                __m256i any = _mm256_setzero_si256();
+                for (int k=0;k<3;k++)
+                {
+                    Wide nv = fma(widen(avx2::load(v[k]+i)), avx2::load(a[k]+i), vc, p.shift);
+                    vovf = _mm256_or_si256(vovf, out(nv, rmin, rmax));
+                    __m256i vn = avx2::pack(nv.e, nv.o);
+
+                    __m256i cl;
+                    __m256i xn = bound(fma(widen(avx2::load(x[k]+i)), vn, vc, p.shift), p, k, vovf, cl);
+                    avx2::store(v[k]+i, _mm256_andnot_si256(cl, vn));
+                    avx2::store(x[k]+i, xn);
+                    any = _mm256_or_si256(any, cl);
+                }
+                clamped += count(any);
+            }
+            ovf |= avx2::any(vovf);
+            return clamped + Scalar::euler(x, v, a, i, end, p, ovf);
+        }
+
+        static int verlet(int32_t* const* x, int32_t* const* xp, const int32_t* const* a,
+                          int begin, int end, const Params& p, int& ovf)
+        {
+            __m256i vc = _mm256_set1_epi32(p.c);
+            __m256i vovf = _mm256_setzero_si256();
+            int clamped = 0;
+            int i = begin;
+            for (;i+8<=end;i+=8)
+            {
+                __m256i any = _mm256_setzero_si256();
+                for (int k=0;k<3;k++)
+                {
+                    __m256i vx = avx2::load(x[k]+i);
+                    Wide wx = widen(vx), wp = widen(avx2::load(xp[k]+i));
+                    Wide d = { _mm256_sub_epi64(_mm256_add_epi64(wx.e, wx.e), wp.e),
+                               _mm256_sub_epi64(_mm256_add_epi64(wx.o, wx.o), wp.o) };
+
+                    __m256i cl;
+                    __m256i xn = bound(fma(d, avx2::load(a[k]+i), vc, p.shift), p, k, vovf, cl);
+                    avx2::store(xp[k]+i, _mm256_blendv_epi8(vx, xn, cl));
+                    avx2::store(x[k]+i, xn);
+                    any = _mm256_or_si256(any, cl);
+                }
+                clamped += count(any);
+            }
+            ovf |= avx2::any(vovf);
+            return clamped + Scalar::verlet(x, xp, a, i, end, p, ovf);
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// ParticleIntegrator -- advance particle systems stored as Vector3DArray
+//
+// Each updated coordinate is computed with a single rounding (fused multiply-add at
+// double width). If bounds are set, the positions saturate at the bounds: the clamped
+// components also lose their velocity, and the integration functions return the number
+// of particles that have been clamped. Without bounds, positions which do not fit the
+// format raise an overflow error (as do velocities, in any case); in that case the
+// arrays are left partially updated.
+//
+// Particles are processed in chunks, in parallel when OpenMP is enabled. The results
+// do not depend on the number of threads, nor on the availability of SIMD.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class ParticleIntegrator
+{
+public:
+    typedef Fract<I,F> VFract;
+    typedef Vector3D<I,F> VVector;
+    typedef Vector3DArray<I,F> VArray;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::ParticleStep<IntType> Step;
+    typedef detail::ParticleParams<IntType> Params;
+    typedef int (*Kernel)(IntType* const*, IntType* const*, const IntType* const*,
+                          int, int, const Params&, int&);
+
+    enum { CHUNK = 4096 };
+
+    VFract dt;
+    Params p;
+    IntType dt2;        // dt^2, with dt2_shift fractional bits
+    int dt2_shift;
+
+    static IntType* col(VArray& v, int k) { return reinterpret_cast<IntType*>(v.column(k)); }
+    static const IntType* col(const VArray& v, int k) { return reinterpret_cast<const IntType*>(v.column(k)); }
+
+    int run(Kernel kernel, VArray& x, VArray& y, const VArray& a, IntType c, int shift) const
+    {
+        assert(x.size() == y.size() && x.size() == a.size());
+
+        Params pc = p;
+        pc.c = c;
+        pc.shift = shift;
+        IntType* px[3] = { col(x, 0), col(x, 1), col(x, 2) };
+        IntType* py[3] = { col(y, 0), col(y, 1), col(y, 2) };
+        const IntType* pa[3] = { col(a, 0), col(a, 1), col(a, 2) };
+
+        int n = x.size();
+        int nchunks = (n + CHUNK - 1) / CHUNK;
+        int clamped = 0, ovf = 0;
+
+        FRACT_OMP(omp parallel for schedule(static) reduction(+:clamped) reduction(|:ovf))
+        for (int t=0;t<nchunks;t++)
+        {
+            int end = (t+1) * CHUNK;
+            clamped += kernel(px, py, pa, t * CHUNK, (end < n) ? end : n, pc, ovf);
+        }
+
+        OVERFLOW_IF(ovf);
+        return clamped;
+    }
+
+public:
+    explicit ParticleIntegrator(VFract dt_)
+        : dt(dt_)
+    {
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+        p.rmax = IntType(~(UIntType(~UIntType(0)) << (I+F-1)));
+        p.rmin = ~p.rmax;
+        p.bounded = false;
+
+        // Keep as many fractional bits of dt^2 as possible, leaving room in the
+        // accumulator for 2*x - xprev (I+F+2 bits) shifted by dt2_shift. Both terms
+        // of the fused multiply-add then stay below a quarter of the range of
+        // DIntType, so their sum cannot overflow.
+        IntType d = detail::FractAccess::raw(dt);
+        DIntType d2 = DIntType(d) * d;
+        dt2_shift = std::min(2*F, bitsof(DIntType) - (I+F) - 4);
+        while (!AnyInt::FitIn(d2 >> (2*F - dt2_shift), I+F))
+            --dt2_shift;
+        dt2 = IntType(d2 >> (2*F - dt2_shift));
+        assert((I+F+2) + dt2_shift <= bitsof(DIntType) - 2 && 2*(I+F) - 2 <= bitsof(DIntType) - 2);
+    }
+
+    VFract step() const { return dt; }
+
+    // Saturate the positions into the box [lo, hi]
+    void setBounds(const VVector& lo, const VVector& hi)
+    {
+        p.bounded = true;
+        for (int k=0;k<3;k++)
+        {
+            p.lo[k] = detail::FractAccess::raw(lo[k]);
+            p.hi[k] = detail::FractAccess::raw(hi[k]);
+        }
+    }
+
+    void clearBounds()
+    {
+        p.bounded = false;
+    }
+
+    // Semi-implicit Euler: v = v + a*dt, then x = x + v*dt (with the new v)
+    int euler(VArray& x, VArray& v, const VArray& a) const
+    {
+        return run(&Step::euler, x, v, a, detail::FractAccess::raw(dt), F);
+    }
+
+    // Position Verlet: x = 2*x - xprev + a*dt^2, and xprev receives the old x. dt^2 is
+    // computed once, with more fractional bits than the format.
+    int verlet(VArray& x, VArray& xprev, const VArray& a) const
+    {
+        return run(&Step::verlet, x, xprev, a, dt2, dt2_shift);
+    }
+};
+
+#endif // FIXEDPARTICLE_H
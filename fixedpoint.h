@@ -65,10 +65,18 @@
     #define OVERFLOW_IF(x) do { if (UNLIKELY(x)) { throwFractOverflowError(); } } while(0)
     #define DOMAIN_IF(x)   do { if (UNLIKELY(x)) { throwFractDomainError(); } } while(0)
 #else
-    #define OVERFLOW_IF(x) assert(x)
-    #define DOMAIN_IF(x)   assert(x)
+    #define OVERFLOW_IF(x) assert(!(x))
+    #define DOMAIN_IF(x)   assert(!(x))
 #endif
 
+// What the batch operations do with results that do not fit the format
+enum FractOverflowPolicy
+{
+    FRACT_OVERFLOW_CHECK,       // raise an overflow error (like the scalar operations)
+    FRACT_OVERFLOW_SATURATE,    // clamp to the range of the format
+    FRACT_OVERFLOW_WRAP         // keep the low I+F bits (two's complement)
+};
+
 
 // Fwd decl
 template <int I, int F>
@@ -82,6 +90,8 @@ namespace detail {
         T x;
         FractBuilder(T x_) : x(x_) {}
     };
+
+    struct FractAccess;
 }
 
 // Internal functions
@@ -89,6 +99,7 @@ namespace detail {
 #include "fixedpoint/anyint.h"
 #include "fixedpoint/stringify.h"
 #include "fixedpoint/reciprocal.h"
+#include "fixedpoint/rsqrt.h"
 
 template <class ToType, class FromType>
 inline ToType fx_align(FromType x, int from_bits, int to_bits) __attribute__((__always_inline__));
@@ -133,6 +144,8 @@ private:
     template <class T>
     friend class detail::LazyFract;
 
+    friend struct detail::FractAccess;
+
 private:
     Fract(detail::FractBuilder<IntType> b) : x(b.x) {}
 
@@ -157,11 +170,6 @@ public:
         set(x2, F2);
     }
 
-    Fract(const Fract& f)
-    {
-        x = f.x;
-    }
-
     template <int I2, int F2>
     explicit Fract(const Fract<I2,F2>& f)
     {
@@ -196,7 +204,6 @@ public:
         return gen(detail::fromString<IntType>(s, F, ok));
     }
 
-    Fract& operator=(Fract f) { x = f.x; return *this; }
     Fract operator+(Fract f) const { OVERFLOW_IF(AnyInt::AddOverflow(x, f.x)); return gen(x+f.x); }
     Fract operator-(Fract f) const { OVERFLOW_IF(AnyInt::SubOverflow(x, f.x)); return gen(x-f.x); }
     Fract operator*(Fract f) const { OVERFLOW_IF(AnyInt::ScaledMulOverflow(x, f.x, F)); return gen(AnyInt::MulHS(x, f.x, F)); }
@@ -254,6 +261,8 @@ public:
     friend Fract<I/2,F/2> sqrt_fast(Fract<I,F> x)
     {
         DOMAIN_IF(x<0);
+        if (x.x == 0)
+            return Fract<I/2,F/2>::gen(0);
 
         IntType temp, val=x.x, g=0, bshft=(AnyInt::Log2Ceil(val)-1)>>1, b=(1<<bshft);
         do
@@ -279,6 +288,24 @@ public:
         return sqrt_fast(x2);
     }
 
+    // Reciprocal square root (1/sqrt(x)), computed with integer-only
+    // Newton-Raphson iterations (see detail::RSqrt).
+    friend Fract rsqrt(Fract x)
+    {
+        DOMAIN_IF(x.x <= 0);
+
+        typedef typename AnyInt::Bigger<IntType, int32_t>::type WIntType;
+        typedef typename AnyInt::DoubleType<WIntType>::type DIntType;
+
+        int frac;
+        DIntType y = detail::RSqrt<WIntType>::eval(x.x, F, frac);
+
+        // Round to nearest (the iteration converges from below)
+        if (frac > F)
+            y += DIntType(1) << (frac - F - 1);
+        return Fract(y, frac);
+    }
+
     friend Fract abs(Fract x)
     {
         return gen(::abs(x.x));
@@ -300,4 +327,31 @@ public:
     }
 };
 
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // FractAccess -- raw access to the underlying integer of a Fract.
+    // This is meant for internal kernels (eg: the geometric library) that
+    // need to accumulate several products at double width and round only
+    // once at the end, which is not possible through the public operators.
+    /////////////////////////////////////////////////////////////////////////
+    struct FractAccess
+    {
+        template <int I, int F>
+        struct Traits
+        {
+            typedef typename Fract<I,F>::IntType IntType;
+            typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+        };
+
+        template <int I, int F>
+        static typename Traits<I,F>::IntType INLINE raw(Fract<I,F> f)
+        { return f.x; }
+
+        template <int I, int F>
+        static Fract<I,F> INLINE gen(typename Traits<I,F>::IntType x)
+        { return Fract<I,F>::gen(x); }
+    };
+}
+
 #endif /* FIXEDPOINT_H */
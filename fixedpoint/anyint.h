@@ -114,7 +114,8 @@ namespace AnyInt
     template <class IntType>
     int Log2Ceil(IntType x)
     {
-        return bitsof(IntType) - clz(x);
+        // clz(0) is undefined
+        return x ? bitsof(IntType) - clz(x) : 0;
     }
 
 
@@ -177,6 +178,10 @@ namespace AnyInt
     template <> struct Unsigned<uint16_t> { typedef uint16_t type; };
     template <> struct Unsigned<uint32_t> { typedef uint32_t type; };
     template <> struct Unsigned<uint64_t> { typedef uint64_t type; };
+#ifdef FRACT_HAS_128BITS
+    template <> struct Unsigned<int128_t> { typedef uint128_t type; };
+    template <> struct Unsigned<uint128_t> { typedef uint128_t type; };
+#endif
 
     //////////////////////////////////////////////////////////////////////////
     // DoubleType<T> - select the type which is two times bigger than T
@@ -250,7 +255,7 @@ namespace AnyInt
         typedef typename Unsigned<IntType>::type UIntType;
 
         UIntType aa = a, bb = b, diff = aa-bb;
-        return IntType((bb ^ aa) & (bb ^ diff)) < 0;
+        return IntType((aa ^ bb) & (aa ^ diff)) < 0;
     }
 
     //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,216 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * dispatch: batch kernels selected at runtime from the features of the CPU.
+ *
+ * The kernels in dispatch_kernels.h are compiled once for each ISA level
+ * (with GCC target options, whatever the flags of the build), and collected
+ * in a table of function pointers per level. The level is chosen once, the
+ * first time it is needed: the best one supported by the CPU, unless the
+ * environment variable FRACT_ISA asks for a lower one ("generic", "sse4.2",
+ * "avx2" or "avx512"). A level higher than what the CPU supports is never
+ * selected. fract_isa() tells which level is in use.
+ *
+ * All levels give identical results. Runtime selection needs GCC on x86;
+ * elsewhere only the generic level exists.
+ */
+
+#ifndef FIXEDPOINT_DISPATCH_H
+#define FIXEDPOINT_DISPATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define FRACT_HAS_DISPATCH
+#endif
+
+enum FractIsa
+{
+    FRACT_ISA_GENERIC,          // baseline of the build
+    FRACT_ISA_SSE42,            // SSE4.2
+    FRACT_ISA_AVX2,             // AVX2
+    FRACT_ISA_AVX512,           // AVX-512 (F, BW, DQ, VL)
+    FRACT_ISA_COUNT
+};
+
+namespace detail
+{
+    // Errors reported by the kernels, raised by the caller (outside of them)
+    enum { FRACT_KERNEL_OVERFLOW = 1, FRACT_KERNEL_DOMAIN = 2 };
+
+    /////////////////////////////////////////////////////////////////////////
+    // DispatchTable -- kernels compiled for one ISA level
+    /////////////////////////////////////////////////////////////////////////
+    struct DispatchTable
+    {
+        int (*reciprocal)(int32_t* r, const int32_t* a, int n, int frac, int bits);
+        int (*sqrt)(int32_t* r, const int32_t* a, int n, int frac);
+        int (*convert_32_32)(int32_t* r, const int32_t* a, int n, int shift, int32_t lo, int32_t hi);
+        int (*convert_32_8)(int8_t* r, const int32_t* a, int n, int shift, int32_t lo, int32_t hi);
+        int (*convert_8_32)(int32_t* r, const int8_t* a, int n, int shift, int32_t lo, int32_t hi);
+        int (*convert_8_8)(int8_t* r, const int8_t* a, int n, int shift, int32_t lo, int32_t hi);
+    };
+}
+
+// The kernels never divide by zero nor take the square root of a negative
+// number, so they can be built without trapping math and errno (which
+// would otherwise keep the loops from being vectorized).
+#ifdef __GNUC__
+#pragma GCC push_options
+#pragma GCC optimize("no-trapping-math,no-math-errno")
+#endif
+
+#define FRACT_ISA_NAMESPACE isa_generic
+#include "dispatch_kernels.h"
+#undef FRACT_ISA_NAMESPACE
+
+#ifdef FRACT_HAS_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#define FRACT_ISA_NAMESPACE isa_sse42
+#include "dispatch_kernels.h"
+#undef FRACT_ISA_NAMESPACE
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma,bmi,bmi2,popcnt")
+#define FRACT_ISA_NAMESPACE isa_avx2
+#include "dispatch_kernels.h"
+#undef FRACT_ISA_NAMESPACE
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma,bmi,bmi2,popcnt")
+#define FRACT_ISA_NAMESPACE isa_avx512
+#include "dispatch_kernels.h"
+#undef FRACT_ISA_NAMESPACE
+#pragma GCC pop_options
+#endif
+
+#ifdef __GNUC__
+#pragma GCC pop_options
+#endif
+
+namespace detail
+{
+    /////////////////////////////////////////////////////////////////////////
+    // Dispatch -- detection of the ISA level and selection of the table
+    /////////////////////////////////////////////////////////////////////////
+    struct Dispatch
+    {
+        // Best level supported by the CPU
+        static FractIsa detect()
+        {
+        #ifdef FRACT_HAS_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+                return FRACT_ISA_AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2"))
+                return FRACT_ISA_AVX2;
+            if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+                return FRACT_ISA_SSE42;
+        #endif
+            return FRACT_ISA_GENERIC;
+        }
+
+        static const char* name(FractIsa isa)
+        {
+            static const char* names[FRACT_ISA_COUNT] = { "generic", "sse4.2", "avx2", "avx512" };
+            return (isa >= 0 && isa < FRACT_ISA_COUNT) ? names[isa] : "unknown";
+        }
+
+        // Level to use: the detected one, possibly lowered by env (the value of
+        // FRACT_ISA). Unknown names, or levels above the detected one, are ignored.
+        static FractIsa select(const char* env)
+        {
+            FractIsa isa = detect();
+            if (env)
+                for (int i=0;i<isa;i++)
+                    if (strcmp(env, name(FractIsa(i))) == 0)
+                        return FractIsa(i);
+            return isa;
+        }
+
+        static FractIsa select()
+        {
+            return select(getenv("FRACT_ISA"));
+        }
+
+        static FractIsa current()
+        {
+            static FractIsa isa = select();
+            return isa;
+        }
+
+        // Table of the kernels compiled for a level (which the CPU must support)
+        static const DispatchTable& table(FractIsa isa)
+        {
+        #ifdef FRACT_HAS_DISPATCH
+            static const DispatchTable tables[FRACT_ISA_COUNT] = {
+                isa_generic::table(), isa_sse42::table(), isa_avx2::table(), isa_avx512::table()
+            };
+            return tables[isa];
+        #else
+            static const DispatchTable generic = isa_generic::table();
+            return generic;
+        #endif
+        }
+
+        static const DispatchTable& table()
+        {
+            return table(current());
+        }
+
+        // Conversions between int8 and int32 formats (see BatchScalar::convert)
+        static int convert(int32_t* r, const int32_t* a, int n, int shift, int32_t lo, int32_t hi)
+        { return table().convert_32_32(r, a, n, shift, lo, hi); }
+        static int convert(int8_t* r, const int32_t* a, int n, int shift, int32_t lo, int32_t hi)
+        { return table().convert_32_8(r, a, n, shift, lo, hi); }
+        static int convert(int32_t* r, const int8_t* a, int n, int shift, int32_t lo, int32_t hi)
+        { return table().convert_8_32(r, a, n, shift, lo, hi); }
+        static int convert(int8_t* r, const int8_t* a, int n, int shift, int32_t lo, int32_t hi)
+        { return table().convert_8_8(r, a, n, shift, lo, hi); }
+    };
+}
+
+// ISA level of the dispatched kernels, and its name
+inline FractIsa fract_isa()
+{
+    return detail::Dispatch::current();
+}
+
+inline const char* fract_isa_name(FractIsa isa = fract_isa())
+{
+    return detail::Dispatch::name(isa);
+}
+
+#endif // FIXEDPOINT_DISPATCH_H
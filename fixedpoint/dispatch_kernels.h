@@ -0,0 +1,173 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Kernels of the dispatch tables (see dispatch.h).
+ *
+ * This file has no include guard: dispatch.h includes it once for each ISA
+ * level, with FRACT_ISA_NAMESPACE set to the name of the level and the
+ * matching target options in effect. The loops are written without
+ * branches, so that the compiler can vectorize them for each level; they
+ * must not call other functions, which would be compiled for the baseline
+ * ISA only.
+ */
+
+namespace detail { namespace FRACT_ISA_NAMESPACE {
+
+    // r[i] = 2^(2*frac) / a[i], bits being the size of the format: the same
+    // Newton-Raphson iteration as the scalar reciprocal() (LazyReciprocal
+    // evaluated to bits of precision, and multiplied by one), on the magnitude
+    // of a[i]. No division is used.
+    inline int reciprocal(int32_t* r, const int32_t* a, int n, int frac, int bits)
+    {
+        const int32_t hi = int32_t(~(~uint32_t(0) << (bits-1))), lo = ~hi;
+        const uint32_t one = uint32_t(1) << frac;
+
+        // Steps of the iteration (see LazyReciprocal::evaluate), and
+        // corrections after the highest bit has been made implicit
+        const int steps = (bits <= 3) ? 0 : (bits <= 6) ? 1 : (bits <= 12) ? 2 : (bits <= 24) ? 3 : 4;
+        const int wide = (bits > 30);
+        const int corr = wide ? bits - 29 : 0;
+
+        // The scalar function builds Fract(1), which must fit the format
+        int zero = 0, ovf = (n > 0) && (bits - frac <= 1);
+
+        for (int i=0;i<n;i++)
+        {
+            int32_t x = a[i];
+            uint32_t m = (x < 0) ? 0u - uint32_t(x) : uint32_t(x);
+            zero |= (x == 0);
+            m |= (x == 0);
+
+            int s = __builtin_clz(m);
+            uint32_t u = m << s;
+            int pow2 = (uint32_t(u << 1) == 0);
+
+            uint32_t y = 0x7FFFFFFFu - u;
+            for (int k=0;k<steps;k++)
+                y = uint32_t(uint32_t((uint64_t(y) * uint32_t(0u - uint32_t((uint64_t(y) * u) >> 32))) >> 32) << 1);
+            if (!wide && steps > 0)
+                y -= uint32_t(uint32_t((uint64_t(y) * u) >> 32) << 1);
+            if (wide)
+            {
+                y = (y << 1) - 3;
+                for (int k=0;k<corr;k++)
+                    y -= uint32_t((uint64_t(y) * u) >> 32) + u;
+            }
+
+            int hb = wide & !pow2;
+            y = pow2 ? u : y;
+            int rs = 63 - s - frac - pow2 + hb;
+
+            // LazyFract::operator*, with b = 1
+            uint64_t p = uint64_t(y) * one;
+            uint64_t pn = (p + (uint64_t(hb ? one : 0) << 32)) >> (rs < 32 ? rs : 0);
+            uint64_t pw = hb ? uint64_t(int64_t(uint32_t(p >> 32)) + one) >> (rs >= 32 ? rs - 32 : 0)
+                             : p >> (rs >= 32 ? rs : 0);
+            int64_t q = int64_t(uint32_t(rs < 32 ? pn : pw));
+            ovf |= (rs < 32) & ((pn >> 31) != 0);
+
+            q = (x < 0) ? -q : q;
+            ovf |= (q < lo) | (q > hi);
+            r[i] = int32_t(q);
+        }
+        return (zero ? FRACT_KERNEL_DOMAIN : 0) | (ovf ? FRACT_KERNEL_OVERFLOW : 0);
+    }
+
+    // r[i] = sqrt(a[i] * 2^frac), rounded toward minus infinity
+    inline int sqrt(int32_t* r, const int32_t* a, int n, int frac)
+    {
+        int neg = 0;
+
+        for (int i=0;i<n;i++)
+        {
+            int32_t x = a[i];
+            int64_t v = int64_t(x < 0 ? 0 : x) << frac;
+            int64_t s = int32_t(__builtin_sqrt(double(v)));
+            s -= (s * s > v);
+            s += ((s + 1) * (s + 1) <= v);
+
+            neg |= (x < 0);
+            r[i] = int32_t(s);
+        }
+        return neg ? FRACT_KERNEL_DOMAIN : 0;
+    }
+
+    // BatchScalar::convert() between int8 and int32 formats
+    template <class InType, class OutType>
+    inline int convert(OutType* r, const InType* a, int n, int shift, int32_t lo, int32_t hi)
+    {
+        int count = 0;
+
+        if (shift >= 0)
+        {
+            int sh = (shift < 31) ? shift : 31;
+            for (int i=0;i<n;i++)
+            {
+                int32_t y = int32_t(a[i]) >> sh;
+                int32_t c = y < lo ? lo : y;
+                c = c > hi ? hi : c;
+                count += (c != y);
+                r[i] = OutType(c);
+            }
+            return count;
+        }
+
+        // Range of the inputs that fit once shifted left
+        int sh = -shift;
+        int32_t ilo = 0, ihi = 0;
+        if (sh < 31)
+        {
+            ihi = hi >> sh;
+            ilo = lo >> sh;
+            if (int32_t(ilo << sh) != lo)
+                ilo++;
+        }
+        for (int i=0;i<n;i++)
+        {
+            int32_t x = a[i];
+            int32_t y = int32_t(uint32_t(x) << (sh < 31 ? sh : 31));
+            y = x < ilo ? lo : y;
+            y = x > ihi ? hi : y;
+            count += (x < ilo) | (x > ihi);
+            r[i] = OutType(y);
+        }
+        return count;
+    }
+
+    inline DispatchTable table()
+    {
+        DispatchTable t;
+        t.reciprocal = &reciprocal;
+        t.sqrt = &sqrt;
+        t.convert_32_32 = &convert<int32_t, int32_t>;
+        t.convert_32_8 = &convert<int32_t, int8_t>;
+        t.convert_8_32 = &convert<int8_t, int32_t>;
+        t.convert_8_8 = &convert<int8_t, int8_t>;
+        return t;
+    }
+}}
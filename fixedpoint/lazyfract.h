@@ -54,6 +54,9 @@ namespace detail {
     // Thus, the intermediate result must be stored somehow,
     // and this is done with LazyFract.
     //
+    // The evaluated number is a magnitude: if result_negative
+    // is set, the final result is negated.
+    //
     /////////////////////////////////////////////////////
 
     template <class Derived>
@@ -62,9 +65,10 @@ namespace detail {
     protected:
         mutable int result_highestbit;
         mutable int result_shift;
+        bool result_negative;
 
     public:
-        LazyFract() : result_highestbit(0), result_shift(0)
+        LazyFract() : result_highestbit(0), result_shift(0), result_negative(false)
         {}
 
     public:
@@ -74,13 +78,27 @@ namespace detail {
             typedef typename Fract<I,F>::IntType IntType;
 
             IntType result = static_cast<const Derived*>(this)->template evaluate<I+F>();
-            assert(result_shift >= (int)sizeof(IntType)*8);
+
+            if (result_shift < (int)sizeof(IntType)*8)
+            {
+                // The result is bigger than b (eg: the reciprocal of a number
+                // smaller than one), so compute it at double width.
+                typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+                typedef typename AnyInt::DoubleType<UIntType>::type DUIntType;
+
+                DUIntType p = DUIntType(UIntType(result)) * UIntType(b.x);
+                if (result_highestbit)
+                    p += DUIntType(UIntType(b.x)) << (sizeof(IntType)*8);
+                p >>= result_shift;
+                OVERFLOW_IF(p >> (sizeof(IntType)*8-1));
+                return Fract<I,F>(result_negative ? -IntType(p) : IntType(p), F);
+            }
 
             if (!result_highestbit)
                 result = AnyInt::MulHU(result, b.x, result_shift);
             else
                 result = AnyInt::ScaledAdd(AnyInt::MulHU(result, b.x), b.x, result_shift - sizeof(IntType)*8);
-            return Fract<I,F>(result, F);
+            return Fract<I,F>(result_negative ? -result : result, F);
         }
 
         template <int I, int F>
@@ -0,0 +1,83 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * parallel: helpers for the multithreaded kernels.
+ *
+ * Threading is implemented with OpenMP, and it is enabled simply by compiling with
+ * OpenMP support (eg: -fopenmp); otherwise everything runs in the calling thread.
+ * The number of chunks does depend on the number of threads (see NumChunks), so
+ * results are reproducible only because the per-chunk operations are exact and are
+ * merged in chunk order: a kernel which rounds within a chunk, or merges partial
+ * results in a non-associative way, must use a fixed number of chunks instead.
+ */
+
+#ifndef FIXEDPOINT_PARALLEL_H
+#define FIXEDPOINT_PARALLEL_H
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+// Emit an OpenMP directive, eg: FRACT_OMP(omp parallel for schedule(static)).
+// Without OpenMP the directive is dropped, instead of being left as an unknown pragma.
+#ifdef _OPENMP
+    #define FRACT_OMP(x)  _Pragma(#x)
+#else
+    #define FRACT_OMP(x)
+#endif
+
+namespace detail
+{
+    // Number of threads available to the parallel kernels
+    inline int MaxThreads()
+    {
+    #ifdef _OPENMP
+        return omp_get_max_threads();
+    #else
+        return 1;
+    #endif
+    }
+
+    // Number of chunks for n items, so that each chunk has at least min_size
+    // items (but there is always at least one chunk).
+    inline int NumChunks(int n, int min_size, int max_chunks)
+    {
+        int c = n / min_size;
+        if (c > max_chunks) c = max_chunks;
+        return (c < 1) ? 1 : c;
+    }
+
+    // Split [0,n) into nchunks contiguous ranges; return the bounds of chunk i
+    inline void ChunkRange(int n, int nchunks, int i, int& begin, int& end)
+    {
+        begin = int((long long)n * i / nchunks);
+        end = int((long long)n * (i+1) / nchunks);
+    }
+}
+
+#endif // FIXEDPOINT_PARALLEL_H
@@ -48,27 +48,35 @@ namespace detail
     class LazyReciprocal : public LazyFract<LazyReciprocal<IntType> >
     {
     private:
+        // The iteration relies on wrapping arithmetic, which is well defined
+        // only for unsigned types.
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+
         IntType input;
         int input_shift;
 
     private:
         template <int PREC>
-        void nr_step(IntType& result, IntType input, int& curprec) const
+        void nr_step(UIntType& result, UIntType input, int& curprec) const
         {
             enum { NBITS = sizeof(IntType)*8 };
 
             if ((PREC/2) < NBITS)
             {
-                result = AnyInt::MulHU(result, -AnyInt::MulHU(result, input)) << 1;
+                result = UIntType(AnyInt::MulHU(result, UIntType(-AnyInt::MulHU(result, input))) << 1);
                 curprec = (PREC > NBITS) ? (NBITS-2) : PREC;
             }
         }
 
     public:
+        // The iteration runs on the magnitude of f (which, for the most
+        // negative number, only fits the unsigned type)
         template <int I, int F>
         LazyReciprocal(Fract<I,F> f)
-            : input(f.x), input_shift(F)
-        {}
+            : input(f.x < 0 ? IntType(-UIntType(f.x)) : f.x), input_shift(F)
+        {
+            this->result_negative = f.x < 0;
+        }
 
     public:
         template <int prec>
@@ -81,49 +89,49 @@ namespace detail
             this->result_highestbit = 0;
             this->result_shift = NBITS + (NBITS-shift) - input_shift - 1;
 
-            IntType input = this->input << shift;
-            if ((input << 1) == 0)  // Power of two
+            UIntType input = UIntType(this->input) << shift;
+            if (UIntType(input << 1) == 0)  // Power of two
             {
                 --this->result_shift;
                 return input;
             }
 
-            IntType result = 1;
+            UIntType result = 1;
 
             // 3-bits estimation
-            result = ((~IntType(0) ^ (IntType(1)<<(NBITS-1))) - input);
+            result = (UIntType(~UIntType(0)) >> 1) - input;
             if (prec <= 3)
                 return result;
 
             int curprec = 3;
-            STATIC_ASSERT(NBITS <= 128, Integer larger than 128 bits are unsupported by the following unrolled loop);
+            STATIC_ASSERT(NBITS <= 128, "Integer larger than 128 bits are unsupported by the following unrolled loop");
 
             nr_step<6>(result, input, curprec);
             if (curprec >= prec)
-                return result - (AnyInt::MulHU(result, input) << 1);
+                return result - UIntType(AnyInt::MulHU(result, input) << 1);
 
             nr_step<12>(result, input, curprec);
             if (curprec >= prec)
-                return result - (AnyInt::MulHU(result, input) << 1);
+                return result - UIntType(AnyInt::MulHU(result, input) << 1);
 
             nr_step<24>(result, input, curprec);
             if (curprec >= prec)
-                return result - (AnyInt::MulHU(result, input) << 1);
+                return result - UIntType(AnyInt::MulHU(result, input) << 1);
 
             nr_step<48>(result, input, curprec);
             if (curprec >= prec)
-                return result - (AnyInt::MulHU(result, input) << 1);
+                return result - UIntType(AnyInt::MulHU(result, input) << 1);
 
             nr_step<96>(result, input, curprec);
             if (curprec >= prec)
-                return result - (AnyInt::MulHU(result, input) << 1);
+                return result - UIntType(AnyInt::MulHU(result, input) << 1);
 
             nr_step<192>(result, input, curprec);
             if (curprec >= prec)
-                return result - (AnyInt::MulHU(result, input) << 1);
+                return result - UIntType(AnyInt::MulHU(result, input) << 1);
 
             // Highest bit is always one at this point
-            assert(result < 0);
+            assert(result >> (NBITS-1));
             result <<= 1;
             curprec--;
             this->result_highestbit = 1;
@@ -0,0 +1,122 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RSQRT_H
+#define RSQRT_H
+
+#include "anyint.h"
+
+namespace detail
+{
+    /*
+     * Reciprocal square root, computed with the Newton-Raphson iteration:
+     *
+     *     y' = y * (3 - m*y^2) / 2
+     *
+     * The argument is first normalized into a mantissa m in [1,4) and an even
+     * exponent, so that the iteration always works on the same range. The seed
+     * comes from a small table indexed by the top bits of m, which is accurate
+     * enough (~3%) to converge in three steps for 32-bit integers (four steps
+     * for 64-bit ones).
+     *
+     * Only integer arithmetic is used, so the result is exactly reproducible
+     * everywhere, and the batch kernels can match it bit by bit.
+     */
+    template <class IntType>
+    struct RSqrt
+    {
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+        typedef typename AnyInt::DoubleType<UIntType>::type DUIntType;
+        enum { W = bitsof(IntType), STEPS = (W <= 32) ? 3 : 4 };
+
+        // 1/sqrt(m) in Q2.30, for m in [i/8, (i+1)/8), i = 8..31
+        static const uint32_t seed[24];
+
+        // One Newton-Raphson step, written as y' = y + y*(1 - m*y^2)/2.
+        // Both y and m are in Q2.(W-2); y stays well below 2^(W-1), so it can be
+        // safely multiplied as a signed number.
+        static UIntType step(UIntType y, UIntType m)
+        {
+            UIntType y2 = UIntType((DUIntType(y) * y) >> (W-2));
+            UIntType my2 = UIntType((DUIntType(m) * y2) >> (W-2));
+            IntType d = IntType((UIntType(1) << (W-2)) - my2);
+            return y + UIntType((DIntType(y) * d) >> (W-1));
+        }
+
+        // Normalize x * 2^-F into m * 2^e, with m in [1,4) (Q2.(W-2)) and even e
+        static UIntType normalize(IntType x, int F, int& e)
+        {
+            int s = AnyInt::clz(x);
+            e = W-2-s-F;
+            if (e & 1)
+            {
+                --s;
+                ++e;
+            }
+            return UIntType(x) << s;
+        }
+
+        // Compute 1/sqrt(x * 2^-F), for x > 0. The result is y * 2^-frac.
+        static UIntType eval(IntType x, int F, int& frac)
+        {
+            assert(x > 0);
+
+            int e;
+            UIntType m = normalize(x, F, e);
+
+            UIntType y = UIntType(seed[(m >> (W-5)) - 8]) << (W-32);
+            for (int i=0;i<STEPS;i++)
+                y = step(y, m);
+
+            frac = (W-2) + e/2;
+            return y;
+        }
+
+        // Same as eval(), but also accept x == 0 (without branching), in which
+        // case y is zero.
+        static UIntType eval0(IntType x, int F, int& frac)
+        {
+            IntType zero = (x == 0);
+            UIntType y = eval(x | zero, F, frac);
+            return y & (UIntType(zero) - 1);
+        }
+    };
+
+    template <class IntType>
+    const uint32_t RSqrt<IntType>::seed[24] =
+    {
+        0x3e16d092U, 0x3abafd52U, 0x37dd20aeU, 0x3561335dU,
+        0x33333333U, 0x314468baU, 0x2f89baccU, 0x2dfa9cf2U,
+        0x2c905a6fU, 0x2b459b19U, 0x2a160d52U, 0x28fe28a0U,
+        0x27fb00f0U, 0x270a2574U, 0x262987b2U, 0x25576878U,
+        0x24924925U, 0x23d8e025U, 0x232a0fdaU, 0x2284df58U,
+        0x21e8748cU, 0x21540f7bU, 0x20c70664U, 0x2040c289U,
+    };
+}
+
+#endif // RSQRT_H
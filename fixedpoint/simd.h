@@ -0,0 +1,1285 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * simd: batch kernels on arrays of raw fixed point integers.
+ *
+ * Every kernel has a portable scalar version (BatchScalar) which reproduces
+ * exactly the rounding and overflow checks of the corresponding Fract
+ * operator. Batch<IntType> selects the fastest implementation available
+ * for a given integer type; vectorized versions must give bit-identical
+ * results.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "anyint.h"
+#include "rsqrt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#ifdef FRACT_HAS_AVX2
+    #include <immintrin.h>
+#endif
+
+namespace detail
+{
+    /////////////////////////////////////////////////////////////////////////
+    // AlignedAlloc / AlignedFree -- memory for batch kernels, aligned to a
+    // full cache line (which is also enough for any SIMD load).
+    /////////////////////////////////////////////////////////////////////////
+    enum { SIMD_ALIGN = 64 };
+
+    inline void* AlignedAlloc(size_t size)
+    {
+        void* p = NULL;
+        if (posix_memalign(&p, SIMD_ALIGN, size ? size : size_t(SIMD_ALIGN)) != 0)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    inline void AlignedFree(void* p)
+    {
+        free(p);
+    }
+
+    // Scoped temporary buffer for batch kernels
+    template <class T>
+    class AlignedBuffer
+    {
+        T* p;
+
+        AlignedBuffer(const AlignedBuffer&);
+        AlignedBuffer& operator=(const AlignedBuffer&);
+
+    public:
+        explicit AlignedBuffer(int n) : p(static_cast<T*>(AlignedAlloc(n * sizeof(T)))) {}
+        ~AlignedBuffer() { AlignedFree(p); }
+
+        T* get() const { return p; }
+        T* release() { T* r = p; p = NULL; return r; }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // Limits -- range of a format of bits total bits, and the policy for the
+    // results which fall outside of it
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct Limits
+    {
+        IntType lo, hi;
+        int bits;
+        FractOverflowPolicy policy;
+
+        Limits(int bits_, FractOverflowPolicy policy_)
+            : bits(bits_), policy(policy_)
+        {
+            typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+            hi = IntType(~(UIntType(~UIntType(0)) << (bits-1)));
+            lo = ~hi;
+        }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // WideSum -- sum of signed integers which wraps around and keeps count of
+    // the carries out of the top bit. The exact sum fits iff the carries
+    // cancel out, so the overflow check does not depend on the order of the
+    // additions, and partial sums can be computed in any order and merged.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct WideSum
+    {
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+
+        UIntType acc;
+        int64_t carry;
+
+        WideSum() : acc(0), carry(0) {}
+
+        void add(IntType x)
+        {
+            UIntType s = acc + UIntType(x);
+            if (IntType((acc ^ s) & (UIntType(x) ^ s)) < 0)
+                carry += (x < 0) ? -1 : 1;
+            acc = s;
+        }
+
+        void add(const WideSum& w)
+        {
+            add(IntType(w.acc));
+            carry += w.carry;
+        }
+
+        bool overflow() const { return carry != 0; }
+
+        IntType value() const
+        {
+            OVERFLOW_IF(overflow());
+            return IntType(acc);
+        }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // Bins -- nbins bins of equal width (> 0), the first one starting at lo.
+    // The index of a value is its offset from lo divided by the width: a
+    // shift when the width is a power of two, and otherwise a product by a
+    // reciprocal of the width, computed once, which is off by at most one
+    // and then fixed up with the remainder.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct Bins
+    {
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+
+        IntType lo;
+        UIntType width;
+        UIntType last;              // largest offset from lo within the bins
+        uint64_t recip;             // floor(2^32 / width), for 8 and 32-bit formats
+        int nbins;
+        int shift;                  // log2(width), or -1 if not a power of two
+
+        Bins(IntType lo_, UIntType width_, int nbins_)
+            : lo(lo_), width(width_), recip(0), nbins(nbins_), shift(-1)
+        {
+            const UIntType umax = ~UIntType(0);
+            last = (width > umax / unsigned(nbins)) ? umax : UIntType(width * UIntType(nbins) - 1);
+            if ((width & (width - 1)) == 0)
+                while ((UIntType(1) << ++shift) != width) {}
+            else if (sizeof(UIntType) <= 4)
+                recip = (uint64_t(1) << 32) / width;
+        }
+
+        // Offset d from lo divided by the width (d <= last)
+        UIntType quotient(UIntType d) const
+        {
+            if (shift >= 0)
+                return d >> shift;
+            if (sizeof(UIntType) > 4)
+                return d / width;
+
+            // The error of the product is below d / 2^32 < 1
+            uint64_t q = (uint64_t(d) * recip) >> 32;
+            return UIntType(q + (uint64_t(d) - q * width >= width));
+        }
+
+        // Index of the bin of x, or nbins if x is outside of all of them
+        int index(IntType x) const
+        {
+            UIntType d = UIntType(x) - UIntType(lo);
+            return (x < lo || d > last) ? nbins : int(quotient(d));
+        }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // BatchScalar -- reference implementation of the batch kernels
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct BatchScalar
+    {
+        typedef typename AnyInt::DoubleType<IntType>::type DIntType;
+
+        // Accumulator for sums of up to 2^31 elements, which cannot overflow
+        typedef typename AnyInt::Bigger<DIntType, int64_t>::type SumType;
+
+        // Keep the low bits of x, sign-extended
+        static IntType wrap(DIntType x, int bits)
+        {
+            typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+            int s = bitsof(IntType) - bits;
+            return IntType(UIntType(UIntType(x) << s)) >> s;
+        }
+
+        // Narrow a result to the format, applying the overflow policy
+        static IntType fix(DIntType x, const Limits<IntType>& lim)
+        {
+            if (x >= lim.lo && x <= lim.hi)
+                return IntType(x);
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                return (x < lim.lo) ? lim.lo : lim.hi;
+            case FRACT_OVERFLOW_WRAP:
+                return wrap(x, lim.bits);
+            default:
+                OVERFLOW_IF(true);
+                return IntType(x);
+            }
+        }
+
+        // Round a double-width accumulator with 2*shift fractional bits back
+        // to shift fractional bits. The result must fit in ibits integer bits
+        // (same as constructing a Fract from it).
+        static IntType narrow(DIntType acc, int shift, int ibits)
+        {
+            OVERFLOW_IF(!AnyInt::FitIn(DIntType(acc >> (shift*2)), ibits));
+            return IntType(acc >> shift);
+        }
+
+        // Exact sum of three double-width products, which raises an overflow
+        // error if it does not fit DIntType (instead of wrapping around, which
+        // is undefined for signed integers)
+        static DIntType sum3(DIntType a, DIntType b, DIntType c)
+        {
+            WideSum<DIntType> s;
+            s.add(a);
+            s.add(b);
+            s.add(c);
+            return s.value();
+        }
+
+        // r[i] = a[i] + b[i]
+        static void add(IntType* r, const IntType* a, const IntType* b, int n)
+        {
+            for (int i=0;i<n;i++)
+            {
+                OVERFLOW_IF(AnyInt::AddOverflow(a[i], b[i]));
+                r[i] = a[i] + b[i];
+            }
+        }
+
+        // r[i] = a[i] * b[i]
+        static void mul(IntType* r, const IntType* a, const IntType* b, int shift, int n)
+        {
+            for (int i=0;i<n;i++)
+            {
+                OVERFLOW_IF(AnyInt::ScaledMulOverflow(a[i], b[i], shift));
+                r[i] = AnyInt::MulHS(a[i], b[i], shift);
+            }
+        }
+
+        // r[i] = a[i] * f
+        static void scale(IntType* r, const IntType* a, IntType f, int shift, int n)
+        {
+            for (int i=0;i<n;i++)
+            {
+                OVERFLOW_IF(AnyInt::ScaledMulOverflow(a[i], f, shift));
+                r[i] = AnyInt::MulHS(a[i], f, shift);
+            }
+        }
+
+        // Elementwise kernels with an overflow policy: r[i] = a[i] + b[i], a[i] - b[i],
+        // a[i] * b[i], a[i] * f
+        static void add(IntType* r, const IntType* a, const IntType* b, int n, const Limits<IntType>& lim)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = fix(DIntType(a[i]) + b[i], lim);
+        }
+
+        static void sub(IntType* r, const IntType* a, const IntType* b, int n, const Limits<IntType>& lim)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = fix(DIntType(a[i]) - b[i], lim);
+        }
+
+        static void mul(IntType* r, const IntType* a, const IntType* b, int shift, int n,
+                        const Limits<IntType>& lim)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = fix((DIntType(a[i]) * b[i]) >> shift, lim);
+        }
+
+        static void scale(IntType* r, const IntType* a, IntType f, int shift, int n,
+                          const Limits<IntType>& lim)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = fix((DIntType(a[i]) * f) >> shift, lim);
+        }
+
+        // r[i] = min(a[i], b[i]), max(a[i], b[i]), min(max(a[i], lo), hi)
+        static void min(IntType* r, const IntType* a, const IntType* b, int n)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = (b[i] < a[i]) ? b[i] : a[i];
+        }
+
+        static void max(IntType* r, const IntType* a, const IntType* b, int n)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = (a[i] < b[i]) ? b[i] : a[i];
+        }
+
+        static void clamp(IntType* r, const IntType* a, IntType lo, IntType hi, int n)
+        {
+            for (int i=0;i<n;i++)
+            {
+                IntType x = (a[i] < lo) ? lo : a[i];
+                r[i] = (hi < x) ? hi : x;
+            }
+        }
+
+        // Reductions: a[0] + ... + a[n-1], the smallest and the largest of a[i]
+        // (n >= 1), and the index of the first a[i] == x (or n if none).
+        static SumType sum(const IntType* a, int n)
+        {
+            SumType s = 0;
+            for (int i=0;i<n;i++)
+                s += a[i];
+            return s;
+        }
+
+        static IntType min(const IntType* a, int n)
+        {
+            IntType m = a[0];
+            for (int i=1;i<n;i++)
+                if (a[i] < m) m = a[i];
+            return m;
+        }
+
+        static IntType max(const IntType* a, int n)
+        {
+            IntType m = a[0];
+            for (int i=1;i<n;i++)
+                if (m < a[i]) m = a[i];
+            return m;
+        }
+
+        static int find(const IntType* a, IntType x, int n)
+        {
+            int i = 0;
+            while (i < n && a[i] != x)
+                i++;
+            return i;
+        }
+
+        // Prefix sums of a[i], starting from carry: r[i] = carry + a[0] + ... + a[i]
+        // (or up to a[i-1], if exclusive). Results are wrapped to bits, and the
+        // return value tells whether any of them did not fit.
+        template <class OutType>
+        static bool scan(OutType* r, const IntType* a, int n, SumType carry, int bits, bool exclusive)
+        {
+            typedef typename AnyInt::Unsigned<OutType>::type UOutType;
+            typedef typename AnyInt::Unsigned<SumType>::type USumType;
+            SumType hi = SumType(~(USumType(~USumType(0)) << (bits-1))), lo = ~hi;
+            int sh = bitsof(OutType) - bits;
+            bool ovf = false;
+
+            for (int i=0;i<n;i++)
+            {
+                SumType next = carry + a[i];
+                SumType v = exclusive ? carry : next;
+                ovf |= (v < lo || v > hi);
+                r[i] = OutType(UOutType(UOutType(v) << sh)) >> sh;
+                carry = next;
+            }
+            return ovf;
+        }
+
+        // Convert a[i] to a format with shift fewer fractional bits (or -shift
+        // more), like the Fract conversion constructor: dropped bits are
+        // truncated. Results which do not fit lim are saturated; return how
+        // many of them there were.
+        template <class OutType>
+        static int convert(OutType* r, const IntType* a, int n, int shift, const Limits<OutType>& lim)
+        {
+            typedef typename AnyInt::Bigger<IntType, OutType>::type WType;
+            enum { WBITS = bitsof(WType) };
+            WType lo = lim.lo, hi = lim.hi;
+            int count = 0;
+
+            if (shift >= 0)
+            {
+                int sh = (shift < WBITS-1) ? shift : WBITS-1;
+                for (int i=0;i<n;i++)
+                {
+                    WType y = WType(a[i]) >> sh;
+                    if (y < lo || y > hi)
+                    {
+                        y = (y < lo) ? lo : hi;
+                        count++;
+                    }
+                    r[i] = OutType(y);
+                }
+                return count;
+            }
+
+            // Range of the inputs that fit once shifted left
+            int sh = -shift;
+            WType ilo = 0, ihi = 0;
+            if (sh < WBITS-1)
+            {
+                ihi = hi >> sh;
+                ilo = lo >> sh;
+                if (WType(ilo << sh) != lo)
+                    ilo++;
+            }
+            for (int i=0;i<n;i++)
+            {
+                WType x = a[i];
+                if (x < ilo || x > ihi)
+                {
+                    r[i] = OutType((x < ilo) ? lo : hi);
+                    count++;
+                }
+                else
+                    r[i] = OutType(x << sh);
+            }
+            return count;
+        }
+
+        // Index of the bin of each a[i] (see Bins::index)
+        static void bin(int* idx, const IntType* a, int n, const Bins<IntType>& b)
+        {
+            for (int i=0;i<n;i++)
+                idx[i] = b.index(a[i]);
+        }
+
+        // sum += a[0]*b[0] + ... + a[n-1]*b[n-1], exactly
+        static void dot(WideSum<DIntType>& sum, const IntType* a, const IntType* b, int n)
+        {
+            for (int i=0;i<n;i++)
+                sum.add(DIntType(a[i]) * b[i]);
+        }
+
+        // FIR filter: r[j*rstride] = h[0]*x[j*xstep] + ... + h[ntaps-1]*x[j*xstep + ntaps-1],
+        // summed exactly and rounded once to shift fewer fractional bits. The taps
+        // must be small enough for the sums to fit DIntType (see FirCheckGain).
+        static void fir(IntType* r, int rstride, const IntType* x, int xstep,
+                        const IntType* h, int ntaps, int n, int shift, const Limits<IntType>& lim)
+        {
+            for (int j=0;j<n;j++)
+            {
+                DIntType acc = 0;
+                for (int k=0;k<ntaps;k++)
+                    acc += DIntType(h[k]) * x[j*xstep + k];
+                r[j*rstride] = fix(acc >> shift, lim);
+            }
+        }
+
+        // r[i] = ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i], rounded once
+        static void dot3(IntType* r,
+                         const IntType* ax, const IntType* ay, const IntType* az,
+                         const IntType* bx, const IntType* by, const IntType* bz,
+                         int shift, int ibits, int n)
+        {
+            for (int i=0;i<n;i++)
+                r[i] = narrow(sum3(DIntType(ax[i])*bx[i], DIntType(ay[i])*by[i], DIntType(az[i])*bz[i]),
+                              shift, ibits);
+        }
+
+        // Normalize the vectors (x[i],y[i],z[i]) in place, like Vector::dir():
+        // the squared modulus is rounded to shift fractional bits, and vectors
+        // where it rounds to zero become null. Components are strided by stride
+        // elements (eg: 3 for an array of Vector3D).
+        static void normalize3(IntType* x, IntType* y, IntType* z, int stride,
+                               int shift, int ibits, int n)
+        {
+            typedef RSqrt<typename AnyInt::Bigger<IntType, int32_t>::type> RS;
+
+            for (int i=0;i<n;i++, x+=stride, y+=stride, z+=stride)
+            {
+                IntType m2 = narrow(sum3(DIntType(*x) * *x, DIntType(*y) * *y, DIntType(*z) * *z),
+                                    shift, ibits);
+                int frac;
+                typename RS::UIntType inv = RS::eval0(m2, shift, frac);
+                *x = scale_wide(*x, inv, frac, shift, ibits);
+                *y = scale_wide(*y, inv, frac, shift, ibits);
+                *z = scale_wide(*z, inv, frac, shift, ibits);
+            }
+        }
+
+        // c * (y * 2^-frac), where y is the wide result of RSqrt
+        template <class UIntType>
+        static IntType scale_wide(IntType c, UIntType y, int frac, int shift, int ibits)
+        {
+            typedef typename AnyInt::DoubleType<typename AnyInt::Bigger<IntType, int32_t>::type>::type WDIntType;
+
+            WDIntType p = WDIntType(c) * y;
+            OVERFLOW_IF(!AnyInt::FitIn(WDIntType(p >> (shift + frac)), ibits));
+            return IntType(p >> frac);
+        }
+
+        // r[i] = m0*x[i] + m1*y[i] + m2*z[i] (rounded once) + t
+        static void affine3(IntType* r,
+                            const IntType* x, const IntType* y, const IntType* z,
+                            IntType m0, IntType m1, IntType m2, IntType t,
+                            int shift, int ibits, int n)
+        {
+            for (int i=0;i<n;i++)
+            {
+                IntType p = narrow(sum3(DIntType(m0)*x[i], DIntType(m1)*y[i], DIntType(m2)*z[i]),
+                                   shift, ibits);
+                OVERFLOW_IF(AnyInt::AddOverflow(p, t));
+                r[i] = p + t;
+            }
+        }
+    };
+
+    template <class IntType>
+    struct Batch : public BatchScalar<IntType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    namespace avx2
+    {
+        inline __m256i load(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+        inline void store(int32_t* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+        inline bool any(__m256i m) { return !_mm256_testz_si256(m, m); }
+
+        // 64-bit products of the even and of the odd 32-bit lanes
+        inline __m256i mul_even(__m256i a, __m256i b)
+        { return _mm256_mul_epi32(a, b); }
+        inline __m256i mul_odd(__m256i a, __m256i b)
+        { return _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32)); }
+
+        // Lanes where the sum s = a+b has overflown
+        inline __m256i add_overflow(__m256i a, __m256i b, __m256i s)
+        { return _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s)), 31); }
+
+        // Pack the low halves of the 64-bit lanes of pe (even) and po (odd)
+        // back into eight 32-bit lanes
+        inline __m256i pack(__m256i pe, __m256i po)
+        { return _mm256_blend_epi32(pe, _mm256_slli_epi64(po, 32), 0xAA); }
+
+        // Low 32 bits of (a*b) >> shift, for unsigned a,b and shift <= 32
+        inline __m256i mul_shift_u(__m256i a, __m256i b, int shift)
+        {
+            __m128i sh = _mm_cvtsi32_si128(shift);
+            return pack(_mm256_srl_epi64(_mm256_mul_epu32(a, b), sh),
+                        _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32)), sh));
+        }
+
+        // Arithmetic right shift of 64-bit lanes by per-lane amounts
+        inline __m256i srav64(__m256i p, __m256i n)
+        {
+            __m256i s = _mm256_cmpgt_epi64(_mm256_setzero_si256(), p);
+            return _mm256_xor_si256(_mm256_srlv_epi64(_mm256_xor_si256(p, s), n), s);
+        }
+
+        // Count leading zeros of positive 32-bit lanes. Only the highest bit
+        // of each pair of adjacent ones is kept, so that the conversion to
+        // float can never round up to the next power of two.
+        inline __m256i clz_pos(__m256i x)
+        {
+            __m256i xb = _mm256_andnot_si256(_mm256_srli_epi32(x, 1), x);
+            __m256i k = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(xb)), 23),
+                                         _mm256_set1_epi32(127));
+            return _mm256_sub_epi32(_mm256_set1_epi32(31), k);
+        }
+
+        // acc += p on 64-bit lanes, counting the carries like WideSum
+        inline void add_carry64(__m256i& acc, __m256i& carry, __m256i p)
+        {
+            __m256i zero = _mm256_setzero_si256();
+            __m256i s = _mm256_add_epi64(acc, p);
+            __m256i ovf = _mm256_cmpgt_epi64(zero, _mm256_and_si256(_mm256_xor_si256(acc, s), _mm256_xor_si256(p, s)));
+            __m256i dir = _mm256_or_si256(_mm256_cmpgt_epi64(zero, p), _mm256_set1_epi64x(1));
+            carry = _mm256_add_epi64(carry, _mm256_and_si256(ovf, dir));
+            acc = s;
+        }
+
+        // a + b + c on 64-bit lanes; the lanes where the exact sum does not fit
+        // 64 bits are set in ovf (a wrapped sum can look in range)
+        inline __m256i add3_64(__m256i a, __m256i b, __m256i c, __m256i& ovf)
+        {
+            __m256i carry = _mm256_setzero_si256();
+            add_carry64(a, carry, b);
+            add_carry64(a, carry, c);
+            ovf = _mm256_or_si256(ovf, _mm256_andnot_si256(_mm256_cmpeq_epi64(carry, _mm256_setzero_si256()),
+                                                           _mm256_set1_epi64x(-1)));
+            return a;
+        }
+
+        // Merge the lanes of acc and carry into sum
+        inline void merge64(WideSum<int64_t>& sum, __m256i acc, __m256i carry)
+        {
+            int64_t a[4], c[4];
+            _mm256_storeu_si256((__m256i*)a, acc);
+            _mm256_storeu_si256((__m256i*)c, carry);
+            for (int k=0;k<4;k++)
+            {
+                sum.add(a[k]);
+                sum.carry += c[k];
+            }
+        }
+
+        // Inclusive prefix sums of the four 64-bit lanes of x
+        inline __m256i scan4_64(__m256i x)
+        {
+            __m256i zero = _mm256_setzero_si256();
+            x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(2,1,0,0)), zero, 0x03));
+            x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_permute4x64_epi64(x, _MM_SHUFFLE(1,0,0,0)), zero, 0x0F));
+            return x;
+        }
+
+        // Range of the 64-bit products that survive a shift into 32 bits
+        struct Range
+        {
+            __m256i lo, hi;
+            __m128i shr, shl;
+
+            // Products must fit into nbits (before shifting right by shift)
+            Range(int nbits, int shift)
+            {
+                lo = _mm256_set1_epi64x(-((long long)1 << (nbits-1)));
+                hi = _mm256_set1_epi64x(((long long)1 << (nbits-1)) - 1);
+                shr = _mm_cvtsi32_si128(shift);
+                shl = _mm_cvtsi32_si128(32 - shift);
+            }
+
+            __m256i out(__m256i p) const
+            { return _mm256_or_si256(_mm256_cmpgt_epi64(p, hi), _mm256_cmpgt_epi64(lo, p)); }
+
+            // Shift even and odd 64-bit products and pack them back into
+            // eight 32-bit lanes. Only the low 32 bits of each shifted
+            // product are kept, so a logical shift is as good as an
+            // arithmetic one (which AVX2 lacks for 64-bit lanes).
+            __m256i narrow(__m256i pe, __m256i po, __m256i& ovf) const
+            {
+                ovf = _mm256_or_si256(ovf, _mm256_or_si256(out(pe), out(po)));
+                return _mm256_blend_epi32(_mm256_srl_epi64(pe, shr), _mm256_sll_epi64(po, shl), 0xAA);
+            }
+        };
+
+        // Eight int32 lanes from int8 or int32, and back. Stores to int8 go
+        // through packssdw/packsswb, so the lanes must already fit.
+        inline __m256i load8(const int32_t* p) { return load(p); }
+        inline __m256i load8(const int8_t* p)
+        { return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)p)); }
+
+        inline void store8(int32_t* p, __m256i v) { store(p, v); }
+        inline void store8(int8_t* p, __m256i v)
+        {
+            __m256i w = _mm256_packs_epi32(v, v);
+            w = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(w, w), _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4));
+            _mm_storel_epi64((__m128i*)p, _mm256_castsi256_si128(w));
+        }
+
+        // BatchScalar::convert() between int8 and int32, eight lanes at a time
+        template <class InType, class OutType>
+        int convert(OutType* r, const InType* a, int n, int shift, const Limits<OutType>& lim)
+        {
+            __m256i lo = _mm256_set1_epi32(lim.lo), hi = _mm256_set1_epi32(lim.hi);
+            int sh = (shift < 0) ? -shift : shift;
+            __m128i vsh = _mm_cvtsi32_si128(sh < 31 ? sh : 31);
+            __m256i ilo = lo, ihi = hi;
+            if (shift < 0)
+            {
+                int32_t l = 0, h = 0;
+                if (sh < 31)
+                {
+                    h = lim.hi >> sh;
+                    l = lim.lo >> sh;
+                    if (int32_t(l << sh) != lim.lo)
+                        l++;
+                }
+                ilo = _mm256_set1_epi32(l);
+                ihi = _mm256_set1_epi32(h);
+            }
+
+            int count = 0, i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i x = load8(a+i), y, under, over;
+                if (shift < 0)
+                {
+                    under = _mm256_cmpgt_epi32(ilo, x);
+                    over = _mm256_cmpgt_epi32(x, ihi);
+                    y = _mm256_blendv_epi8(_mm256_sll_epi32(x, vsh), lo, under);
+                    y = _mm256_blendv_epi8(y, hi, over);
+                }
+                else
+                {
+                    y = _mm256_sra_epi32(x, vsh);
+                    under = _mm256_cmpgt_epi32(lo, y);
+                    over = _mm256_cmpgt_epi32(y, hi);
+                    y = _mm256_min_epi32(_mm256_max_epi32(y, lo), hi);
+                }
+                count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(under, over))));
+                store8(r+i, y);
+            }
+            return count + BatchScalar<InType>::convert(r+i, a+i, n-i, shift, lim);
+        }
+    }
+
+    template <>
+    struct Batch<int8_t> : public BatchScalar<int8_t>
+    {
+        typedef BatchScalar<int8_t> Scalar;
+
+        static int convert(int8_t* r, const int8_t* a, int n, int shift, const Limits<int8_t>& lim)
+        { return avx2::convert(r, a, n, shift, lim); }
+
+        static int convert(int32_t* r, const int8_t* a, int n, int shift, const Limits<int32_t>& lim)
+        { return avx2::convert(r, a, n, shift, lim); }
+
+        static int convert(int64_t* r, const int8_t* a, int n, int shift, const Limits<int64_t>& lim)
+        { return Scalar::convert(r, a, n, shift, lim); }
+    };
+
+    template <>
+    struct Batch<int32_t> : public BatchScalar<int32_t>
+    {
+        typedef BatchScalar<int32_t> Scalar;
+
+        static void add(int32_t* r, const int32_t* a, const int32_t* b, int n)
+        {
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i), vb = avx2::load(b+i);
+                __m256i s = _mm256_add_epi32(va, vb);
+                OVERFLOW_IF(avx2::any(avx2::add_overflow(va, vb, s)));
+                avx2::store(r+i, s);
+            }
+            Scalar::add(r+i, a+i, b+i, n-i);
+        }
+
+        static void mul(int32_t* r, const int32_t* a, const int32_t* b, int shift, int n)
+        {
+            avx2::Range rng(32 + shift, shift);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i), vb = avx2::load(b+i);
+                __m256i ovf = _mm256_setzero_si256();
+                __m256i res = rng.narrow(avx2::mul_even(va, vb), avx2::mul_odd(va, vb), ovf);
+                OVERFLOW_IF(avx2::any(ovf));
+                avx2::store(r+i, res);
+            }
+            Scalar::mul(r+i, a+i, b+i, shift, n-i);
+        }
+
+        static void scale(int32_t* r, const int32_t* a, int32_t f, int shift, int n)
+        {
+            avx2::Range rng(32 + shift, shift);
+            __m256i vf = _mm256_set1_epi32(f);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i);
+                __m256i ovf = _mm256_setzero_si256();
+                __m256i res = rng.narrow(avx2::mul_even(va, vf), avx2::mul_odd(va, vf), ovf);
+                OVERFLOW_IF(avx2::any(ovf));
+                avx2::store(r+i, res);
+            }
+            Scalar::scale(r+i, a+i, f, shift, n-i);
+        }
+
+        static int64_t sum(const int32_t* a, int n)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i v = avx2::load(a+i);
+                acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+                acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+            }
+            int64_t l[4];
+            _mm256_storeu_si256((__m256i*)l, acc);
+            return l[0] + l[1] + l[2] + l[3] + Scalar::sum(a+i, n-i);
+        }
+
+        static int32_t min(const int32_t* a, int n)
+        {
+            if (n < 8)
+                return Scalar::min(a, n);
+            __m256i m = avx2::load(a);
+            int i = 8;
+            for (;i+8<=n;i+=8)
+                m = _mm256_min_epi32(m, avx2::load(a+i));
+            int32_t l[8];
+            avx2::store(l, m);
+            int32_t r = Scalar::min(l, 8);
+            if (i < n)
+            {
+                int32_t t = Scalar::min(a+i, n-i);
+                if (t < r) r = t;
+            }
+            return r;
+        }
+
+        static int32_t max(const int32_t* a, int n)
+        {
+            if (n < 8)
+                return Scalar::max(a, n);
+            __m256i m = avx2::load(a);
+            int i = 8;
+            for (;i+8<=n;i+=8)
+                m = _mm256_max_epi32(m, avx2::load(a+i));
+            int32_t l[8];
+            avx2::store(l, m);
+            int32_t r = Scalar::max(l, 8);
+            if (i < n)
+            {
+                int32_t t = Scalar::max(a+i, n-i);
+                if (r < t) r = t;
+            }
+            return r;
+        }
+
+        static int find(const int32_t* a, int32_t x, int n)
+        {
+            __m256i vx = _mm256_set1_epi32(x);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                int m = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(avx2::load(a+i), vx)));
+                if (m)
+                    return i + __builtin_ctz(m);
+            }
+            return i + Scalar::find(a+i, x, n-i);
+        }
+
+        static bool scan(int32_t* r, const int32_t* a, int n, int64_t carry, int bits, bool exclusive)
+        {
+            return scan_avx2(r, a, n, carry, bits, exclusive);
+        }
+
+        static bool scan(int64_t* r, const int32_t* a, int n, int64_t carry, int bits, bool exclusive)
+        {
+            return scan_avx2(r, a, n, carry, bits, exclusive);
+        }
+
+        static int convert(int8_t* r, const int32_t* a, int n, int shift, const Limits<int8_t>& lim)
+        { return avx2::convert(r, a, n, shift, lim); }
+
+        static int convert(int32_t* r, const int32_t* a, int n, int shift, const Limits<int32_t>& lim)
+        { return avx2::convert(r, a, n, shift, lim); }
+
+        static int convert(int64_t* r, const int32_t* a, int n, int shift, const Limits<int64_t>& lim)
+        { return Scalar::convert(r, a, n, shift, lim); }
+
+        static void bin(int* idx, const int32_t* a, int n, const Bins<int32_t>& b)
+        {
+            const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+            const __m256i lo = _mm256_set1_epi32(b.lo), out = _mm256_set1_epi32(b.nbins);
+            const __m256i last = _mm256_set1_epi32(int32_t(b.last ^ 0x80000000u));
+            const __m256i w = _mm256_set1_epi32(int32_t(b.width)), wf = _mm256_xor_si256(w, flip);
+            const __m256i rc = _mm256_set1_epi32(int32_t(b.recip)), one = _mm256_set1_epi32(1);
+            const __m128i sh = _mm_cvtsi32_si128(b.shift);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i x = avx2::load(a+i), d = _mm256_sub_epi32(x, lo), q;
+                __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lo, x),
+                                                  _mm256_cmpgt_epi32(_mm256_xor_si256(d, flip), last));
+                if (b.shift >= 0)
+                    q = _mm256_srl_epi32(d, sh);
+                else
+                {
+                    // High halves of the unsigned products d*recip, then q += (d - q*w >= w);
+                    // the width is below 2^31, so the remainder fits 32 bits
+                    __m256i qe = _mm256_srli_epi64(_mm256_mul_epu32(d, rc), 32);
+                    __m256i qo = _mm256_mul_epu32(_mm256_srli_epi64(d, 32), rc);
+                    q = _mm256_blend_epi32(qe, qo, 0xAA);
+                    __m256i r = _mm256_sub_epi32(d, _mm256_mullo_epi32(q, w));
+                    q = _mm256_add_epi32(_mm256_add_epi32(q, one),
+                                         _mm256_cmpgt_epi32(wf, _mm256_xor_si256(r, flip)));
+                }
+                avx2::store(idx+i, _mm256_blendv_epi8(q, out, outside));
+            }
+            Scalar::bin(idx+i, a+i, n-i, b);
+        }
+
+        static void dot(WideSum<int64_t>& sum, const int32_t* a, const int32_t* b, int n)
+        {
+            __m256i acc = _mm256_setzero_si256(), carry = _mm256_setzero_si256();
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i), vb = avx2::load(b+i);
+                avx2::add_carry64(acc, carry, avx2::mul_even(va, vb));
+                avx2::add_carry64(acc, carry, avx2::mul_odd(va, vb));
+            }
+            avx2::merge64(sum, acc, carry);
+            Scalar::dot(sum, a+i, b+i, n-i);
+        }
+
+        static void fir(int32_t* r, int rstride, const int32_t* x, int xstep,
+                        const int32_t* h, int ntaps, int n, int shift, const Limits<int32_t>& lim)
+        {
+            __m256i sh = _mm256_set1_epi64x(shift);
+            int j = 0;
+
+            // Strided inputs (decimation): one output at a time, across the taps
+            if (xstep != 1)
+            {
+                for (;j<n;j++)
+                {
+                    WideSum<int64_t> s;
+                    dot(s, h, x + j*xstep, ntaps);
+                    r[j*rstride] = Scalar::fix(int64_t(s.acc) >> shift, lim);
+                }
+                return;
+            }
+
+            // Eight consecutive outputs at a time, with the taps broadcast
+            for (;j+8<=n;j+=8)
+            {
+                __m256i acce = _mm256_setzero_si256(), acco = _mm256_setzero_si256();
+                for (int k=0;k<ntaps;k++)
+                {
+                    __m256i vh = _mm256_set1_epi32(h[k]), vx = avx2::load(x+j+k);
+                    acce = _mm256_add_epi64(acce, avx2::mul_even(vx, vh));
+                    acco = _mm256_add_epi64(acco, avx2::mul_odd(vx, vh));
+                }
+                __m256i y = fix(avx2::srav64(acce, sh), avx2::srav64(acco, sh), lim);
+                if (rstride == 1)
+                    avx2::store(r+j, y);
+                else
+                {
+                    int32_t l[8];
+                    avx2::store(l, y);
+                    for (int i=0;i<8;i++)
+                        r[(j+i)*rstride] = l[i];
+                }
+            }
+            Scalar::fir(r + j*rstride, rstride, x + j, 1, h, ntaps, n-j, shift, lim);
+        }
+
+        static void dot3(int32_t* r,
+                         const int32_t* ax, const int32_t* ay, const int32_t* az,
+                         const int32_t* bx, const int32_t* by, const int32_t* bz,
+                         int shift, int ibits, int n)
+        {
+            avx2::Range rng(ibits + shift*2, shift);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i vax = avx2::load(ax+i), vay = avx2::load(ay+i), vaz = avx2::load(az+i);
+                __m256i vbx = avx2::load(bx+i), vby = avx2::load(by+i), vbz = avx2::load(bz+i);
+                __m256i ovf = _mm256_setzero_si256();
+                __m256i pe = avx2::add3_64(avx2::mul_even(vax, vbx), avx2::mul_even(vay, vby),
+                                           avx2::mul_even(vaz, vbz), ovf);
+                __m256i po = avx2::add3_64(avx2::mul_odd(vax, vbx), avx2::mul_odd(vay, vby),
+                                           avx2::mul_odd(vaz, vbz), ovf);
+                __m256i res = rng.narrow(pe, po, ovf);
+                OVERFLOW_IF(avx2::any(ovf));
+                avx2::store(r+i, res);
+            }
+            Scalar::dot3(r+i, ax+i, ay+i, az+i, bx+i, by+i, bz+i, shift, ibits, n-i);
+        }
+
+        // Vectorized RSqrt<int32_t>::eval0() (same steps, same results).
+        // Return y, and the per-lane frac in fracs.
+        static __m256i rsqrt0(__m256i x, int shift, __m256i& fracs)
+        {
+            typedef RSqrt<int32_t> RS;
+
+            __m256i zero = _mm256_cmpeq_epi32(x, _mm256_setzero_si256());
+            x = _mm256_or_si256(x, _mm256_srli_epi32(zero, 31));
+
+            __m256i s = avx2::clz_pos(x);
+            __m256i e = _mm256_sub_epi32(_mm256_set1_epi32(30 - shift), s);
+            __m256i odd = _mm256_and_si256(e, _mm256_set1_epi32(1));
+            s = _mm256_sub_epi32(s, odd);
+            e = _mm256_add_epi32(e, odd);
+            __m256i m = _mm256_sllv_epi32(x, s);
+
+            __m256i idx = _mm256_sub_epi32(_mm256_srli_epi32(m, 27), _mm256_set1_epi32(8));
+            __m256i y = _mm256_i32gather_epi32((const int*)RS::seed, idx, 4);
+            for (int i=0;i<RS::STEPS;i++)
+            {
+                __m256i y2 = avx2::mul_shift_u(y, y, 30);
+                __m256i my2 = avx2::mul_shift_u(m, y2, 30);
+                __m256i d = _mm256_sub_epi32(_mm256_set1_epi32(1 << 30), my2);
+                __m256i yd = avx2::pack(_mm256_srli_epi64(_mm256_mul_epi32(y, d), 31),
+                                        _mm256_srli_epi64(_mm256_mul_epi32(_mm256_srli_epi64(y, 32),
+                                                                           _mm256_srli_epi64(d, 32)), 31));
+                y = _mm256_add_epi32(y, yd);
+            }
+
+            fracs = _mm256_add_epi32(_mm256_set1_epi32(30), _mm256_srai_epi32(e, 1));
+            return _mm256_andnot_si256(zero, y);
+        }
+
+        // Vectorized BatchScalar::scale_wide()
+        static __m256i scale_wide(__m256i c, __m256i y, __m256i fracs, int shift, int ibits, __m256i& ovf)
+        {
+            __m256i lo = _mm256_set1_epi64x(-((long long)1 << (ibits-1)));
+            __m256i hi = _mm256_set1_epi64x(((long long)1 << (ibits-1)) - 1);
+            __m256i vshift = _mm256_set1_epi64x(shift);
+
+            __m256i fe = _mm256_and_si256(fracs, _mm256_set1_epi64x(0xFFFFFFFF));
+            __m256i fo = _mm256_srli_epi64(fracs, 32);
+            __m256i pe = _mm256_mul_epi32(c, y);
+            __m256i po = _mm256_mul_epi32(_mm256_srli_epi64(c, 32), _mm256_srli_epi64(y, 32));
+
+            __m256i qe = avx2::srav64(pe, _mm256_add_epi64(fe, vshift));
+            __m256i qo = avx2::srav64(po, _mm256_add_epi64(fo, vshift));
+            ovf = _mm256_or_si256(ovf, _mm256_or_si256(_mm256_cmpgt_epi64(qe, hi), _mm256_cmpgt_epi64(lo, qe)));
+            ovf = _mm256_or_si256(ovf, _mm256_or_si256(_mm256_cmpgt_epi64(qo, hi), _mm256_cmpgt_epi64(lo, qo)));
+
+            return avx2::pack(avx2::srav64(pe, fe), avx2::srav64(po, fo));
+        }
+
+        static void normalize3(int32_t* x, int32_t* y, int32_t* z, int stride,
+                               int shift, int ibits, int n)
+        {
+            avx2::Range rng(ibits + shift*2, shift);
+            __m256i vidx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                              _mm256_set1_epi32(stride));
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                int32_t* p[3] = { x + i*stride, y + i*stride, z + i*stride };
+                __m256i c[3];
+                for (int k=0;k<3;k++)
+                    c[k] = (stride == 1) ? avx2::load(p[k]) : _mm256_i32gather_epi32((const int*)p[k], vidx, 4);
+
+                __m256i ovf = _mm256_setzero_si256();
+                __m256i pe = avx2::add3_64(avx2::mul_even(c[0], c[0]), avx2::mul_even(c[1], c[1]),
+                                           avx2::mul_even(c[2], c[2]), ovf);
+                __m256i po = avx2::add3_64(avx2::mul_odd(c[0], c[0]), avx2::mul_odd(c[1], c[1]),
+                                           avx2::mul_odd(c[2], c[2]), ovf);
+                __m256i m2 = rng.narrow(pe, po, ovf);
+                OVERFLOW_IF(avx2::any(ovf));
+
+                __m256i fracs;
+                __m256i inv = rsqrt0(m2, shift, fracs);
+                for (int k=0;k<3;k++)
+                    c[k] = scale_wide(c[k], inv, fracs, shift, ibits, ovf);
+                OVERFLOW_IF(avx2::any(ovf));
+
+                for (int k=0;k<3;k++)
+                {
+                    if (stride == 1)
+                        avx2::store(p[k], c[k]);
+                    else
+                    {
+                        int32_t tmp[8];
+                        avx2::store(tmp, c[k]);
+                        for (int j=0;j<8;j++)
+                            p[k][j*stride] = tmp[j];
+                    }
+                }
+            }
+            Scalar::normalize3(x + i*stride, y + i*stride, z + i*stride, stride, shift, ibits, n-i);
+        }
+
+        // Vectorized Scalar::fix() for 32-bit results s; ovf marks the lanes where
+        // the exact result did not even fit 32 bits, and neg the lanes where it
+        // was negative.
+        static __m256i fix(__m256i s, __m256i ovf, __m256i neg, const Limits<int32_t>& lim)
+        {
+            __m256i lo = _mm256_set1_epi32(lim.lo), hi = _mm256_set1_epi32(lim.hi);
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                s = _mm256_min_epi32(_mm256_max_epi32(s, lo), hi);
+                return _mm256_blendv_epi8(s, _mm256_blendv_epi8(hi, lo, neg), ovf);
+            case FRACT_OVERFLOW_WRAP:
+                {
+                    __m128i sh = _mm_cvtsi32_si128(32 - lim.bits);
+                    return _mm256_sra_epi32(_mm256_sll_epi32(s, sh), sh);
+                }
+            default:
+                ovf = _mm256_or_si256(ovf, _mm256_or_si256(_mm256_cmpgt_epi32(lo, s), _mm256_cmpgt_epi32(s, hi)));
+                OVERFLOW_IF(avx2::any(ovf));
+                return s;
+            }
+        }
+
+        // Vectorized Scalar::fix() for 64-bit results (even and odd lanes)
+        static __m256i fix(__m256i pe, __m256i po, const Limits<int32_t>& lim)
+        {
+            __m256i lo = _mm256_set1_epi64x(lim.lo), hi = _mm256_set1_epi64x(lim.hi);
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                pe = _mm256_blendv_epi8(pe, lo, _mm256_cmpgt_epi64(lo, pe));
+                pe = _mm256_blendv_epi8(pe, hi, _mm256_cmpgt_epi64(pe, hi));
+                po = _mm256_blendv_epi8(po, lo, _mm256_cmpgt_epi64(lo, po));
+                po = _mm256_blendv_epi8(po, hi, _mm256_cmpgt_epi64(po, hi));
+                return avx2::pack(pe, po);
+            case FRACT_OVERFLOW_WRAP:
+                {
+                    __m128i sh = _mm_cvtsi32_si128(32 - lim.bits);
+                    return _mm256_sra_epi32(_mm256_sll_epi32(avx2::pack(pe, po), sh), sh);
+                }
+            default:
+                __m256i ovf = _mm256_or_si256(_mm256_or_si256(_mm256_cmpgt_epi64(lo, pe), _mm256_cmpgt_epi64(pe, hi)),
+                                              _mm256_or_si256(_mm256_cmpgt_epi64(lo, po), _mm256_cmpgt_epi64(po, hi)));
+                OVERFLOW_IF(avx2::any(ovf));
+                return avx2::pack(pe, po);
+            }
+        }
+
+        static void add(int32_t* r, const int32_t* a, const int32_t* b, int n, const Limits<int32_t>& lim)
+        {
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i), vb = avx2::load(b+i);
+                __m256i s = _mm256_add_epi32(va, vb);
+                avx2::store(r+i, fix(s, avx2::add_overflow(va, vb, s), _mm256_srai_epi32(va, 31), lim));
+            }
+            Scalar::add(r+i, a+i, b+i, n-i, lim);
+        }
+
+        static void sub(int32_t* r, const int32_t* a, const int32_t* b, int n, const Limits<int32_t>& lim)
+        {
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i), vb = avx2::load(b+i);
+                __m256i d = _mm256_sub_epi32(va, vb);
+                __m256i ovf = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(va, vb), _mm256_xor_si256(va, d)), 31);
+                avx2::store(r+i, fix(d, ovf, _mm256_srai_epi32(va, 31), lim));
+            }
+            Scalar::sub(r+i, a+i, b+i, n-i, lim);
+        }
+
+        static void mul(int32_t* r, const int32_t* a, const int32_t* b, int shift, int n,
+                        const Limits<int32_t>& lim)
+        {
+            __m256i sh = _mm256_set1_epi64x(shift);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i), vb = avx2::load(b+i);
+                avx2::store(r+i, fix(avx2::srav64(avx2::mul_even(va, vb), sh),
+                                     avx2::srav64(avx2::mul_odd(va, vb), sh), lim));
+            }
+            Scalar::mul(r+i, a+i, b+i, shift, n-i, lim);
+        }
+
+        static void scale(int32_t* r, const int32_t* a, int32_t f, int shift, int n,
+                          const Limits<int32_t>& lim)
+        {
+            __m256i sh = _mm256_set1_epi64x(shift), vf = _mm256_set1_epi32(f);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i va = avx2::load(a+i);
+                avx2::store(r+i, fix(avx2::srav64(avx2::mul_even(va, vf), sh),
+                                     avx2::srav64(avx2::mul_odd(va, vf), sh), lim));
+            }
+            Scalar::scale(r+i, a+i, f, shift, n-i, lim);
+        }
+
+        static void min(int32_t* r, const int32_t* a, const int32_t* b, int n)
+        {
+            int i = 0;
+            for (;i+8<=n;i+=8)
+                avx2::store(r+i, _mm256_min_epi32(avx2::load(a+i), avx2::load(b+i)));
+            Scalar::min(r+i, a+i, b+i, n-i);
+        }
+
+        static void max(int32_t* r, const int32_t* a, const int32_t* b, int n)
+        {
+            int i = 0;
+            for (;i+8<=n;i+=8)
+                avx2::store(r+i, _mm256_max_epi32(avx2::load(a+i), avx2::load(b+i)));
+            Scalar::max(r+i, a+i, b+i, n-i);
+        }
+
+        static void clamp(int32_t* r, const int32_t* a, int32_t lo, int32_t hi, int n)
+        {
+            __m256i vlo = _mm256_set1_epi32(lo), vhi = _mm256_set1_epi32(hi);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+                avx2::store(r+i, _mm256_min_epi32(_mm256_max_epi32(avx2::load(a+i), vlo), vhi));
+            Scalar::clamp(r+i, a+i, lo, hi, n-i);
+        }
+
+        // Store the prefix sums lo (lanes 0-3) and hi (lanes 4-7), wrapped to bits
+        static void store_scan(int32_t* r, __m256i lo, __m256i hi, int bits)
+        {
+            __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+            __m256i v = _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(lo, idx),
+                                                  _mm256_permutevar8x32_epi32(hi, idx), 0x20);
+            __m128i sh = _mm_cvtsi32_si128(32 - bits);
+            avx2::store(r, _mm256_sra_epi32(_mm256_sll_epi32(v, sh), sh));
+        }
+
+        static void store_scan(int64_t* r, __m256i lo, __m256i hi, int bits)
+        {
+            if (bits < 64)
+            {
+                __m128i sh = _mm_cvtsi32_si128(64 - bits);
+                __m256i vsh = _mm256_set1_epi64x(64 - bits);
+                lo = avx2::srav64(_mm256_sll_epi64(lo, sh), vsh);
+                hi = avx2::srav64(_mm256_sll_epi64(hi, sh), vsh);
+            }
+            _mm256_storeu_si256((__m256i*)r, lo);
+            _mm256_storeu_si256((__m256i*)(r + 4), hi);
+        }
+
+        // Scan eight elements at a time: each group is widened to 64 bits and
+        // scanned in registers, then the running total is added to it.
+        template <class OutType>
+        static bool scan_avx2(OutType* r, const int32_t* a, int n, int64_t carry, int bits, bool exclusive)
+        {
+            int64_t hi = int64_t(~(~uint64_t(0) << (bits-1))), lo = ~hi;
+            __m256i vlo = _mm256_set1_epi64x(lo), vhi = _mm256_set1_epi64x(hi);
+            __m256i vc = _mm256_set1_epi64x(carry);
+            __m256i ovf = _mm256_setzero_si256();
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i v = avx2::load(a+i);
+                __m256i al = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v));
+                __m256i ah = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1));
+                __m256i sl = _mm256_add_epi64(avx2::scan4_64(al), vc);
+                __m256i sh = _mm256_add_epi64(avx2::scan4_64(ah), _mm256_permute4x64_epi64(sl, 0xFF));
+                vc = _mm256_permute4x64_epi64(sh, 0xFF);
+                if (exclusive)
+                {
+                    sl = _mm256_sub_epi64(sl, al);
+                    sh = _mm256_sub_epi64(sh, ah);
+                }
+                ovf = _mm256_or_si256(ovf, _mm256_or_si256(_mm256_cmpgt_epi64(vlo, sl), _mm256_cmpgt_epi64(sl, vhi)));
+                ovf = _mm256_or_si256(ovf, _mm256_or_si256(_mm256_cmpgt_epi64(vlo, sh), _mm256_cmpgt_epi64(sh, vhi)));
+                store_scan(r+i, sl, sh, bits);
+            }
+            carry = _mm256_extract_epi64(vc, 0);
+            return Scalar::scan(r+i, a+i, n-i, carry, bits, exclusive) | avx2::any(ovf);
+        }
+
+        static void affine3(int32_t* r,
+                            const int32_t* x, const int32_t* y, const int32_t* z,
+                            int32_t m0, int32_t m1, int32_t m2, int32_t t,
+                            int shift, int ibits, int n)
+        {
+            avx2::Range rng(ibits + shift*2, shift);
+            __m256i vm0 = _mm256_set1_epi32(m0), vm1 = _mm256_set1_epi32(m1), vm2 = _mm256_set1_epi32(m2);
+            __m256i vt = _mm256_set1_epi32(t);
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i vx = avx2::load(x+i), vy = avx2::load(y+i), vz = avx2::load(z+i);
+                __m256i ovf = _mm256_setzero_si256();
+                __m256i pe = avx2::add3_64(avx2::mul_even(vx, vm0), avx2::mul_even(vy, vm1),
+                                           avx2::mul_even(vz, vm2), ovf);
+                __m256i po = avx2::add3_64(avx2::mul_odd(vx, vm0), avx2::mul_odd(vy, vm1),
+                                           avx2::mul_odd(vz, vm2), ovf);
+                __m256i p = rng.narrow(pe, po, ovf);
+                __m256i s = _mm256_add_epi32(p, vt);
+                ovf = _mm256_or_si256(ovf, avx2::add_overflow(p, vt, s));
+                OVERFLOW_IF(avx2::any(ovf));
+                avx2::store(r+i, s);
+            }
+            Scalar::affine3(r+i, x+i, y+i, z+i, m0, m1, m2, t, shift, ibits, n-i);
+        }
+    };
+#endif
+}
+
+#endif // SIMD_H
@@ -31,7 +31,12 @@
 #ifdef __x86_64__
     #define FRACT_HAS_128BITS
     typedef __uint128_t uint128_t;
-    typedef __int128_t long int128_t;
+    typedef __int128_t int128_t;
+#endif
+
+// Use AVX2 batch kernels when the compiler targets it (eg: -mavx2)
+#ifdef __AVX2__
+    #define FRACT_HAS_AVX2
 #endif
 
 // Avoid using any division
@@ -0,0 +1,268 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains exact geometric predicates on fixed-point coordinates.
+ *
+ * Since fixed-point coordinates are integers, the classic orientation and in-circle
+ * determinants can be evaluated exactly with wider integers. Each predicate first
+ * checks the magnitude of the coordinate differences, and uses the narrowest integer
+ * type which is guaranteed not to overflow (64 bits in the common case).
+ *
+ * The sign conventions are the same as Shewchuk's robust predicates.
+ */
+
+#ifndef FIXEDPRED_H
+#define FIXEDPRED_H
+
+#include "fixedgeom.h"
+#include <algorithm>
+#include <vector>
+
+#ifndef FRACT_HAS_128BITS
+    #error "fixedpred.h requires 128-bit integers"
+#endif
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // Int256 -- signed 256-bit integer (two's complement), just enough to sum
+    // a few products of 128-bit integers.
+    /////////////////////////////////////////////////////////////////////////
+    struct Int256
+    {
+        uint128_t lo, hi;
+
+        static Int256 mul(int128_t a, int128_t b)
+        {
+            uint128_t ua = (a < 0) ? -uint128_t(a) : uint128_t(a);
+            uint128_t ub = (b < 0) ? -uint128_t(b) : uint128_t(b);
+            uint64_t a0 = uint64_t(ua), a1 = uint64_t(ua >> 64);
+            uint64_t b0 = uint64_t(ub), b1 = uint64_t(ub >> 64);
+
+            uint128_t p00 = uint128_t(a0) * b0, p01 = uint128_t(a0) * b1;
+            uint128_t p10 = uint128_t(a1) * b0, p11 = uint128_t(a1) * b1;
+            uint128_t mid = (p00 >> 64) + uint64_t(p01) + uint64_t(p10);
+
+            Int256 r;
+            r.lo = (mid << 64) | uint64_t(p00);
+            r.hi = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+            return ((a < 0) != (b < 0)) ? -r : r;
+        }
+
+        Int256 operator-() const
+        {
+            Int256 r;
+            r.lo = ~lo + 1;
+            r.hi = ~hi + (r.lo == 0);
+            return r;
+        }
+
+        Int256 operator+(const Int256& b) const
+        {
+            Int256 r;
+            r.lo = lo + b.lo;
+            r.hi = hi + b.hi + (r.lo < lo);
+            return r;
+        }
+
+        int sign() const
+        {
+            if (hi >> 127)
+                return -1;
+            return (hi | lo) != 0;
+        }
+    };
+
+    template <class T>
+    inline int Sign(T x) { return (x > 0) - (x < 0); }
+
+    // Differences of the raw coordinates (exact, since coordinates are at most 32 bits)
+    template <int N, int I, int F>
+    inline uint64_t RawDiff(int64_t* d, const Vector<N,I,F>& a, const Vector<N,I,F>& b)
+    {
+        STATIC_ASSERT(I+F <= 32, "Exact predicates support coordinates up to 32 bits");
+        uint64_t m = 0;
+        for (int k=0;k<N;k++)
+        {
+            d[k] = int64_t(FractAccess::raw(a[k])) - FractAccess::raw(b[k]);
+            m |= (d[k] < 0) ? -uint64_t(d[k]) : uint64_t(d[k]);
+        }
+        return m;
+    }
+
+    template <class T>
+    inline T Orient2(const int64_t* a, const int64_t* b)
+    {
+        return T(a[0]) * b[1] - T(a[1]) * b[0];
+    }
+
+    template <class T>
+    inline T Orient3(const int64_t* a, const int64_t* b, const int64_t* c)
+    {
+        return a[0] * (T(b[1]) * c[2] - T(b[2]) * c[1]) +
+               b[0] * (T(c[1]) * a[2] - T(c[2]) * a[1]) +
+               c[0] * (T(a[1]) * b[2] - T(a[2]) * b[1]);
+    }
+
+    template <class T>
+    inline T InCircle(const int64_t* a, const int64_t* b, const int64_t* c)
+    {
+        T alift = T(a[0]) * a[0] + T(a[1]) * a[1];
+        T blift = T(b[0]) * b[0] + T(b[1]) * b[1];
+        T clift = T(c[0]) * c[0] + T(c[1]) * c[1];
+        return alift * Orient2<T>(b, c) + blift * Orient2<T>(c, a) + clift * Orient2<T>(a, b);
+    }
+
+    // Lifts and minors are below 2^65, so their products need more than 128 bits
+    inline int InCircleSign256(const int64_t* a, const int64_t* b, const int64_t* c)
+    {
+        int128_t alift = int128_t(a[0]) * a[0] + int128_t(a[1]) * a[1];
+        int128_t blift = int128_t(b[0]) * b[0] + int128_t(b[1]) * b[1];
+        int128_t clift = int128_t(c[0]) * c[0] + int128_t(c[1]) * c[1];
+        return (Int256::mul(alift, Orient2<int128_t>(b, c)) +
+                Int256::mul(blift, Orient2<int128_t>(c, a)) +
+                Int256::mul(clift, Orient2<int128_t>(a, b))).sign();
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// orient2d -- return +1 if a, b, c are in counterclockwise order, -1 if they are in
+// clockwise order, and 0 if they are collinear.
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+int orient2d(const Vector<2,I,F>& a, const Vector<2,I,F>& b, const Vector<2,I,F>& c)
+{
+    int64_t ac[2], bc[2];
+    uint64_t m = detail::RawDiff(ac, a, c) | detail::RawDiff(bc, b, c);
+
+    // Differences below 2^31: the products fit in 62 bits
+    if (!(m >> 31))
+        return detail::Sign(detail::Orient2<int64_t>(ac, bc));
+    return detail::Sign(detail::Orient2<int128_t>(ac, bc));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// orient3d -- return +1 if d lies below the plane through a, b, c (where a, b, c appear
+// in counterclockwise order when seen from above the plane), -1 if it lies above, and
+// 0 if the four points are coplanar.
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+int orient3d(const Vector<3,I,F>& a, const Vector<3,I,F>& b, const Vector<3,I,F>& c,
+             const Vector<3,I,F>& d)
+{
+    int64_t ad[3], bd[3], cd[3];
+    uint64_t m = detail::RawDiff(ad, a, d) | detail::RawDiff(bd, b, d) | detail::RawDiff(cd, c, d);
+
+    // Differences below 2^20: each of the three terms is below 2^61
+    if (!(m >> 20))
+        return detail::Sign(detail::Orient3<int64_t>(ad, bd, cd));
+    return detail::Sign(detail::Orient3<int128_t>(ad, bd, cd));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// incircle -- return +1 if d lies inside the circle through a, b, c (which must be in
+// counterclockwise order), -1 if it lies outside, and 0 if the four points are
+// cocircular.
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+int incircle(const Vector<2,I,F>& a, const Vector<2,I,F>& b, const Vector<2,I,F>& c,
+             const Vector<2,I,F>& d)
+{
+    int64_t ad[2], bd[2], cd[2];
+    uint64_t m = detail::RawDiff(ad, a, d) | detail::RawDiff(bd, b, d) | detail::RawDiff(cd, c, d);
+
+    // Differences below 2^14 (2^30): lifts and minors are below 2^29 (2^61), so each
+    // of the three terms is below 2^58 (2^122).
+    if (!(m >> 14))
+        return detail::Sign(detail::InCircle<int64_t>(ad, bd, cd));
+    if (!(m >> 30))
+        return detail::Sign(detail::InCircle<int128_t>(ad, bd, cd));
+    return detail::InCircleSign256(ad, bd, cd);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// convexHull -- compute the convex hull of p[0..n-1] with Andrew's monotone chain,
+// using the exact orient2d(). The indices of the hull vertices are stored into out
+// (which must have room for n+1 indices) in counterclockwise order, starting from the
+// lowest-leftmost point; collinear points are excluded. Return the number of vertices.
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace detail {
+    template <int I, int F>
+    struct HullLess
+    {
+        const Vector<2,I,F>* p;
+        HullLess(const Vector<2,I,F>* p_) : p(p_) {}
+
+        bool operator()(int a, int b) const
+        {
+            if (p[a][0] < p[b][0]) return true;
+            if (p[b][0] < p[a][0]) return false;
+            if (p[a][1] < p[b][1]) return true;
+            if (p[b][1] < p[a][1]) return false;
+            return a < b;
+        }
+    };
+}
+
+template <int I, int F>
+int convexHull(const Vector<2,I,F>* p, int n, int* out)
+{
+    std::vector<int> idx(n);
+    for (int i=0;i<n;i++)
+        idx[i] = i;
+    std::sort(idx.begin(), idx.end(), detail::HullLess<I,F>(p));
+
+    // Drop duplicated points
+    int m = 0;
+    for (int i=0;i<n;i++)
+        if (m == 0 || !(p[idx[i]] == p[idx[m-1]]))
+            idx[m++] = idx[i];
+    if (m < 3)
+    {
+        std::copy(idx.begin(), idx.begin() + m, out);
+        return m;
+    }
+
+    // Lower hull, then upper hull
+    int k = 0;
+    for (int i=0;i<m;i++)
+    {
+        while (k >= 2 && orient2d(p[out[k-2]], p[out[k-1]], p[idx[i]]) <= 0)
+            --k;
+        out[k++] = idx[i];
+    }
+    for (int i=m-2, lower=k+1;i>=0;i--)
+    {
+        while (k >= lower && orient2d(p[out[k-2]], p[out[k-1]], p[idx[i]]) <= 0)
+            --k;
+        out[k++] = idx[i];
+    }
+    return k-1;
+}
+
+#endif // FIXEDPRED_H
@@ -0,0 +1,261 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains a triangle rasterizer for coverage masks, on fixed-point
+ * vertices.
+ */
+
+#ifndef FIXEDRASTER_H
+#define FIXEDRASTER_H
+
+#include "fixedgeom.h"
+#include <algorithm>
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // EdgeFunction -- edge function of a triangle edge, evaluated at pixel
+    // centers. Positive values are inside the triangle; the value is biased
+    // by one on edges which are not top or left edges, so that pixel centers
+    // exactly on a shared edge belong to only one of the two triangles.
+    /////////////////////////////////////////////////////////////////////////
+    struct EdgeFunction
+    {
+        int64_t e;          // value at the first pixel
+        int64_t sx, sy;     // increments for a step of one pixel along x and y
+
+        // Edge from a to b (raw coordinates), with the first pixel center at p
+        void setup(const int64_t* a, const int64_t* b, const int64_t* p, int F)
+        {
+            int64_t dx = b[0] - a[0], dy = b[1] - a[1];
+            bool topleft = (dy < 0) || (dy == 0 && dx > 0);
+            e = dx * (p[1] - a[1]) - dy * (p[0] - a[0]) - (topleft ? 0 : 1);
+            sx = -dy * (int64_t(1) << F);
+            sy = dx * (int64_t(1) << F);
+        }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // RasterScalar -- coverage of a block of w*h pixels (w, h <= 8), with the
+    // edge functions given at its top-left pixel. Covered pixels are set to
+    // value; return their number.
+    /////////////////////////////////////////////////////////////////////////
+    struct RasterScalar
+    {
+        static int block(uint8_t* row, int stride, int w, int h, const EdgeFunction* ef,
+                         const int64_t* e0, uint8_t value)
+        {
+            int count = 0;
+            int64_t er[3] = { e0[0], e0[1], e0[2] };
+            for (int y=0;y<h;y++, row+=stride)
+            {
+                int64_t e[3] = { er[0], er[1], er[2] };
+                for (int x=0;x<w;x++)
+                {
+                    if ((e[0] | e[1] | e[2]) >= 0)
+                    {
+                        row[x] = value;
+                        ++count;
+                    }
+                    for (int k=0;k<3;k++)
+                        e[k] += ef[k].sx;
+                }
+                for (int k=0;k<3;k++)
+                    er[k] += ef[k].sy;
+            }
+            return count;
+        }
+    };
+
+#ifdef FRACT_HAS_AVX2
+    struct RasterAVX2
+    {
+        // Mask of the pixels in a row of 8 which are inside all the edges
+        static int row8(const __m256i* lo, const __m256i* hi)
+        {
+            __m256i in0 = _mm256_or_si256(_mm256_or_si256(lo[0], lo[1]), lo[2]);
+            __m256i in1 = _mm256_or_si256(_mm256_or_si256(hi[0], hi[1]), hi[2]);
+            int out = _mm256_movemask_pd(_mm256_castsi256_pd(in0)) |
+                      (_mm256_movemask_pd(_mm256_castsi256_pd(in1)) << 4);
+            return ~out & 0xFF;
+        }
+
+        // Expand a mask of 8 bits into 8 bytes
+        static __m128i expand(int bits)
+        {
+            const __m128i sel = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+            return _mm_cmpeq_epi8(_mm_and_si128(_mm_set1_epi8(char(bits)), sel), sel);
+        }
+
+        static int block(uint8_t* row, int stride, int w, int h, const EdgeFunction* ef,
+                         const int64_t* e0, uint8_t value)
+        {
+            __m256i lo[3], hi[3], sy[3];
+            for (int k=0;k<3;k++)
+            {
+                int64_t sx = ef[k].sx;
+                __m256i ramp = _mm256_setr_epi64x(0, sx, sx+sx, sx+sx+sx);
+                lo[k] = _mm256_add_epi64(_mm256_set1_epi64x(e0[k]), ramp);
+                hi[k] = _mm256_add_epi64(lo[k], _mm256_set1_epi64x(sx+sx+sx+sx));
+                sy[k] = _mm256_set1_epi64x(ef[k].sy);
+            }
+
+            __m128i vv = _mm_set1_epi8(char(value));
+            int cols = (1 << w) - 1;
+            int count = 0;
+            for (int y=0;y<h;y++, row+=stride)
+            {
+                int bits = row8(lo, hi) & cols;
+                count += __builtin_popcount(bits);
+                if (w == 8)
+                {
+                    __m128i old = _mm_loadl_epi64((const __m128i*)row);
+                    _mm_storel_epi64((__m128i*)row, _mm_blendv_epi8(old, vv, expand(bits)));
+                }
+                else
+                    for (int x=0;x<w;x++)
+                        if (bits & (1 << x))
+                            row[x] = value;
+
+                for (int k=0;k<3;k++)
+                {
+                    lo[k] = _mm256_add_epi64(lo[k], sy[k]);
+                    hi[k] = _mm256_add_epi64(hi[k], sy[k]);
+                }
+            }
+            return count;
+        }
+    };
+
+    typedef RasterAVX2 Raster;
+#else
+    typedef RasterScalar Raster;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// rasterize -- set the pixels covered by the triangle (a, b, c) to value
+//
+// Vertices are in pixel units: the pixel (x, y) covers [x, x+1) * [y, y+1), and it is
+// covered if its center lies inside the triangle. The F fractional bits of the format
+// give the subpixel precision. Pixel centers exactly on an edge follow the top-left
+// rule (y grows downward), so triangles sharing an edge never overlap or leave gaps.
+// The winding of the triangle does not matter; degenerate triangles cover nothing.
+//
+// The buffer has width*height pixels (one byte each), with rows stride bytes apart.
+// The triangle is processed in 8x8 blocks: blocks entirely inside or outside are filled
+// or skipped at once, the others are evaluated with SIMD. Edge functions are computed
+// at double width and updated incrementally, with additions only. The triangle must
+// span less than 2^31 raw units along each axis.
+//
+// Return the number of covered pixels.
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+int rasterize(const Vector<2,I,F>& a, const Vector<2,I,F>& b, const Vector<2,I,F>& c,
+              uint8_t* buf, int width, int height, int stride, uint8_t value = 0xFF)
+{
+    STATIC_ASSERT(F >= 1 && F < 31, "The format needs 1 to 30 fractional bits to address pixel centers");
+    using detail::FractAccess;
+    using detail::EdgeFunction;
+
+    int64_t v[3][2];
+    const Vector<2,I,F>* pv[3] = { &a, &b, &c };
+    for (int i=0;i<3;i++)
+        for (int k=0;k<2;k++)
+            v[i][k] = FractAccess::raw((*pv[i])[k]);
+
+    int64_t lo[2], hi[2];
+    for (int k=0;k<2;k++)
+    {
+        lo[k] = std::min(v[0][k], std::min(v[1][k], v[2][k]));
+        hi[k] = std::max(v[0][k], std::max(v[1][k], v[2][k]));
+        OVERFLOW_IF((hi[k] - lo[k]) >> 31);
+    }
+
+    int64_t area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[1][1] - v[0][1]) * (v[2][0] - v[0][0]);
+    if (area == 0)
+        return 0;
+    if (area < 0)
+        for (int k=0;k<2;k++)
+            std::swap(v[1][k], v[2][k]);
+
+    // Pixels whose centers are within the bounding box
+    int64_t half = int64_t(1) << (F-1);
+    int64_t x0 = std::max(int64_t(0), (lo[0] - half + (int64_t(1) << F) - 1) >> F);
+    int64_t y0 = std::max(int64_t(0), (lo[1] - half + (int64_t(1) << F) - 1) >> F);
+    int64_t x1 = std::min(int64_t(width-1), (hi[0] - half) >> F);
+    int64_t y1 = std::min(int64_t(height-1), (hi[1] - half) >> F);
+    if (x0 > x1 || y0 > y1)
+        return 0;
+
+    int64_t p0[2] = { (x0 << F) + half, (y0 << F) + half };
+    EdgeFunction ef[3];
+    for (int k=0;k<3;k++)
+        ef[k].setup(v[k], v[(k+1)%3], p0, F);
+
+    int count = 0;
+    int64_t erow[3] = { ef[0].e, ef[1].e, ef[2].e };
+    for (int64_t by=y0;by<=y1;by+=8)
+    {
+        int h = int(std::min(int64_t(8), y1 - by + 1));
+        int64_t e[3] = { erow[0], erow[1], erow[2] };
+        for (int64_t bx=x0;bx<=x1;bx+=8)
+        {
+            int w = int(std::min(int64_t(8), x1 - bx + 1));
+
+            // Extremes of the edge functions over the block
+            bool reject = false, accept = true;
+            for (int k=0;k<3;k++)
+            {
+                int64_t dx = ef[k].sx * (w-1), dy = ef[k].sy * (h-1);
+                int64_t emin = e[k] + std::min(dx, int64_t(0)) + std::min(dy, int64_t(0));
+                int64_t emax = e[k] + std::max(dx, int64_t(0)) + std::max(dy, int64_t(0));
+                reject |= (emax < 0);
+                accept &= (emin >= 0);
+            }
+
+            uint8_t* row = buf + by * stride + bx;
+            if (accept)
+            {
+                for (int y=0;y<h;y++)
+                    memset(row + y * stride, value, w);
+                count += w * h;
+            }
+            else if (!reject)
+                count += detail::Raster::block(row, stride, w, h, ef, e, value);
+
+            for (int k=0;k<3;k++)
+                e[k] += ef[k].sx * 8;
+        }
+        for (int k=0;k<3;k++)
+            erow[k] += ef[k].sy * 8;
+    }
+    return count;
+}
+
+#endif // FIXEDRASTER_H
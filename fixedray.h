@@ -0,0 +1,398 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains ray intersection kernels on top of the geometric library.
+ * All the computations are carried out on integers, so the results are identical
+ * on every platform and with every compiler (and with or without SIMD).
+ */
+
+#ifndef FIXEDRAY_H
+#define FIXEDRAY_H
+
+#include "fixedgeom.h"
+#include <algorithm>
+#include <string.h>
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // Slab<IntType> -- helpers for the slab test of a ray against the planes
+    // of an axis-aligned box.
+    //
+    // The inverse of each direction component is stored as m * 2^-s, with
+    // |m| in (2^(W-3), 2^(W-2)], so that the distance along the ray of a
+    // plane is computed with a multiplication and a shift. Distances which
+    // cannot be represented saturate to the range of the Fract.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct Slab
+    {
+        typedef typename AnyInt::Bigger<IntType, int32_t>::type WIntType;
+        typedef typename AnyInt::DoubleType<WIntType>::type WDIntType;
+        typedef typename AnyInt::Unsigned<WIntType>::type WUIntType;
+        typedef typename AnyInt::DoubleType<WUIntType>::type WDUIntType;
+        enum { W = bitsof(WIntType) };
+
+        // Compute m and s so that m * 2^-s = 2^F / d. A null d gives m == 0.
+        static void inverse(IntType d, int F, WIntType& m, int& s)
+        {
+            assert(F <= W-2);
+            m = 0;
+            s = 0;
+            if (d == 0)
+                return;
+
+            WUIntType a = (d < 0) ? WUIntType(0) - WUIntType(WIntType(d)) : WUIntType(d);
+            int c = AnyInt::clz(WIntType(a));
+            a <<= c;
+            m = WIntType((WDUIntType(1) << (2*W-3)) / a);
+            if (d < 0)
+                m = -m;
+            s = 2*W-3-F-c;
+        }
+
+        // Distance of the plane at b from the origin o, rounded down and
+        // saturated into [tlo, thi].
+        static IntType dist(IntType b, IntType o, WIntType m, int s, IntType tlo, IntType thi)
+        {
+            WDIntType p = (WDIntType(b) * m - WDIntType(o) * m) >> s;
+            return (p < tlo) ? tlo : (p > thi) ? thi : IntType(p);
+        }
+
+        // Clip [tnear, tfar] against the slab [lo, hi] along one axis. If the
+        // direction is null, the slab is either everything or nothing.
+        static void clip(IntType lo, IntType hi, IntType o, WIntType m, int s,
+                         IntType tlo, IntType thi, IntType& tnear, IntType& tfar)
+        {
+            IntType t0, t1;
+            if (m == 0)
+            {
+                bool inside = !(o < lo) && !(hi < o);
+                t0 = inside ? tlo : thi;
+                t1 = inside ? thi : tlo;
+            }
+            else
+            {
+                t0 = dist(lo, o, m, s, tlo, thi);
+                t1 = dist(hi, o, m, s, tlo, thi);
+                if (t1 < t0)
+                    std::swap(t0, t1);
+            }
+            if (tnear < t0) tnear = t0;
+            if (t1 < tfar) tfar = t1;
+        }
+
+        // Full slab test. The ray starts at t = 0; a box entered at the
+        // saturation distance thi is considered out of reach.
+        static bool test(const IntType* lo, const IntType* hi, const IntType* o,
+                         const WIntType* m, const int32_t* s, int stride,
+                         IntType tlo, IntType thi, IntType& tnear, IntType& tfar)
+        {
+            tnear = 0;
+            tfar = thi;
+            for (int k=0;k<3;k++)
+                clip(lo[k], hi[k], o[k*stride], m[k*stride], s[k*stride], tlo, thi, tnear, tfar);
+            return !(tfar < tnear) && tnear < thi;
+        }
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // SlabPacket<IntType> -- slab test of SIZE rays against one box. The rays
+    // are stored as structure of arrays (o[axis][lane]). Return the mask of
+    // the lanes that hit the box, and the entry distances in tnear.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct SlabPacket
+    {
+        enum { SIZE = 8 };
+        typedef Slab<IntType> S;
+        typedef typename S::WIntType WIntType;
+
+        static int test(const IntType (*o)[SIZE], const WIntType (*m)[SIZE], const int32_t (*s)[SIZE],
+                        const IntType* lo, const IntType* hi, IntType tlo, IntType thi, IntType* tnear)
+        {
+            int mask = 0;
+            for (int i=0;i<SIZE;i++)
+            {
+                IntType tfar;
+                if (S::test(lo, hi, &o[0][i], &m[0][i], &s[0][i], SIZE, tlo, thi, tnear[i], tfar))
+                    mask |= 1 << i;
+            }
+            return mask;
+        }
+    };
+
+#ifdef FRACT_HAS_AVX2
+    template <>
+    struct SlabPacket<int32_t>
+    {
+        enum { SIZE = 8 };
+
+        // Vectorized Slab<int32_t>::dist()
+        static __m256i dist(__m256i b, __m256i o, __m256i m, __m256i s, __m256i tlo64, __m256i thi64)
+        {
+            __m256i se = _mm256_and_si256(s, _mm256_set1_epi64x(0xFFFFFFFF));
+            __m256i so = _mm256_srli_epi64(s, 32);
+            __m256i pe = avx2::srav64(_mm256_sub_epi64(avx2::mul_even(b, m), avx2::mul_even(o, m)), se);
+            __m256i po = avx2::srav64(_mm256_sub_epi64(avx2::mul_odd(b, m), avx2::mul_odd(o, m)), so);
+
+            pe = _mm256_blendv_epi8(pe, tlo64, _mm256_cmpgt_epi64(tlo64, pe));
+            pe = _mm256_blendv_epi8(pe, thi64, _mm256_cmpgt_epi64(pe, thi64));
+            po = _mm256_blendv_epi8(po, tlo64, _mm256_cmpgt_epi64(tlo64, po));
+            po = _mm256_blendv_epi8(po, thi64, _mm256_cmpgt_epi64(po, thi64));
+            return avx2::pack(pe, po);
+        }
+
+        static int test(const int32_t (*o)[SIZE], const int32_t (*m)[SIZE], const int32_t (*s)[SIZE],
+                        const int32_t* lo, const int32_t* hi, int32_t tlo, int32_t thi, int32_t* tnear)
+        {
+            __m256i vtlo = _mm256_set1_epi32(tlo), vthi = _mm256_set1_epi32(thi);
+            __m256i tlo64 = _mm256_set1_epi64x(tlo), thi64 = _mm256_set1_epi64x(thi);
+            __m256i tn = _mm256_setzero_si256(), tf = vthi;
+
+            for (int k=0;k<3;k++)
+            {
+                __m256i vo = avx2::load(o[k]), vm = avx2::load(m[k]), vs = avx2::load(s[k]);
+                __m256i vlo = _mm256_set1_epi32(lo[k]), vhi = _mm256_set1_epi32(hi[k]);
+
+                __m256i d0 = dist(vlo, vo, vm, vs, tlo64, thi64);
+                __m256i d1 = dist(vhi, vo, vm, vs, tlo64, thi64);
+                __m256i t0 = _mm256_min_epi32(d0, d1);
+                __m256i t1 = _mm256_max_epi32(d0, d1);
+
+                // Null directions: the slab is either everything or nothing
+                __m256i zero = _mm256_cmpeq_epi32(vm, _mm256_setzero_si256());
+                __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(vlo, vo), _mm256_cmpgt_epi32(vo, vhi));
+                __m256i z0 = _mm256_blendv_epi8(vtlo, vthi, outside);
+                __m256i z1 = _mm256_blendv_epi8(vthi, vtlo, outside);
+                t0 = _mm256_blendv_epi8(t0, z0, zero);
+                t1 = _mm256_blendv_epi8(t1, z1, zero);
+
+                tn = _mm256_max_epi32(tn, t0);
+                tf = _mm256_min_epi32(tf, t1);
+            }
+
+            avx2::store(tnear, tn);
+            __m256i miss = _mm256_or_si256(_mm256_cmpgt_epi32(tn, tf), _mm256_cmpeq_epi32(tn, vthi));
+            return ~_mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xFF;
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// AABB -- axis-aligned bounding box, from lo to hi (inclusive)
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class AABB
+{
+public:
+    typedef Vector3D<I,F> VVector;
+
+    VVector lo, hi;
+
+    AABB() {}
+    AABB(const VVector& lo_, const VVector& hi_) : lo(lo_), hi(hi_) {}
+};
+
+template <int I, int F>
+class RayPacket;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// Ray -- half-line orig + t*dir, for t >= 0
+//
+// The inverse of the direction is computed once, when the ray is built, so that the
+// box tests do not need any division. Distances are expressed in units of the length
+// of dir, and saturate to the range of Fract<I,F> (a box which is farther than that
+// is never hit).
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class Ray
+{
+public:
+    typedef Fract<I,F> VFract;
+    typedef Vector3D<I,F> VVector;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::Slab<IntType> Slab;
+    typedef typename Slab::WIntType WIntType;
+    friend class RayPacket<I,F>;
+
+    VVector o, d;
+    WIntType m[3];
+    int32_t s[3];
+
+    static IntType tmin() { return ~tmax(); }
+    static IntType tmax()
+    {
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+        return IntType(~(UIntType(~UIntType(0)) << (I+F-1)));
+    }
+
+public:
+    Ray() {}
+    Ray(const VVector& orig, const VVector& dir)
+        : o(orig), d(dir)
+    {
+        for (int k=0;k<3;k++)
+        {
+            int sk;
+            Slab::inverse(detail::FractAccess::raw(d[k]), F, m[k], sk);
+            s[k] = sk;
+        }
+    }
+
+    const VVector& orig() const { return o; }
+    const VVector& dir() const { return d; }
+    VVector at(VFract t) const { return o + d * t; }
+
+    // Slab test against an axis-aligned box. On hit, [tnear, tfar] is the part of
+    // the ray within the box (tnear is 0 if the origin is inside).
+    friend bool intersect(const Ray& r, const AABB<I,F>& box, VFract& tnear, VFract& tfar)
+    {
+        IntType lo[3], hi[3], o[3];
+        for (int k=0;k<3;k++)
+        {
+            lo[k] = detail::FractAccess::raw(box.lo[k]);
+            hi[k] = detail::FractAccess::raw(box.hi[k]);
+            o[k] = detail::FractAccess::raw(r.o[k]);
+        }
+
+        IntType tn, tf;
+        bool hit = Slab::test(lo, hi, o, r.m, r.s, 1, tmin(), tmax(), tn, tf);
+        tnear = detail::FractAccess::gen<I,F>(tn);
+        tfar = detail::FractAccess::gen<I,F>(tf);
+        return hit;
+    }
+
+    // Möller-Trumbore intersection with the triangle (v0, v1, v2). On hit, return
+    // the distance t and the barycentric coordinates (u, v) of the hit point
+    // (p = (1-u-v)*v0 + u*v1 + v*v2). The inside tests are done on the numerators,
+    // so the only divisions happen on hit. Triangles are two-sided; rays parallel
+    // to the triangle plane (within the precision of the format) never hit.
+    // The products of three coordinate differences must fit the format.
+    friend bool intersect(const Ray& r, const VVector& v0, const VVector& v1, const VVector& v2,
+                          VFract& t, VFract& u, VFract& v)
+    {
+        VVector e1(v1 - v0), e2(v2 - v0);
+        VVector p(cross(r.d, e2));
+        VFract det = dot(e1, p);
+        if (det == 0)
+            return false;
+
+        VVector sv(r.o - v0);
+        VVector q(cross(sv, e1));
+        VFract un = dot(sv, p), vn = dot(r.d, q), tn = dot(e2, q);
+        if (det < 0)
+        {
+            det = VFract() - det;
+            un = VFract() - un;
+            vn = VFract() - vn;
+            tn = VFract() - tn;
+        }
+
+        if (un < 0 || vn < 0 || det - un < vn || tn < 0)
+            return false;
+
+        t = detail::Divide(tn, det);
+        u = detail::Divide(un, det);
+        v = detail::Divide(vn, det);
+        return true;
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// RayPacket -- up to SIZE rays, tested together against one box
+//
+// The results are bit-identical to intersect(Ray, AABB, ...) applied on each ray.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+class RayPacket
+{
+public:
+    typedef Fract<I,F> VFract;
+    typedef Ray<I,F> VRay;
+
+private:
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef detail::SlabPacket<IntType> Packet;
+    typedef typename detail::Slab<IntType>::WIntType WIntType;
+
+public:
+    enum { SIZE = Packet::SIZE };
+
+private:
+    int n;
+    IntType o[3][SIZE];
+    WIntType m[3][SIZE];
+    int32_t s[3][SIZE];
+
+public:
+    // Build the packet from rays[0..n-1], with n <= SIZE
+    RayPacket(const VRay* rays, int n_)
+        : n(n_)
+    {
+        assert(n >= 0 && n <= SIZE);
+        memset(o, 0, sizeof(o));
+        memset(m, 0, sizeof(m));
+        memset(s, 0, sizeof(s));
+        for (int i=0;i<n;i++)
+            for (int k=0;k<3;k++)
+            {
+                o[k][i] = detail::FractAccess::raw(rays[i].o[k]);
+                m[k][i] = rays[i].m[k];
+                s[k][i] = rays[i].s[k];
+            }
+    }
+
+    int size() const { return n; }
+
+    // Return the mask of the rays hitting box (bit i for rays[i]). If tnear is not
+    // NULL, it receives the entry distance of each ray that hits.
+    int intersect(const AABB<I,F>& box, VFract* tnear=NULL) const
+    {
+        IntType lo[3], hi[3], tn[SIZE];
+        for (int k=0;k<3;k++)
+        {
+            lo[k] = detail::FractAccess::raw(box.lo[k]);
+            hi[k] = detail::FractAccess::raw(box.hi[k]);
+        }
+
+        int mask = Packet::test(o, m, s, lo, hi, VRay::tmin(), VRay::tmax(), tn) & ((1 << n) - 1);
+        if (tnear)
+            for (int i=0;i<n;i++)
+                if (mask & (1 << i))
+                    tnear[i] = detail::FractAccess::gen<I,F>(tn[i]);
+        return mask;
+    }
+};
+
+#endif // FIXEDRAY_H
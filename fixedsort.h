@@ -0,0 +1,228 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains the radix sort of arrays of fixed-point numbers.
+ */
+
+#ifndef FIXEDSORT_H
+#define FIXEDSORT_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include "fixedpoint/parallel.h"
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// sort_key -- unsigned key with the same order as the Fract it is computed from
+//
+// The value is offset by 2^(I+F-1), so that the key of the smallest number of the
+// format is zero and the key fits I+F bits; from_sort_key is the inverse function.
+// For formats which fill their integer (eg: Fract<16,16>), this is the usual flip of
+// the sign bit.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+typename AnyInt::Unsigned<typename detail::FractAccess::Traits<I,F>::IntType>::type
+sort_key(Fract<I,F> f)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+    return UIntType(detail::FractAccess::raw(f)) + (UIntType(1) << (I+F-1));
+}
+
+template <int I, int F>
+Fract<I,F> from_sort_key(typename AnyInt::Unsigned<typename detail::FractAccess::Traits<I,F>::IntType>::type k)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+    return detail::FractAccess::gen<I,F>(IntType(k - (UIntType(1) << (I+F-1))));
+}
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // RadixSort -- LSD radix sort of raw values, 8 bits per pass, on the
+    // keys of sort_key(). Each pass counts the digits of every chunk of the
+    // array, and then scatters the chunks in parallel, each one from its
+    // own offsets, so the sort is stable and its result does not depend on
+    // the number of threads. The first counting pass collects the digits of
+    // all passes, so that the passes in which all keys have the same digit
+    // are skipped. Values, if not NULL, follow their keys.
+    /////////////////////////////////////////////////////////////////////////
+    template <class IntType>
+    struct RadixSort
+    {
+        typedef typename AnyInt::Unsigned<IntType>::type UIntType;
+        enum { RADIX = 256, MAX_PASSES = sizeof(IntType), CHUNK = 65536 };
+
+        struct Key
+        {
+            UIntType bias;
+
+            explicit Key(int bits) : bias(UIntType(1) << (bits-1)) {}
+            unsigned digit(IntType x, int shift) const
+            { return unsigned((UIntType(x) + bias) >> shift) & (RADIX-1); }
+        };
+
+        // Digit counts of a[0..n) for the passes [p0,p1), into cnt[p][RADIX]
+        static void count(int* cnt, const IntType* a, int n, const Key& key, int p0, int p1)
+        {
+            memset(cnt + p0*RADIX, 0, (p1-p0) * RADIX * sizeof(int));
+            if (p1 - p0 == 1)
+            {
+                int* c = cnt + p0*RADIX;
+                for (int i=0;i<n;i++)
+                    c[key.digit(a[i], p0*8)]++;
+                return;
+            }
+            for (int i=0;i<n;i++)
+            {
+                UIntType k = UIntType(a[i]) + key.bias;
+                for (int p=p0;p<p1;p++)
+                    cnt[p*RADIX + (unsigned(k >> (p*8)) & (RADIX-1))]++;
+            }
+        }
+
+        template <class V>
+        static void sort(IntType* a, V* va, int n, int bits)
+        {
+            if (n < 2)
+                return;
+
+            const Key key(bits);
+            const int npasses = (bits + 7) / 8;
+            const int nchunks = NumChunks(n, CHUNK, MaxThreads());
+
+            AlignedBuffer<int> counts(nchunks * MAX_PASSES * RADIX);
+            AlignedBuffer<IntType> tmp(n);
+            AlignedBuffer<V> vtmp(va ? n : 1);
+            int* cnt = counts.get();
+
+            FRACT_OMP(omp parallel for schedule(static))
+            for (int t=0;t<nchunks;t++)
+            {
+                int begin, end;
+                ChunkRange(n, nchunks, t, begin, end);
+                count(cnt + t*MAX_PASSES*RADIX, a + begin, end - begin, key, 0, npasses);
+            }
+
+            IntType *src = a, *dst = tmp.get();
+            V *vsrc = va, *vdst = vtmp.get();
+            for (int p=0;p<npasses;p++)
+            {
+                // Skip the pass if all the keys have the same digit; otherwise
+                // the counts of the chunks must be those of the current order
+                bool skip = false;
+                for (int d=0;d<RADIX && !skip;d++)
+                {
+                    int total = 0;
+                    for (int t=0;t<nchunks;t++)
+                        total += cnt[(t*MAX_PASSES + p)*RADIX + d];
+                    skip = (total == n);
+                }
+                if (skip)
+                    continue;
+
+                if (p > 0 && nchunks > 1)
+                {
+                    FRACT_OMP(omp parallel for schedule(static))
+                    for (int t=0;t<nchunks;t++)
+                    {
+                        int begin, end;
+                        ChunkRange(n, nchunks, t, begin, end);
+                        count(cnt + t*MAX_PASSES*RADIX, src + begin, end - begin, key, p, p+1);
+                    }
+                }
+
+                // Turn the counts into the offsets of each digit in each chunk
+                int offset = 0;
+                for (int d=0;d<RADIX;d++)
+                    for (int t=0;t<nchunks;t++)
+                    {
+                        int& c = cnt[(t*MAX_PASSES + p)*RADIX + d];
+                        int s = c;
+                        c = offset;
+                        offset += s;
+                    }
+
+                FRACT_OMP(omp parallel for schedule(static))
+                for (int t=0;t<nchunks;t++)
+                {
+                    int begin, end;
+                    ChunkRange(n, nchunks, t, begin, end);
+                    int* off = cnt + (t*MAX_PASSES + p)*RADIX;
+                    for (int i=begin;i<end;i++)
+                    {
+                        int j = off[key.digit(src[i], p*8)]++;
+                        dst[j] = src[i];
+                        if (va)
+                            vdst[j] = vsrc[i];
+                    }
+                }
+
+                std::swap(src, dst);
+                std::swap(vsrc, vdst);
+            }
+
+            if (src != a)
+            {
+                memcpy(a, src, n * sizeof(IntType));
+                if (va)
+                    for (int i=0;i<n;i++)
+                        va[i] = vsrc[i];
+            }
+        }
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// radix_sort -- sort a[0..n) in increasing order
+//
+// This is a stable LSD radix sort, with one pass for each 8 bits of the format (I+F
+// bits, not the size of the underlying integer: Fract<1,15> needs two passes) and
+// passes skipped when all the elements agree on their digit. The passes are split
+// across threads (see fixedpoint/parallel.h), with identical results. The overload
+// with values sorts the pairs (a[i], values[i]) by key, keeping the original order
+// of equal keys; V must be a plain type, copied by assignment.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <int I, int F>
+void radix_sort(Fract<I,F>* a, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    detail::RadixSort<IntType>::sort(reinterpret_cast<IntType*>(a), (char*)NULL, n, I+F);
+}
+
+template <int I, int F, class V>
+void radix_sort(Fract<I,F>* a, V* values, int n)
+{
+    typedef typename detail::FractAccess::Traits<I,F>::IntType IntType;
+    detail::RadixSort<IntType>::sort(reinterpret_cast<IntType*>(a), values, n, I+F);
+}
+
+#endif // FIXEDSORT_H
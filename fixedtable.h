@@ -0,0 +1,344 @@
+/*
+ * Fixed-point C++ library
+ * Copyright (C) 2010, Giovanni Bajo <rasky@develer.com>
+ * Copyright (C) 2010, Develer Srl
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * This file contains lookup tables of functions of fixed-point numbers, with
+ * linear or quadratic interpolation between the entries.
+ */
+
+#ifndef FIXEDTABLE_H
+#define FIXEDTABLE_H
+
+#include "fixedpoint.h"
+#include "fixedpoint/simd.h"
+#include <algorithm>
+#include <cmath>
+
+enum TableInterpolation
+{
+    TABLE_LINEAR,       // straight line between the samples at the ends of a segment
+    TABLE_QUADRATIC     // parabola through the ends and the midpoint of a segment
+};
+
+namespace detail {
+
+    /////////////////////////////////////////////////////////////////////////
+    // TableLayout -- coefficients of the segments of a table, and how raw
+    // inputs of bits total bits map to them: the segment is the top bits of
+    // the input (biased to unsigned), above shift, and the position in the
+    // segment is the next tbits bits. Entries have guard fractional bits
+    // more than the output; c2 is NULL for linear interpolation.
+    /////////////////////////////////////////////////////////////////////////
+    template <class EntryType>
+    struct TableLayout
+    {
+        const EntryType *c0, *c1, *c2;
+        int bits, shift, tbits, guard;
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    // TableScalar -- reference kernel of FunctionTable. With the position t
+    // in [0, 1) of the input in its segment, the result is
+    //
+    //     c0 + (c1 + c2*t)*t
+    //
+    // evaluated with two products, each truncated to the precision of the
+    // entries; the guard bits are then dropped (rounding down) and the
+    // result is narrowed with the overflow policy.
+    /////////////////////////////////////////////////////////////////////////
+    template <class EntryType>
+    struct TableScalar
+    {
+        typedef typename AnyInt::DoubleType<EntryType>::type DIntType;
+
+        template <class InType, class OutType>
+        static void eval(OutType* r, const InType* x, int n, const TableLayout<EntryType>& t,
+                         const Limits<OutType>& lim)
+        {
+            typedef typename AnyInt::Unsigned<InType>::type UIntType;
+            const UIntType bias = UIntType(UIntType(1) << (t.bits - 1));
+            const UIntType mask = UIntType((UIntType(1) << t.tbits) - 1);
+            const int fshift = t.shift - t.tbits;
+
+            for (int i=0;i<n;i++)
+            {
+                UIntType u = UIntType(UIntType(x[i]) + bias);
+                int k = int(u >> t.shift);
+                DIntType f = DIntType((u >> fshift) & mask);
+                EntryType v = t.c1[k];
+                if (t.c2)
+                    v += EntryType((t.c2[k] * f) >> t.tbits);
+                v = t.c0[k] + EntryType((v * f) >> t.tbits);
+                r[i] = BatchScalar<OutType>::fix(v >> t.guard, lim);
+            }
+        }
+    };
+
+    template <class EntryType>
+    struct Table : public TableScalar<EntryType>
+    {};
+
+#ifdef FRACT_HAS_AVX2
+    /////////////////////////////////////////////////////////////////////////
+    // Table<int32_t> -- eight lookups at a time, with the coefficients
+    // fetched by gathers. Inputs and outputs must be stored in int8_t or
+    // int32_t; the other formats use the scalar kernel.
+    /////////////////////////////////////////////////////////////////////////
+    template <>
+    struct Table<int32_t> : public TableScalar<int32_t>
+    {
+        typedef TableScalar<int32_t> Scalar;
+
+        template <class InType, class OutType>
+        static void eval(OutType* r, const InType* x, int n, const TableLayout<int32_t>& t,
+                         const Limits<OutType>& lim)
+        {
+            Scalar::eval(r, x, n, t, lim);
+        }
+
+        static void eval(int32_t* r, const int32_t* x, int n, const TableLayout<int32_t>& t, const Limits<int32_t>& lim)
+        { lanes(r, x, n, t, lim); }
+        static void eval(int32_t* r, const int8_t* x, int n, const TableLayout<int32_t>& t, const Limits<int32_t>& lim)
+        { lanes(r, x, n, t, lim); }
+        static void eval(int8_t* r, const int32_t* x, int n, const TableLayout<int32_t>& t, const Limits<int8_t>& lim)
+        { lanes(r, x, n, t, lim); }
+        static void eval(int8_t* r, const int8_t* x, int n, const TableLayout<int32_t>& t, const Limits<int8_t>& lim)
+        { lanes(r, x, n, t, lim); }
+
+    private:
+        // Low 32 bits of (a*f) >> s, for the lanes where the result fits
+        static __m256i mul_shift(__m256i a, __m256i f, __m128i s, __m128i s32)
+        {
+            return _mm256_blend_epi32(_mm256_srl_epi64(avx2::mul_even(a, f), s),
+                                      _mm256_sll_epi64(avx2::mul_odd(a, f), s32), 0xAA);
+        }
+
+        template <class InType, class OutType>
+        static void lanes(OutType* r, const InType* x, int n, const TableLayout<int32_t>& t,
+                          const Limits<OutType>& lim)
+        {
+            const Limits<int32_t> lim32(lim.bits, lim.policy);
+            const __m256i bias = _mm256_set1_epi32(int32_t(uint32_t(1) << (t.bits - 1)));
+            const __m256i mask = _mm256_set1_epi32((1 << t.tbits) - 1);
+            const __m128i sk = _mm_cvtsi32_si128(t.shift), sf = _mm_cvtsi32_si128(t.shift - t.tbits);
+            const __m128i st = _mm_cvtsi32_si128(t.tbits), st32 = _mm_cvtsi32_si128(32 - t.tbits);
+            const __m128i sg = _mm_cvtsi32_si128(t.guard);
+            const __m256i zero = _mm256_setzero_si256();
+
+            int i = 0;
+            for (;i+8<=n;i+=8)
+            {
+                __m256i u = _mm256_add_epi32(avx2::load8(x+i), bias);
+                __m256i k = _mm256_srl_epi32(u, sk);
+                __m256i f = _mm256_and_si256(_mm256_srl_epi32(u, sf), mask);
+                __m256i v = _mm256_i32gather_epi32(t.c1, k, 4);
+                if (t.c2)
+                    v = _mm256_add_epi32(v, mul_shift(_mm256_i32gather_epi32(t.c2, k, 4), f, st, st32));
+                v = _mm256_add_epi32(_mm256_i32gather_epi32(t.c0, k, 4), mul_shift(v, f, st, st32));
+                v = _mm256_sra_epi32(v, sg);
+                avx2::store8(r+i, Batch<int32_t>::fix(v, zero, _mm256_srai_epi32(v, 31), lim32));
+            }
+            Scalar::eval(r+i, x+i, n-i, t, lim);
+        }
+    };
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// FunctionTable -- lookup table of a function from In = Fract<I,F> to Out = Fract<I2,F2>,
+// with N segments (a power of two) and linear or quadratic interpolation
+//
+// The segments split the whole range of the input evenly, so the segment of a value is
+// just the top log2(N) bits of its raw representation, and the position within the
+// segment the bits below: an evaluation is a shift, a mask, the loads of the
+// coefficients of the segment and one (linear) or two (quadratic) integer products,
+// with no floating point math and no search.
+//
+// The table is built from the samples of the function at the ends of the segments
+// (N+1 samples, for linear interpolation) or at the ends and at the midpoints (2N+1
+// samples, for quadratic interpolation), evenly spaced over the closed range
+// [-2^(I-1), 2^(I-1)]. The samples can be computed when the table is constructed, from
+// any callable f(double) returning double, or given as an array of Out values (eg: a
+// constant table generated offline, which avoids floating point at runtime entirely).
+//
+// The coefficients have some guard bits more than the output, so the error of the
+// table is that of the interpolation plus less than one unit of the output: linear
+// interpolation of a function with second derivative bounded by M is within
+// M*h^2/8 of it, quadratic interpolation within M3*h^3/72 (M3 bounding the third
+// derivative), where h = 2^I/N is the width of a segment. The entries are int32_t for
+// outputs of up to 24 bits, int64_t for larger ones.
+//
+// Samples which do not fit the output (which may exceed its maximum by one unit, for
+// the last sample), and results of the interpolation which do not fit it, follow the
+// overflow policy given at construction. The functions on arrays process eight inputs
+// at a time with AVX2, with the coefficients fetched by gathers, and give the same
+// results as the scalar ones.
+//
+/////////////////////////////////////////////////////////////////////////////////////////
+template <class In, int N, class Out = In>
+class FunctionTable;
+
+template <int I, int F, int N, int I2, int F2>
+class FunctionTable<Fract<I,F>, N, Fract<I2,F2> >
+{
+public:
+    typedef Fract<I,F> InFract;
+    typedef Fract<I2,F2> OutFract;
+
+private:
+    enum { BITS = I+F, OUT_BITS = I2+F2 };
+    typedef typename detail::FractAccess::Traits<I,F>::IntType InType;
+    typedef typename detail::FractAccess::Traits<I2,F2>::IntType OutType;
+    typedef typename detail::if_t<(OUT_BITS <= 24), int32_t, int64_t>::type EntryType;
+    typedef detail::Table<EntryType> Kernel;
+    typedef detail::Limits<OutType> Limits;
+
+    // Guard bits of the entries: coefficients are within 8 times the largest
+    // sample, and the largest sample is 2^(OUT_BITS-1+GUARD)
+    enum { GUARD = bitsof(EntryType) - OUT_BITS - 4 };
+
+    STATIC_ASSERT(OUT_BITS <= 56 && N >= 2 && (N & (N-1)) == 0 && (BITS >= 31 || N <= (1 << BITS)),
+                  "Output format too large for a table, or N not a power of two within the input range");
+
+    TableInterpolation interp;
+    Limits lim;
+    detail::AlignedBuffer<EntryType> c0, c1, c2;
+    detail::TableLayout<EntryType> layout;
+
+    static int samples(TableInterpolation interp)
+    {
+        return interp == TABLE_QUADRATIC ? 2*N + 1 : N + 1;
+    }
+
+    // Sample of the function with GUARD bits more than the output
+    EntryType sample(double v) const
+    {
+        const double m = ldexp(1.0, I2 - 1);
+        if (!(v >= -m && v <= m))
+        {
+            switch (lim.policy)
+            {
+            case FRACT_OVERFLOW_SATURATE:
+                v = (v < 0) ? -m : m;
+                break;
+            case FRACT_OVERFLOW_WRAP:
+                v -= 2*m * floor((v + m) / (2*m));
+                break;
+            default:
+                OVERFLOW_IF(true);
+                break;
+            }
+        }
+        return EntryType(floor(ldexp(v, F2 + GUARD) + 0.5));
+    }
+
+    // Coefficients of the segments from the samples q
+    void build(const EntryType* q)
+    {
+        for (int k=0;k<N;k++)
+        {
+            if (interp == TABLE_QUADRATIC)
+            {
+                EntryType q0 = q[2*k], qm = q[2*k+1], q1 = q[2*k+2];
+                c0.get()[k] = q0;
+                c1.get()[k] = 4*qm - 3*q0 - q1;
+                c2.get()[k] = 2*(q0 + q1) - 4*qm;
+            }
+            else
+            {
+                c0.get()[k] = q[k];
+                c1.get()[k] = q[k+1] - q[k];
+            }
+        }
+
+        const int logn = AnyInt::Log2Ceil(N) - 1;
+        layout.c0 = c0.get();
+        layout.c1 = c1.get();
+        layout.c2 = (interp == TABLE_QUADRATIC) ? c2.get() : NULL;
+        layout.bits = BITS;
+        layout.shift = BITS - logn;
+        layout.tbits = std::min(layout.shift, int(bitsof(EntryType)) - 2);
+        layout.guard = GUARD;
+    }
+
+    void build(const OutFract* s)
+    {
+        const int m = samples(interp);
+        const OutType* raw = reinterpret_cast<const OutType*>(s);
+        detail::AlignedBuffer<EntryType> q(m);
+        for (int k=0;k<m;k++)
+            q.get()[k] = EntryType(raw[k]) * (EntryType(1) << GUARD);
+        build(q.get());
+    }
+
+public:
+    // Table of f, sampled at construction
+    template <class Func>
+    explicit FunctionTable(Func f, TableInterpolation interp_ = TABLE_LINEAR,
+                           FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : interp(interp_), lim(OUT_BITS, policy), c0(N), c1(N), c2(N)
+    {
+        const int m = samples(interp);
+        detail::AlignedBuffer<EntryType> q(m);
+        for (int k=0;k<m;k++)
+            q.get()[k] = sample(f(ldexp(double(k), I) / (m - 1) - ldexp(1.0, I-1)));
+        build(q.get());
+    }
+
+    // Table from the samples s[0..N] (linear) or s[0..2N] (quadratic), evenly
+    // spaced from -2^(I-1) to 2^(I-1)
+    explicit FunctionTable(const OutFract* s, TableInterpolation interp_ = TABLE_LINEAR,
+                           FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : interp(interp_), lim(OUT_BITS, policy), c0(N), c1(N), c2(N)
+    {
+        build(s);
+    }
+
+    explicit FunctionTable(OutFract* s, TableInterpolation interp_ = TABLE_LINEAR,
+                           FractOverflowPolicy policy = FRACT_OVERFLOW_CHECK)
+        : interp(interp_), lim(OUT_BITS, policy), c0(N), c1(N), c2(N)
+    {
+        build(s);
+    }
+
+    TableInterpolation interpolation() const { return interp; }
+
+    OutFract operator()(InFract x) const
+    {
+        OutFract r;
+        (*this)(&x, &r, 1);
+        return r;
+    }
+
+    // r[i] = f(x[i]) for i in [0, n)
+    void operator()(const InFract* x, OutFract* r, int n) const
+    {
+        Kernel::eval(reinterpret_cast<OutType*>(r), reinterpret_cast<const InType*>(x), n, layout, lim);
+    }
+};
+
+#endif // FIXEDTABLE_H
@@ -1,6 +1,19 @@
 #define FRACT_CHECKS_WITH_EXCEPTIONS
 #include "../fixedpoint.h"
 #include "../fixedgeom.h"
+#include "../fixedray.h"
+#include "../fixedgrid.h"
+#include "../fixedpred.h"
+#include "../fixedparticle.h"
+#include "../fixedraster.h"
+#include "../fixedarray.h"
+#include "../fixedgemm.h"
+#include "../fixedsort.h"
+#include "../fixedfilter.h"
+#include "../fixedfft.h"
+#include "../fixedcordic.h"
+#include "../fixedtable.h"
+#include <algorithm>
 #include <QTest>
 #include <QDebug>
 
@@ -76,6 +89,24 @@ private slots:
     }
 
 
+    void overflow(void)
+    {
+        QVERIFY(!AnyInt::SubOverflow((int32_t)131072, (int32_t)-327680));
+        QVERIFY(AnyInt::SubOverflow((int32_t)-2, (int32_t)2147483647));
+        QVERIFY(AnyInt::SubOverflow((int32_t)2147483647, (int32_t)-1));
+        QVERIFY(!AnyInt::AddOverflow((int32_t)-2, (int32_t)2147483647));
+        QVERIFY(AnyInt::AddOverflow((int32_t)1, (int32_t)2147483647));
+    }
+
+    void log2ceil(void)
+    {
+        QCOMPARE(AnyInt::Log2Ceil((int32_t)0), 0);
+        QCOMPARE(AnyInt::Log2Ceil((int32_t)1), 1);
+        QCOMPARE(AnyInt::Log2Ceil((int32_t)65536), 17);
+        QCOMPARE(AnyInt::Log2Ceil((int64_t)0), 0);
+        QCOMPARE(AnyInt::Log2Ceil((int64_t)-1), 64);
+    }
+
     void addscaled(void)
     {
         QCOMPARE(AnyInt::ScaledAdd((uint8_t)245, (uint8_t)245, 1), (uint8_t)245);
@@ -184,11 +215,32 @@ private slots:
             QTest::newRow(QString::number(i).toAscii()) << i << sqrt(double(i));
     }
 
+    void rsqroot(void)
+    {
+        typedef Fract<16,16> F;
+        typedef Fract<8,24> F2;
+        typedef Fract<32,32> F3;
+
+        QCOMPARE(rsqrt(F(4)), F(0.5));
+        QCOMPARE(rsqrt(F(0.25)), F(2));
+        QCOMPARE(rsqrt(F3(1)), F3(1));
+        for (int i=1;i<100;i++)
+        {
+            QVERIFY(F::error(rsqrt(F(i)), F(1/sqrt(double(i)))) < 2);
+            QVERIFY(F2::error(rsqrt(F2(i/100.0)), F2(1/sqrt(F2(i/100.0).toDouble()))) < 2);
+            QVERIFY(F3::error(rsqrt(F3(i*1000)), F3(1/sqrt(double(i*1000)))) < 2);
+        }
+        DOM(rsqrt(F(0)));
+        DOM(rsqrt(F(-1)));
+    }
+
     void square_root_sidecases(void)
     {
         typedef Fract<16,16> F;
         QVERIFY(sqrt(F(1)) == 1);
         QVERIFY(sqrt(F(0)) == 0);
+        QVERIFY(sqrt_fast(F(0)) == 0);
+        QVERIFY(sqrt_fast(Fract<32,32>(0)) == 0);
         DOM(sqrt(F(-1)));
     }
 
@@ -312,6 +364,51 @@ class TestGeom : public QObject
 {
     Q_OBJECT
 
+private:
+    static double dist2(Vector3D<16,16> a, Vector3D<16,16> b)
+    {
+        double r = 0;
+        for (int k=0;k<3;k++)
+            r += (a[k].toDouble() - b[k].toDouble()) * (a[k].toDouble() - b[k].toDouble());
+        return r;
+    }
+
+    // Compare the grid queries with a brute force search
+    void checkGrid(const UniformGrid<16,16>& g, const Vector3D<16,16>* p, int n)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+        V qs[4] = { V(0, 0, 0), V(1.3, -2.7, 5.1), V(-7.9, 7.5, -7), V(12, 0, -11) };
+        F rs[3] = { F(0.75), F(2.5), F(7) };
+        std::vector<int> out(n);
+
+        for (int j=0;j<4;j++)
+        {
+            for (int l=0;l<3;l++)
+            {
+                std::vector<int> ref;
+                for (int i=0;i<n;i++)
+                    if (dist2(p[i], qs[j]) <= rs[l].toDouble() * rs[l].toDouble())
+                        ref.push_back(i);
+                int cnt = g.radius(qs[j], rs[l], &out[0], n);
+                QCOMPARE(cnt, int(ref.size()));
+                QVERIFY(std::equal(ref.begin(), ref.end(), out.begin()));
+
+                // With a short output, the smallest indices are kept
+                QCOMPARE(g.radius(qs[j], rs[l], &out[0], cnt/2), cnt);
+                QVERIFY(std::equal(ref.begin(), ref.begin() + cnt/2, out.begin()));
+            }
+
+            std::vector<std::pair<double,int> > ref;
+            for (int i=0;i<n;i++)
+                ref.push_back(std::make_pair(dist2(p[i], qs[j]), i));
+            std::sort(ref.begin(), ref.end());
+            QCOMPARE(g.nearest(qs[j], 7, &out[0]), 7);
+            for (int i=0;i<7;i++)
+                QCOMPARE(out[i], ref[i].second);
+        }
+    }
+
 private slots:
     void mod(void)
     {
@@ -336,6 +433,1704 @@ private slots:
 
         QTest::newRow("1") << 4 << 5 << 2 << 45;
     }
+
+    void addsub(void)
+    {
+        typedef Vector3D<16,16> V;
+        QCOMPARE(V(V(1, 2, 3) + V(4.5, -5, 6)), V(5.5, -3, 9));
+        QCOMPARE(V(V(1, 2, 3) - V(4.5, -5, 6)), V(-3.5, 7, -3));
+        QCOMPARE(V(-V(1, 2, 3)), V(-1, -2, -3));
+        QCOMPARE(V(mul(V(1, 2, 3), V(4.5, -5, 6))), V(4.5, -10, 18));
+    }
+
+    void dotcross(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Vector2D<32,32> V2;
+        typedef Fract<16,16> F;
+        typedef Fract<32,32> F2;
+
+        QCOMPARE(dot(V(1, 2, 3), V(4, -5, 6)), F(12));
+        QCOMPARE(dot(V2(0.5, 3), V2(0.25, -2)), F2(-5.875));
+        QCOMPARE(V(cross(V(1, 0, 0), V(0, 1, 0))), V(0, 0, 1));
+        QCOMPARE(V(cross(V(1, 2, 3), V(4, 5, 6))), V(-3, 6, -3));
+
+        // Products are accumulated at double width and rounded only once
+        F eps(1, 16);
+        QCOMPARE(dot(V(eps, eps, 0), V(0.5, 0.5, 0)), eps);
+
+        // Sums of products which do not fit the double width are detected,
+        // and only the final result matters
+        typedef Vector4D<16,16> V4;
+        F lo(-32768), hi(int64_t(0x7FFFFFFF), 16);
+        V4 m(lo, lo, lo, lo);
+        OVF(dot(m, m));
+        OVF(m.mod2());
+        QCOMPARE(dot(m, V4(lo, lo, hi, hi)), F(1));
+    }
+
+    void memcopy(void)
+    {
+        typedef Vector4D<16,16> V;
+        V src[2] = { V(1, 2, 3, 4), V(5, 6, 7) };
+        V dst[2];
+        memcpy(dst, src, sizeof(src));
+        QCOMPARE(dst[0], src[0]);
+        QCOMPARE(dst[1], V(5, 6, 7, 0));
+    }
+
+    void soa(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+        enum { N = 37 };
+
+        // Batch operations must match the scalar ones bit by bit
+        V v[N], w[N];
+        uint32_t seed = 1234;
+        for (int i=0;i<N;i++)
+            for (int k=0;k<3;k++)
+            {
+                seed = seed * 1103515245 + 12345;
+                v[i][k] = F(int32_t(seed) >> 12, 16);
+                seed = seed * 1103515245 + 12345;
+                w[i][k] = F(int32_t(seed) >> 12, 16);
+            }
+
+        Vector3DArray<16,16> a(v, N), b(w, N);
+        F d[N], m[N];
+        a.dot(b, d);
+        a.mod2(m);
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(d[i], dot(v[i], w[i]));
+            QCOMPARE(m[i], v[i].mod2());
+        }
+
+        F f(0.3);
+        a.scale(f);
+        a.add(b);
+        for (int i=0;i<N;i++)
+            QCOMPARE(a[i], V(v[i] * f + w[i]));
+
+        V r0(0.5, 0.25, -1), r1(0, 1, 0), r2(-0.75, 0, 0.125), t(3, -2, 1);
+        a.transform(r0, r1, r2, t);
+        b.normalize();
+        for (int i=0;i<N;i++)
+        {
+            V u(v[i] * f + w[i]);
+            QCOMPARE(a[i], V(dot(r0, u) + t[0], dot(r1, u) + t[1], dot(r2, u) + t[2]));
+            QCOMPARE(b[i], V(w[i].dir()));
+        }
+
+        // Sums which wrap around the double width are detected, in the
+        // vectorized loop and in the tail
+        F lo(-32768);
+        for (int n=1;n<=9;n+=8)
+        {
+            std::vector<V> big(n, V(lo, lo, lo));
+            Vector3DArray<16,16> c(&big[0], n);
+            std::vector<F> cd(n);
+            OVF(c.dot(c, &cd[0]));
+            OVF(c.mod2(&cd[0]));
+            OVF(c.transform(V(lo, lo, lo), V(), V(), V()));
+            OVF(c.normalize());
+        }
+
+        // With Fract<1,31> at -1, the wrapped sum of three products is exactly
+        // the lowest value in range
+        typedef Vector3D<1,31> V1;
+        for (int n=1;n<=8;n+=7)
+        {
+            std::vector<V1> m1(n, V1(-1, -1, -1));
+            Vector3DArray<1,31> d(&m1[0], n);
+            std::vector<Fract<1,31> > dd(n);
+            OVF(d.dot(d, &dd[0]));
+            OVF(d.mod2(&dd[0]));
+            OVF(d.transform(V1(-1, -1, -1), V1(), V1(), V1()));
+            OVF(d.normalize());
+        }
+    }
+
+    void matrix(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Matrix3x3<16,16> M;
+        typedef Fract<16,16> F;
+
+        M a(V(1, 2, 3), V(0, 1, 4), V(5, 6, 0));
+        M b(V(0.5, 0, 0), V(0, 2, 0), V(0, 0, -1));
+        QCOMPARE(M(a * b), M(V(0.5, 4, -3), V(0, 2, -4), V(2.5, 12, 0)));
+        QCOMPARE(M(a * M::identity()), a);
+        QCOMPARE(V(a * V(1, -1, 2)), V(5, 7, -1));
+        QCOMPARE(M(a.transpose()), M(V(1, 0, 5), V(2, 1, 6), V(3, 4, 0)));
+        QCOMPARE(det(a), F(1));
+
+        // The inverse of a has integer elements
+        QCOMPARE(M(inverse(a)), M(V(-24, 18, 5), V(20, -15, -4), V(-5, 4, 1)));
+
+        typedef Vector4D<16,16> V4;
+        typedef Matrix4x4<16,16> M4;
+        M4 c(V4(2, 0, 0, 1), V4(0, 3, 0, 0), V4(1, 0, 1, 0), V4(0, 0, 0, 4));
+        QCOMPARE(det(c), F(24));
+        M4 ci = inverse(c);
+        QVERIFY(F::error(M4(ci * c)(0, 0), 1) < 2);
+        QCOMPARE(ci(3, 3), F(0.25));
+        QCOMPARE(ci(0, 3), F(-0.125));
+        QCOMPARE(ci(2, 0), F(-0.5));
+        QVERIFY(F::error(ci(1, 1), F(1.0/3)) < 2);
+
+        // Products of rows and columns whose sums do not fit the double
+        // width raise an overflow error, instead of wrapping around
+        F lo(-32768), hi(int64_t(0x7FFFFFFF), 16);
+        M4 big(V4(lo, lo, lo, lo), V4(lo, lo, lo, lo), V4(lo, lo, lo, lo), V4(lo, lo, lo, lo));
+        OVF(M4(big * big));
+        OVF(V4(big * V4(lo, lo, lo, lo)));
+        QCOMPARE(V4(big * V4(lo, lo, hi, hi)), V4(1, 1, 1, 1));
+    }
+
+    void quaternion(void)
+    {
+        typedef Quaternion<16,16> Q;
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+
+        // 90 degrees around z
+        Q q = normalize(Q(1, 0, 0, 1));
+        QVERIFY(F::error(q[0], F(sqrt(0.5))) < 2);
+        QVERIFY(F::error(q[3], F(sqrt(0.5))) < 2);
+
+        V r = q.rotate(V(1, 0, 0));
+        QVERIFY(F::error(r[0], 0) < 3);
+        QVERIFY(F::error(r[1], 1) < 3);
+        QVERIFY(F::error(r[2], 0) < 3);
+
+        Q id = q * conj(q);
+        QVERIFY(F::error(id[0], 1) < 3);
+        for (int i=1;i<4;i++)
+            QVERIFY(F::error(id[i], 0) < 3);
+
+        // Slerp halfway is 45 degrees around z
+        QCOMPARE(slerp(Q(), q, 0), Q());
+        Q s = slerp(Q(), q, 0.5);
+        QVERIFY(F::error(s[0], F(cos(M_PI/8))) < 3);
+        QVERIFY(F::error(s[3], F(sin(M_PI/8))) < 3);
+        Q s1 = slerp(Q(), q, 1);
+        for (int i=0;i<4;i++)
+            QVERIFY(F::error(s1[i], q[i]) < 3);
+        Q n = nlerp(Q(), q, 0.5);
+        QVERIFY(F::error(n[0], F(cos(M_PI/8))) < 3);
+
+        // Sums which do not fit the double width raise an overflow error
+        F lo(-32768);
+        Q big(lo, lo, lo, lo), big2(lo, lo, lo, F(int64_t(0x7FFFFFFF), 16));
+        OVF(Q(big * big));
+        OVF(Q(big2 * big));
+        OVF(big.toMatrix());
+
+        // Batch rotation matches the scalar one
+        V v[10];
+        for (int i=0;i<10;i++)
+            v[i] = V(i, 2*i - 7, 3);
+        Vector3DArray<16,16> a(v, 10);
+        Q q2 = normalize(Q(2, 1, -1, 0.5));
+        a.rotate(q2);
+        q2.rotate(v, 10);
+        for (int i=0;i<10;i++)
+            QCOMPARE(a[i], v[i]);
+    }
+
+    void normalize_batch(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+        enum { N = 21 };
+
+        V d = V(3, 0, -4).dir();
+        QVERIFY(F::error(d[0], 0.6) < 2);
+        QVERIFY(F::error(d[2], -0.8) < 2);
+        QCOMPARE(V(V().dir()), V());
+
+        // Batch normalization matches dir() bit by bit, including null and
+        // very short vectors
+        V v[N], w[N];
+        uint32_t seed = 4321;
+        for (int i=0;i<N;i++)
+            for (int k=0;k<3;k++)
+            {
+                seed = seed * 1103515245 + 12345;
+                v[i][k] = F(int32_t(seed) >> (10 + i%8), 16);
+            }
+        v[3] = V();
+        v[9] = V(F(1, 16), 0, 0);
+        v[15] = V(F(300, 16), F(-200, 16), F(100, 16));
+        for (int i=0;i<N;i++)
+        {
+            w[i] = v[i].dir();
+            if (!(v[i].mod2() < F(1)))
+                QVERIFY(F::error(w[i].mod2(), 1) < 4);
+        }
+
+        normalize(v, N);
+        for (int i=0;i<N;i++)
+            QCOMPARE(v[i], w[i]);
+        QCOMPARE(v[3], V());
+    }
+
+    void ray(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+        typedef Ray<16,16> R;
+        typedef AABB<16,16> B;
+
+        B box(V(1, -1, -1), V(3, 1, 1));
+        F tn, tf;
+        QVERIFY(intersect(R(V(0, 0, 0), V(1, 0, 0)), box, tn, tf));
+        QCOMPARE(tn, F(1));
+        QCOMPARE(tf, F(3));
+        QVERIFY(intersect(R(V(0, 0, 0), V(4, 0, 0)), box, tn, tf));
+        QCOMPARE(tn, F(0.25));
+        QCOMPARE(tf, F(0.75));
+        QVERIFY(intersect(R(V(0, 0, 0), V(1, 0.5, 0)), box, tn, tf));
+        QCOMPARE(tn, F(1));
+        QCOMPARE(tf, F(2));
+        QVERIFY(intersect(R(V(2, 0, 0), V(0, 0, -1)), box, tn, tf));
+        QCOMPARE(tn, F(0));
+        QCOMPARE(tf, F(1));
+        QVERIFY(!intersect(R(V(0, 0, 0), V(-1, 0, 0)), box, tn, tf));
+        QVERIFY(!intersect(R(V(0, 2, 0), V(1, 0, 0)), box, tn, tf));
+        QVERIFY(!intersect(R(V(0, 0, 0), V(1, 1.5, 0)), box, tn, tf));
+
+        // The box is farther than the range of the format
+        QVERIFY(!intersect(R(V(0, 0, 0), V(F(1, 16), 0, 0)), box, tn, tf));
+
+        // Packets give the same results as single rays. The rays point
+        // roughly towards the origin, some have null direction components.
+        R rays[8];
+        uint32_t seed = 777;
+        for (int i=0;i<8;i++)
+        {
+            F c[6];
+            for (int k=0;k<6;k++)
+            {
+                seed = seed * 1103515245 + 12345;
+                c[k] = F(int32_t(seed) >> (k < 3 ? 13 : 15), 16);
+            }
+            V o(c[0], c[1], c[2]), d(V(c[3], c[4], c[5]) - o);
+            if (i == 2) d[1] = 0;
+            if (i == 5) d[0] = d[2] = 0;
+            rays[i] = R(o, d);
+        }
+        B boxes[4] = { box, B(V(-1, -1, -1), V(1, 1, 1)), B(V(-9, 0, 2), V(-1, 8, 3)), B(V(-3, -3, 0), V(0, 0, 3)) };
+        for (int n=5;n<=8;n+=3)
+        {
+            RayPacket<16,16> pk(rays, n);
+            for (int b=0;b<4;b++)
+            {
+                F ptn[8];
+                int mask = pk.intersect(boxes[b], ptn);
+                for (int i=0;i<8;i++)
+                {
+                    bool hit = intersect(rays[i], boxes[b], tn, tf) && i < n;
+                    QCOMPARE(bool(mask & (1 << i)), hit);
+                    if (hit)
+                        QCOMPARE(ptn[i], tn);
+                }
+            }
+        }
+
+        // Triangles
+        V a(0, 0, 5), b(4, 0, 5), c(0, 4, 5);
+        F t, u, v;
+        QVERIFY(intersect(R(V(1, 1, 0), V(0, 0, 1)), a, b, c, t, u, v));
+        QCOMPARE(t, F(5));
+        QCOMPARE(u, F(0.25));
+        QCOMPARE(v, F(0.25));
+        QVERIFY(intersect(R(V(1, 1, 10), V(0, 0, -2)), a, b, c, t, u, v));
+        QCOMPARE(t, F(2.5));
+        QVERIFY(!intersect(R(V(3, 3, 0), V(0, 0, 1)), a, b, c, t, u, v));
+        QVERIFY(!intersect(R(V(1, 1, 6), V(0, 0, 1)), a, b, c, t, u, v));
+        QVERIFY(!intersect(R(V(1, 1, 0), V(1, 0, 0)), a, b, c, t, u, v));
+    }
+
+    void grid(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+        enum { N = 500 };
+
+        // Some points fall outside the grid
+        V p[N];
+        uint32_t seed = 99;
+        for (int i=0;i<N;i++)
+            for (int k=0;k<3;k++)
+            {
+                seed = seed * 1103515245 + 12345;
+                p[i][k] = F(int32_t(seed) >> 12, 16);
+            }
+
+        UniformGrid<16,16> g(V(-6, -6, -6), 1, 6, 6, 6);
+        g.build(p, N);
+        QCOMPARE(g.size(), int(N));
+        checkGrid(g, p, N);
+
+        int out[3];
+        QCOMPARE(g.nearest(p[17], 1, out), 1);
+        QCOMPARE(out[0], 17);
+
+        // Move some points around
+        for (int i=0;i<N;i+=7)
+        {
+            p[i] = V(p[i][1], p[i][2] * F(0.5), p[i][0]);
+            g.update(i, p[i]);
+        }
+        g.update(3, p[3] + V(0.25, 0, 0));
+        p[3] = p[3] + V(0.25, 0, 0);
+        QVERIFY(g.moved() > 0);
+        checkGrid(g, p, N);
+
+        g.rebuild();
+        QCOMPARE(g.moved(), 0);
+        checkGrid(g, p, N);
+
+        UniformGrid<16,16> g2(V(-6, -6, -6), 1, 6, 6, 6);
+        g2.build(p, 3);
+        QCOMPARE(g2.nearest(V(), 5, out), 3);
+
+        // The results do not depend on the build history
+        V q[3] = { V(-5, -5, -5), V(5, 5, 5), V(0.5, 0.5, 0.5) };
+        g2.build(q, 3);
+        g2.update(0, V(0.25, 0.25, 0.25));
+        QCOMPARE(g2.radius(V(), F(1), out, 3), 2);
+        QCOMPARE(out[0], 0);
+        QCOMPARE(out[1], 2);
+        q[0] = V(0.25, 0.25, 0.25);
+        g2.build(q, 3);
+        QCOMPARE(g2.radius(V(), F(1), out, 3), 2);
+        QCOMPARE(out[0], 0);
+        QCOMPARE(out[1], 2);
+
+        // Distances beyond the format saturate instead of overflowing
+        V far[3] = { V(-30000, 0, 0), V(30000, 0, 0), V(-30000, -30000, -30000) };
+        UniformGrid<16,16> g3(V(-32768, -32768, -32768), 12, 16, 16, 16);
+        g3.build(far, 3);
+        QCOMPARE(g3.nearest(V(29000, 0, 0), 2, out), 2);
+        QCOMPARE(out[0], 1);
+        QCOMPARE(out[1], 0);
+        QCOMPARE(g3.nearest(V(30000, 30000, 30000), 3, out), 3);
+        QCOMPARE(out[0], 1);
+        QCOMPARE(g3.radius(V(29000, 0, 0), F(1000), out, 3), 1);
+        QCOMPARE(out[0], 1);
+    }
+
+    void predicates(void)
+    {
+        typedef Vector2D<16,16> V2;
+        typedef Vector3D<16,16> V3;
+        typedef Fract<16,16> F;
+        F ulp(1, 16);
+
+        QCOMPARE(orient2d(V2(0, 0), V2(1, 0), V2(0, 1)), 1);
+        QCOMPARE(orient2d(V2(0, 0), V2(0, 1), V2(1, 0)), -1);
+        QCOMPARE(orient2d(V2(0, 0), V2(1, 1), V2(2, 2)), 0);
+
+        // Nearly degenerate cases, at small and large magnitudes
+        F ks[3] = { F(0.001), F(3.5), F(15000.25) };
+        for (int i=0;i<3;i++)
+        {
+            F k = ks[i];
+            V2 a(k * F(-2), k * F(0.75)), b(ulp * F(3), ulp * F(-1));
+            V2 c(b + b - a);
+            QCOMPARE(orient2d(a, b, c), 0);
+            QCOMPARE(orient2d(a, b, V2(c + V2(0, ulp))), 1);
+            QCOMPARE(orient2d(a, b, V2(c - V2(0, ulp))), -1);
+
+            V3 p(k, F(0), F(0)), q(F(0), k, F(0)), r(F(0), F(0), k);
+            QCOMPARE(orient3d(p, q, r, V3(0, 0, 0)), 1);
+            QCOMPARE(orient3d(q, p, r, V3(0, 0, 0)), -1);
+            V3 s(q + r - p);
+            QCOMPARE(orient3d(p, q, r, s), 0);
+            QCOMPARE(orient3d(p, q, r, V3(s - V3(0, 0, ulp))), 1);
+            QCOMPARE(orient3d(p, q, r, V3(s + V3(0, 0, ulp))), -1);
+
+            // Cocircular points (exercises all the precision levels)
+            V2 e(k, 0), f(0, k), g(F(0) - k, 0), h(0, F(0) - k);
+            QCOMPARE(incircle(e, f, g, h), 0);
+            QCOMPARE(incircle(e, f, g, V2(h + V2(0, ulp))), 1);
+            QCOMPARE(incircle(e, f, g, V2(h - V2(0, ulp))), -1);
+            QCOMPARE(incircle(e, g, f, V2(h + V2(0, ulp))), -1);
+        }
+
+        // Convex hull of a grid, with collinear and duplicated points
+        V2 pts[26];
+        for (int i=0;i<25;i++)
+            pts[i] = V2(i % 5, i / 5);
+        pts[25] = pts[12];
+        int hull[27];
+        QCOMPARE(convexHull(pts, 26, hull), 4);
+        QCOMPARE(hull[0], 0);
+        QCOMPARE(hull[1], 4);
+        QCOMPARE(hull[2], 24);
+        QCOMPARE(hull[3], 20);
+    }
+
+    void particles(void)
+    {
+        typedef Vector3D<16,16> V;
+        typedef Fract<16,16> F;
+        typedef Vector3DArray<16,16> A;
+        enum { N = 5003 };
+
+        // Random particles, the integrator must match the Fract operations
+        std::vector<V> x(N), v(N), a(N);
+        uint32_t seed = 31;
+        for (int i=0;i<N;i++)
+            for (int k=0;k<3;k++)
+            {
+                seed = seed * 1103515245 + 12345;
+                x[i][k] = F(int32_t(seed) >> 8, 16);
+                seed = seed * 1103515245 + 12345;
+                v[i][k] = F(int32_t(seed) >> 10, 16);
+                seed = seed * 1103515245 + 12345;
+                a[i][k] = F(int32_t(seed) >> 12, 16);
+            }
+
+        F dt(0.25);
+        ParticleIntegrator<16,16> pi(dt);
+        A ax(&x[0], N), av(&v[0], N), aa(&a[0], N);
+        QCOMPARE(pi.euler(ax, av, aa), 0);
+        for (int i=0;i<N;i++)
+        {
+            V nv(v[i] + a[i] * dt);
+            QCOMPARE(av[i], nv);
+            QCOMPARE(ax[i], V(x[i] + nv * dt));
+        }
+
+        A px(&x[0], N);
+        ax = A(&x[0], N);
+        QCOMPARE(pi.verlet(ax, px, aa), 0);
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(ax[i], V(x[i] * F(2) - x[i] + a[i] * F(dt * dt)));
+            QCOMPARE(px[i], x[i]);
+        }
+
+        // Saturation at the bounds
+        ParticleIntegrator<16,16> pb(F(0.125));
+        pb.setBounds(V(-1, -1, -1), V(1, 1, 1));
+        V bx[3] = { V(0, 0, 0), V(0.99, 0, 0), V(0, -0.5, 0.5) };
+        V bv[3] = { V(1, 1, 1), V(1, 0, 0), V(0, -8, 8) };
+        A cx(bx, 3), cv(bv, 3), ca(3);
+        QCOMPARE(pb.euler(cx, cv, ca), 2);
+        QCOMPARE(cx[0], V(0.125, 0.125, 0.125));
+        QCOMPARE(cx[1], V(1, 0, 0));
+        QCOMPARE(cv[1], V(0, 0, 0));
+        QCOMPARE(cx[2], V(0, -1, 1));
+        QCOMPARE(cv[2], V(0, 0, 0));
+
+        A dx(bx, 3), dp(3);
+        QCOMPARE(pb.verlet(dx, dp, ca), 1);
+        QCOMPARE(dx[1], V(1, 0, 0));
+        QCOMPARE(dp[1], V(1, 0, 0));
+
+        // Without bounds, the format overflows
+        V ox[1] = { V(32000, 0, 0) };
+        V ov[1] = { V(16000, 0, 0) };
+        A ex(ox, 1), ev(ov, 1), ea(1);
+        OVF(pi.euler(ex, ev, ea));
+
+        // Terms at the extremes of the format, which cancel out: the scalar
+        // path (n=1) and the vectorized one (n=8) agree
+        typedef Vector3D<2,30> V2;
+        typedef Fract<2,30> F2;
+        F2 hi2(int64_t(0x7FFFFFFF), 30), lo2(-2);
+        ParticleIntegrator<2,30> p2(F2(1.5));
+        for (int n=1;n<=8;n+=7)
+        {
+            std::vector<V2> x2(n, V2(lo2, hi2, hi2)), xp2(n, V2(hi2, lo2, hi2)), a2(n, V2(hi2, lo2, 0));
+            Vector3DArray<2,30> fx(&x2[0], n), fp(&xp2[0], n), fa(&a2[0], n);
+            QCOMPARE(p2.verlet(fx, fp, fa), 0);
+            QVERIFY(F2::error(fx[n-1][0], -1.5) < 4);
+            QVERIFY(F2::error(fx[n-1][1], 1.5) < 4);
+            QCOMPARE(fx[n-1][2], hi2);
+        }
+    }
+
+    void raster(void)
+    {
+        typedef Vector2D<16,16> V;
+        typedef Fract<16,16> F;
+        enum { W = 37, H = 29, S = 40 };
+        std::vector<uint8_t> buf(S * H, 0), buf2(S * H, 0);
+
+        // Half of a 8x8 square: the pixel centers on the hypotenuse are out
+        QCOMPARE(rasterize(V(0, 0), V(8, 0), V(0, 8), &buf[0], W, H, S), 28);
+        QCOMPARE(int(buf[0]), 0xFF);
+        QCOMPARE(int(buf[6]), 0xFF);
+        QCOMPARE(int(buf[7]), 0);
+        QCOMPARE(int(buf[6*S]), 0xFF);
+        QCOMPARE(int(buf[7*S]), 0);
+        QCOMPARE(rasterize(V(0, 0), V(0, 8), V(8, 0), &buf2[0], W, H, S), 28);
+        QVERIFY(buf == buf2);
+        QCOMPARE(rasterize(V(1, 1), V(5, 5), V(9, 9), &buf[0], W, H, S), 0);
+
+        // A fan of triangles covers a convex polygon without gaps or overlaps. Some
+        // of the shared edges go exactly through pixel centers, and the polygon is
+        // partly out of the buffer.
+        V poly[7] = { V(3.5, 0.5), V(20.125, -4.5), V(40.2, 6.6), V(36, 12.5),
+                      V(15.5, 33), V(2.5, 24), V(-3.1, 11.5) };
+        V center(15.5, 12.5);
+        std::vector<int> cover(W * H, 0);
+        int total = 0;
+        for (int i=0;i<7;i++)
+        {
+            std::fill(buf.begin(), buf.end(), 0);
+            total += rasterize(center, poly[i], poly[(i+1)%7], &buf[0], W, H, S, 1);
+            for (int y=0;y<H;y++)
+            {
+                for (int x=0;x<W;x++)
+                    cover[y*W + x] += buf[y*S + x];
+                for (int x=W;x<S;x++)
+                    QCOMPARE(int(buf[y*S + x]), 0);
+            }
+        }
+
+        int covered = 0;
+        for (int y=0;y<H;y++)
+            for (int x=0;x<W;x++)
+            {
+                V p(F(x) + F(0.5), F(y) + F(0.5));
+                int minor = 1;
+                for (int i=0;i<7;i++)
+                    minor = std::min(minor, orient2d(poly[i], poly[(i+1)%7], p));
+                if (minor != 0)
+                    QCOMPARE(cover[y*W + x], minor > 0 ? 1 : 0);
+                covered += cover[y*W + x];
+            }
+        QCOMPARE(total, covered);
+    }
+};
+
+class TestArray : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Expected raw result of a FractArray operation, given the exact one
+    static int64_t fixRaw(int64_t x, int bits, FractOverflowPolicy policy)
+    {
+        int64_t hi = (int64_t(1) << (bits-1)) - 1, lo = -hi - 1;
+        if (x >= lo && x <= hi)
+            return x;
+        if (policy == FRACT_OVERFLOW_SATURATE)
+            return x < lo ? lo : hi;
+        x &= (int64_t(1) << bits) - 1;
+        return x > hi ? x - (int64_t(1) << bits) : x;
+    }
+
+    // Compare the FractArray operations with the scalar ones, under all the
+    // overflow policies. Only the first half of the inputs is small enough
+    // to never overflow.
+    template <int I, int F>
+    void checkArray(void)
+    {
+        typedef Fract<I,F> X;
+        typedef FractArray<I,F> A;
+        using detail::FractAccess;
+        enum { N = 77, H = N/2 };
+        const int64_t range = int64_t(1) << (I+F);
+
+        X xa[N], xb[N];
+        int64_t ra[N], rb[N];
+        for (int i=0;i<N;i++)
+        {
+            ra[i] = int64_t(uint64_t(i * 2654435761u) % range) - range/2;
+            rb[i] = int64_t(uint64_t((i+N) * 2246822519u) % range) - range/2;
+            if (i < H)
+            {
+                ra[i] /= int64_t(1) << (I/2 + 1);
+                rb[i] /= int64_t(1) << (I/2 + 1);
+            }
+            xa[i] = X(ra[i], F);
+            xb[i] = X(rb[i], F);
+        }
+
+        A a(xa, N), b(xb, N);
+        QCOMPARE(int(uintptr_t(a.data()) % 64), 0);
+
+        // Checked operations are the same as the scalar operators
+        A c(a);
+        NOT_OVF(c.slice(0, H).add(b.slice(0, H)));
+        for (int i=0;i<H;i++)
+            QCOMPARE(c[i], xa[i] + xb[i]);
+        for (int i=H;i<N;i++)
+            QCOMPARE(c[i], xa[i]);
+        c = a;
+        NOT_OVF(c.slice(0, H).sub(b.slice(0, H)));
+        for (int i=0;i<H;i++)
+            QCOMPARE(c[i], xa[i] - xb[i]);
+        c = a;
+        NOT_OVF(c.slice(0, H).mul(b.slice(0, H)));
+        for (int i=0;i<H;i++)
+            QCOMPARE(c[i], xa[i] * xb[i]);
+        c = a;
+        NOT_OVF(c.slice(0, H).scale(xb[3]));
+        for (int i=0;i<H;i++)
+            QCOMPARE(c[i], xa[i] * xb[3]);
+        c = a;
+        OVF(c.add(b));
+        c = a;
+        OVF(c.mul(b));
+
+        FractOverflowPolicy policies[2] = { FRACT_OVERFLOW_SATURATE, FRACT_OVERFLOW_WRAP };
+        for (int k=0;k<2;k++)
+        {
+            FractOverflowPolicy pol = policies[k];
+            A s(a), d(a), m(a), f(a);
+            s.add(b, pol);
+            d.sub(b, pol);
+            m.mul(b, pol);
+            f.scale(xb[N-1], pol);
+            for (int i=0;i<N;i++)
+            {
+                QCOMPARE(int64_t(FractAccess::raw(s[i])), fixRaw(ra[i] + rb[i], I+F, pol));
+                QCOMPARE(int64_t(FractAccess::raw(d[i])), fixRaw(ra[i] - rb[i], I+F, pol));
+                QCOMPARE(int64_t(FractAccess::raw(m[i])), fixRaw((ra[i] * rb[i]) >> F, I+F, pol));
+                QCOMPARE(int64_t(FractAccess::raw(f[i])), fixRaw((ra[i] * rb[N-1]) >> F, I+F, pol));
+            }
+        }
+
+        A lo(a), hi(a), cl(a);
+        lo.min(b);
+        hi.max(b);
+        cl.clamp(xb[5], xb[40]);
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(lo[i], std::min(xa[i], xb[i]));
+            QCOMPARE(hi[i], std::max(xa[i], xb[i]));
+            QCOMPARE(cl[i], std::min(std::max(xa[i], xb[5]), xb[40]));
+        }
+    }
+
+private slots:
+    void array(void)
+    {
+        checkArray<16,16>();
+        checkArray<8,8>();
+        checkArray<4,12>();
+    }
+
+    void array_reduce(void)
+    {
+        typedef Fract<16,16> F;
+        enum { N = 300007 };
+        FractArray<16,16> a(N);
+
+        for (int i=0;i<N;i++)
+            a[i] = F(int64_t(i * 2654435761u % 2000000000) - 1000000000, 16);
+        a[70001] = a[250003] = F(-32768);
+        a[12] = a[299999] = F(int64_t(0x7FFFFFFF), 16);
+
+        // Exact reference sum, accumulated serially
+        int64_t ref = 0;
+        for (int i=0;i<N;i++)
+            ref += detail::FractAccess::raw(a[i]);
+
+        int64_t ref5 = int64_t(detail::FractAccess::raw(a[5])) + detail::FractAccess::raw(a[6]) +
+                       detail::FractAccess::raw(a[7]);
+        QCOMPARE((sum<48,16>(a.data(), N)), (Fract<48,16>(ref, 16)));
+        QCOMPARE((sum<40,24>(a.data() + 5, 3)), (Fract<40,24>(ref5, 16)));
+        OVF((sum<16,16>(a.data(), N)));
+        QCOMPARE(min(a.data(), N), F(-32768));
+        QCOMPARE(max(a.data(), N), F(int64_t(0x7FFFFFFF), 16));
+        QCOMPARE(argmin(a.data(), N), 70001);
+        QCOMPARE(argmax(a.data(), N), 12);
+        QCOMPARE(argmax(a.data() + 13, N - 13), 299999 - 13);
+        QCOMPARE(argmin(a.data() + 70002, 5), int(std::min_element(&a[70002], &a[70007]) - &a[70002]));
+
+        int64_t q = ref / N;
+        if (q * N != ref && ref < 0)
+            --q;
+        QCOMPARE(mean(a.data(), N), F(q, 16));
+        QCOMPARE(mean(a.data() + 12, 1), a[12]);
+        a[0] = F(-1);
+        a[1] = F(int64_t(0), 16);
+        a[2] = F(int64_t(3), 16);
+        QCOMPARE(mean(a.data(), 2), F(-0.5));
+        QCOMPARE(mean(a.data() + 1, 2), F(int64_t(1), 16));
+        QCOMPARE(mean(a.data(), 3), F(int64_t(-21845), 16));
+        DOM(mean(a.data(), 0));
+    }
+
+    void array_scan(void)
+    {
+        typedef Fract<8,8> F;
+        enum { N = 200003 };
+        using detail::FractAccess;
+        FractArray<8,8> a(N);
+        FractArray<24,8> inc(N);
+        FractArray<40,8> exc(N);
+
+        std::vector<int64_t> ref(N + 1, 0);
+        for (int i=0;i<N;i++)
+        {
+            a[i] = F(int64_t(i * 2654435761u % 60000) - 29000, 8);
+            ref[i+1] = ref[i] + FractAccess::raw(a[i]);
+        }
+
+        // Widened outputs
+        NOT_OVF(inclusive_scan(a.data(), inc.data(), N));
+        NOT_OVF(exclusive_scan(a.data(), exc.data(), N));
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(int64_t(FractAccess::raw(inc[i])), ref[i+1]);
+            QCOMPARE(int64_t(FractAccess::raw(exc[i])), ref[i]);
+        }
+
+        // In place, wrapping around with a sticky overflow flag
+        FractArray<8,8> b(a);
+        bool overflow = false;
+        inclusive_scan(b.data(), b.data(), N, &overflow);
+        QVERIFY(overflow);
+        for (int i=0;i<N;i++)
+            QCOMPARE(int64_t(FractAccess::raw(b[i])), int64_t(int16_t(ref[i+1])));
+        inclusive_scan(a.data(), inc.data(), 10, &overflow);
+        QVERIFY(overflow);
+        overflow = false;
+        exclusive_scan(a.data(), b.data(), 10, &overflow);
+        QVERIFY(!overflow);
+        QCOMPARE(b[0], F(0));
+        QCOMPARE(b[9], F(ref[9], 8));
+        OVF(inclusive_scan(a.data(), b.data(), N));
+
+        // The last element of an exclusive scan may not fit, it is not stored
+        a[0] = F(100);
+        a[1] = F(100);
+        NOT_OVF(exclusive_scan(a.data(), b.data(), 2));
+        OVF(inclusive_scan(a.data(), b.data(), 2));
+    }
+
+    void array_convert(void)
+    {
+        typedef Fract<16,16> F;
+        typedef Fract<4,4> Q;
+        typedef Fract<8,24> G;
+        enum { N = 1003 };
+        FractArray<16,16> a(N);
+        for (int i=0;i<N;i++)
+            a[i] = F(int64_t(i * 2654435761u % 4000000) - 2000000, 8 + i % 12);
+
+        // Same results as the conversion constructor, saturated where it overflows
+        int overflows;
+        FractArray<4,4> q = convert<4,4>(a, &overflows);
+        FractArray<8,24> g(N);
+        int goverflows = convert(a.data(), g.data(), N);
+        int count = 0, gcount = 0;
+        for (int i=0;i<N;i++)
+        {
+            Q qr;
+            G gr;
+            try { qr = Q(a[i]); }
+            catch (FractOverflowError&) { qr = (a[i] < F(0)) ? Q(-8) : Q(int64_t(0x7F), 4); count++; }
+            try { gr = G(a[i]); }
+            catch (FractOverflowError&) { gr = (a[i] < F(0)) ? G(-128) : G(int64_t(0x7FFFFFFF), 24); gcount++; }
+            QCOMPARE(q[i], qr);
+            QCOMPARE(g[i], gr);
+        }
+        QCOMPARE(overflows, count);
+        QCOMPARE(goverflows, gcount);
+        QVERIFY(count > 0 && count < N);
+        QVERIFY(gcount > 0 && gcount < N);
+
+        // Widening never saturates
+        FractArray<32,32> w = convert<32,32>(a, &overflows);
+        QCOMPARE(overflows, 0);
+        FractArray<16,16> back = convert<16,16>(convert<8,8>(q));
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(w[i], (Fract<32,32>(a[i])));
+            QCOMPARE(back[i], F(q[i]));
+        }
+    }
+
+    void array_dispatch(void)
+    {
+        typedef Fract<16,16> F;
+        enum { N = 517 };
+        QVERIFY(fract_isa() <= detail::Dispatch::detect());
+        QCOMPARE(QString(fract_isa_name(FRACT_ISA_AVX2)), QString("avx2"));
+
+        // FRACT_ISA can only lower the detected level
+        FractIsa best = detail::Dispatch::detect();
+        QCOMPARE(detail::Dispatch::select(NULL), best);
+        QCOMPARE(detail::Dispatch::select("generic"), FRACT_ISA_GENERIC);
+        QCOMPARE(detail::Dispatch::select("sse4.2"), std::min(best, FRACT_ISA_SSE42));
+        QCOMPARE(detail::Dispatch::select("avx512"), best);
+        QCOMPARE(detail::Dispatch::select("unknown"), best);
+        QCOMPARE(detail::Dispatch::select(""), best);
+
+        int32_t a[N], r[N], q[N];
+        for (int i=0;i<N;i++)
+            a[i] = int32_t(i * 2654435761u) >> (i % 24);    // a[0] is zero
+
+        // Every level supported by the CPU gives the results of the scalar
+        // functions, bit by bit
+        for (int isa=0; isa<=detail::Dispatch::detect(); isa++)
+        {
+            const detail::DispatchTable& t = detail::Dispatch::table(FractIsa(isa));
+            QCOMPARE(t.reciprocal(r, a, N, 16, 32),
+                     int(detail::FRACT_KERNEL_OVERFLOW | detail::FRACT_KERNEL_DOMAIN));
+            for (int i=1;i<N;i++)
+            {
+                F x(a[i], 16), y;
+                bool ovf = false;
+                try { y = F(reciprocal(x)); }
+                catch (FractOverflowError&) { ovf = true; }
+                int32_t one;
+                QCOMPARE(t.reciprocal(&one, &a[i], 1, 16, 32) != 0, ovf);
+                if (!ovf)
+                    QCOMPARE(F(r[i], 16), y);
+            }
+
+            // Other formats, at the extremes of the range
+            int32_t e[8] = { 1, -1, 3, -3, 0x7FFFFFFF, INT32_MIN, 1 << 30, -(1 << 30) };
+            for (int i=0;i<8;i++)
+            {
+                typedef Fract<2,30> G;
+                G x(e[i], 30), y;
+                bool ovf = false;
+                try { y = G(reciprocal(x)); }
+                catch (FractOverflowError&) { ovf = true; }
+                QCOMPARE(t.reciprocal(r, &e[i], 1, 30, 32) != 0, ovf);
+                if (!ovf)
+                    QCOMPARE(G(r[0], 30), y);
+            }
+
+            for (int i=0;i<N;i++)
+                q[i] = a[i] & 0x7FFFFFFF;
+            QCOMPARE(t.sqrt(r, q, N, 16), 0);
+            for (int i=0;i<N;i++)
+            {
+                int64_t v = int64_t(q[i]) << 16, s = r[i];
+                QVERIFY(s * s <= v && (s + 1) * (s + 1) > v);
+            }
+        }
+
+        // Array entry points, with the errors of the scalar functions
+        F b[4] = { F(3), F(-0.25), F(100), F(1, 4) };
+        F rb[4], sb[4];
+        NOT_OVF(reciprocal(b, rb, 4));
+        QCOMPARE(rb[0], F(reciprocal(b[0])));
+        QCOMPARE(rb[1], F(-4));
+        QCOMPARE(rb[1], F(reciprocal(b[1])));
+        QCOMPARE(rb[2], F(reciprocal(b[2])));
+        QCOMPARE(rb[3], F(16));
+        b[1] = F(0.5);
+        sqrt(b, sb, 4);
+        for (int i=0;i<4;i++)
+            QCOMPARE(sb[i], sqrt(b[i]));
+
+        b[2] = F(0);
+        DOM(reciprocal(b, rb, 4));
+        b[2] = F(1, 16);
+        OVF(reciprocal(b, rb, 4));
+        b[2] = F(-1);
+        DOM(sqrt(b, sb, 4));
+    }
+
+    void array_sort(void)
+    {
+        typedef Fract<16,16> F;
+        typedef Fract<1,15> Q;
+        enum { N = 200003 };
+
+        // The keys have the order of the values, also across the sign
+        F k[5] = { F(-32768), F(-1, 16), F(0), F(1, 16), F(int64_t(0x7FFFFFFF), 16) };
+        for (int i=0;i<5;i++)
+        {
+            QCOMPARE((from_sort_key<16,16>(sort_key(k[i]))), k[i]);
+            if (i > 0)
+                QVERIFY(sort_key(k[i-1]) < sort_key(k[i]));
+        }
+        QCOMPARE(sort_key(Q(-1)), uint32_t(0));
+        QCOMPARE(sort_key(Q(0)), uint32_t(0x8000));
+
+        // Same order as std::sort, over several chunks
+        std::vector<F> a(N), ref;
+        for (int i=0;i<N;i++)
+            a[i] = F(int64_t(int32_t(i * 2654435761u)) >> (i % 17), 16);
+        ref = a;
+        std::sort(ref.begin(), ref.end());
+        radix_sort(&a[0], N);
+        QVERIFY(a == ref);
+
+        // Pairs are sorted stably, and passes over equal digits are skipped
+        std::vector<Q> b(N);
+        std::vector<int> idx(N);
+        std::vector<std::pair<Q,int> > pref(N);
+        for (int i=0;i<N;i++)
+        {
+            b[i] = Q(int64_t(int16_t(i * 40503u)) & ~0xFF, 15);
+            idx[i] = i;
+            pref[i] = std::make_pair(b[i], i);
+        }
+        std::sort(pref.begin(), pref.end());    // ties ordered by index, like a stable sort
+        radix_sort(&b[0], &idx[0], N);
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(b[i], pref[i].first);
+            QCOMPARE(idx[i], pref[i].second);
+        }
+
+        Fract<4,4> c[6] = { 3, -8, 0.5, -0.0625, 7.9375, 0 };
+        radix_sort(c, 6);
+        for (int i=1;i<6;i++)
+            QVERIFY(!(c[i] < c[i-1]));
+        QCOMPARE(c[0], (Fract<4,4>(-8)));
+        QCOMPARE(c[5], (Fract<4,4>(7.9375)));
+    }
+
+    void array_histogram(void)
+    {
+        typedef Fract<16,16> F;
+        enum { N = 100003, B = 37 };
+        FractArray<16,16> a(N);
+        for (int i=0;i<N;i++)
+            a[i] = F(int64_t(int32_t(i * 2654435761u)) >> (i % 13), 16);
+
+        // Power of two and arbitrary widths, against the exact bins of the
+        // raw values (also with bins that extend past the range of the format)
+        const F lo[4] = { F(-5000), F(-3.5), F(int64_t(INT32_MIN), 16), F(100) };
+        const F width[4] = { F(256), F(0.3), F(int64_t(0x7FFFFFFF), 16), F(1, 16) };
+        for (int c=0;c<4;c++)
+        {
+            int counts[B], ref[B] = { 0 }, refout = 0;
+            int out = histogram(a.data(), N, lo[c], width[c], counts, B);
+            for (int i=0;i<N;i++)
+            {
+                int64_t d = int64_t(detail::FractAccess::raw(a[i])) - detail::FractAccess::raw(lo[c]);
+                int64_t k = (d < 0) ? B : d / int64_t(uint32_t(detail::FractAccess::raw(width[c])));
+                if (k < B)
+                    ref[k]++;
+                else
+                    refout++;
+            }
+            QCOMPARE(out, refout);
+            for (int k=0;k<B;k++)
+                QCOMPARE(counts[k], ref[k]);
+        }
+
+        // Small formats, and the edges of the bins
+        Fract<4,4> q[6] = { -8, -0.0625, 0, 0.5, 0.75, 7.9375 };
+        int qc[4];
+        QCOMPARE(histogram(q, 6, Fract<4,4>(-0.5), Fract<4,4>(0.5), qc, 4), 2);
+        QCOMPARE(qc[0], 1);
+        QCOMPARE(qc[1], 1);
+        QCOMPARE(qc[2], 2);
+        QCOMPARE(qc[3], 0);
+        DOM(histogram(q, 6, Fract<4,4>(0), Fract<4,4>(0), qc, 4));
+    }
+
+    void array_dot(void)
+    {
+        typedef Fract<16,16> F;
+        typedef Fract<32,32> F2;
+        typedef Fract<1,15> Q;
+        typedef Fract<34,30> Q2;
+        enum { N = 1003 };
+        FractArray<16,16> a(N), b(N);
+        FractArray<1,15> qa(N), qb(N);
+
+        F2 ref = 0;
+        Q2 qref;
+        for (int i=0;i<N;i++)
+        {
+            a[i] = F(int64_t(i * 2654435761u % 4000000) - 2000000, 16);
+            b[i] = F(int64_t(i * 2246822519u % 4000000) - 2000000, 16);
+            ref += F2(a[i]) * F2(b[i]);
+            qa[i] = Q(int64_t(i * 2654435761u % 65536) - 32768, 15);
+            qb[i] = Q(int64_t(i * 2246822519u % 65536) - 32768, 15);
+            qref += Q2(int64_t(detail::FractAccess::raw(qa[i])) * detail::FractAccess::raw(qb[i]), 30);
+        }
+
+        // Exact, and rounded once
+        QCOMPARE((dot<32,32>(a.data(), b.data(), N)), ref);
+        QCOMPARE((a.dot<32,32>(b)), ref);
+        QCOMPARE((dot<16,16>(a.data(), b.data(), N)), F(ref));
+        QCOMPARE((dot<34,30>(qa.data(), qb.data(), N)), qref);
+        QCOMPARE((qa.dot<12,20>(qb)), (Fract<12,20>(qref)));
+        QCOMPARE((dot<16,16>(a.data(), b.data(), 0)), F(0));
+
+        // Intermediate sums may overflow, as long as the result fits
+        for (int i=0;i<24;i++)
+        {
+            a[i] = F(-32768);
+            b[i] = (i < 12) ? F(-32768) : F(int64_t(0x7FFFFFFF), 16);
+        }
+        for (int n=4;n<=24;n+=20)
+        {
+            F2 r;
+            NOT_OVF(r = (dot<32,32>(a.data() + 12 - n/2, b.data() + 12 - n/2, n)));
+            QCOMPARE(r, F2(n/2) * F2(0.5));
+        }
+        OVF((dot<32,32>(a.data(), b.data(), 12)));
+        NOT_OVF((dot<32,32>(a.data(), b.data(), 1)));
+    }
+};
+
+class TestLinalg : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void gemm(void)
+    {
+        typedef Fract<16,16> F;
+        typedef Fract<8,24> G;
+        using detail::FractAccess;
+        enum { M = 67, N = 301, K = 517 };
+        std::vector<F> a(M*K), b(K*N), c(M*N);
+        std::vector<G> ga(M*K), gb(K*N), gc(M*N);
+
+        for (int i=0;i<M*K;i++)
+        {
+            a[i] = F(int64_t(i * 2654435761u % 4000000) - 2000000, 16);
+            ga[i] = G(int64_t(i * 2654435761u % 4000000) - 2000000, 24);
+        }
+        for (int i=0;i<K*N;i++)
+        {
+            b[i] = F(int64_t(i * 2246822519u % 4000000) - 2000000, 16);
+            gb[i] = G(int64_t(i * 2246822519u % 4000000) - 2000000, 24);
+        }
+
+        // Exact, and rounded once (same as the Matrix product)
+        NOT_OVF(::gemm(M, N, K, &a[0], K, &b[0], N, &c[0], N));
+        NOT_OVF(::gemm(M, N, K, &ga[0], K, &gb[0], N, &gc[0], N));
+        for (int i=0;i<M;i++)
+            for (int j=0;j<N;j++)
+            {
+                int64_t ref = 0, gref = 0;
+                for (int p=0;p<K;p++)
+                {
+                    ref += int64_t(FractAccess::raw(a[i*K + p])) * FractAccess::raw(b[p*N + j]);
+                    gref += int64_t(FractAccess::raw(ga[i*K + p])) * FractAccess::raw(gb[p*N + j]);
+                }
+                QCOMPARE(c[i*N + j], F(ref, 32));
+                QCOMPARE(gc[i*N + j], G(gref, 48));
+            }
+
+        Matrix3x3<16,16> ma, mb;
+        for (int i=0;i<3;i++)
+            for (int j=0;j<3;j++)
+            {
+                ma(i, j) = a[i*K + j];
+                mb(i, j) = b[i*N + j];
+            }
+        Matrix3x3<16,16> mc = ma * mb;
+        ::gemm(3, 3, 3, &a[0], K, &b[0], N, &c[0], N);
+        for (int i=0;i<3;i++)
+            for (int j=0;j<3;j++)
+                QCOMPARE(c[i*N + j], mc(i, j));
+
+        // Intermediate sums may overflow, as long as the result fits
+        for (int p=0;p<4;p++)
+        {
+            a[p] = F(-32768);
+            b[p*N] = (p < 2) ? F(-32768) : F(int64_t(0x7FFFFFFF), 16);
+        }
+        NOT_OVF(::gemm(1, 1, 4, &a[0], K, &b[0], N, &c[0], N));
+        QCOMPARE(c[0], F(1));
+        OVF(::gemm(1, 1, 2, &a[0], K, &b[0], N, &c[0], N));
+        std::fill(a.begin(), a.end(), F(100));
+        std::fill(b.begin(), b.end(), F(100));
+        OVF(::gemm(M, N, K, &a[0], K, &b[0], N, &c[0], N));
+    }
+
+    void qgemm(void)
+    {
+        typedef Fract<1,7> Q7;
+        typedef Fract<1,15> Q15;
+        typedef Fract<16,16> F;
+        using detail::FractAccess;
+        enum { M = 37, N = 61, K = 517 };
+        std::vector<Q7> a(M*K), b(K*N), x(K);
+        std::vector<Q15> qa(M*K), qb(K*N), qx(K);
+        std::vector<F> c(M*N), qc(M*N), y(M), qy(M), scale(M);
+
+        for (int i=0;i<M*K;i++)
+        {
+            a[i] = FractAccess::gen<1,7>(int(i * 2654435761u % 256) - 128);
+            qa[i] = FractAccess::gen<1,15>(int(i * 2654435761u % 65536) - 32768);
+        }
+        for (int i=0;i<K*N;i++)
+        {
+            b[i] = FractAccess::gen<1,7>(int(i * 2246822519u % 256) - 128);
+            qb[i] = FractAccess::gen<1,15>(int(i * 2246822519u % 65536) - 32768);
+        }
+        for (int p=0;p<K;p++)
+        {
+            x[p] = b[p*N];
+            qx[p] = qb[p*N];
+        }
+        for (int i=0;i<M;i++)
+            scale[i] = F(int64_t(i * 40503) - 700000, 16);
+
+        // Exact sums, scaled once and rounded toward minus infinity
+        NOT_OVF(::qgemm(M, N, K, &a[0], K, &b[0], N, &c[0], N, &scale[0]));
+        NOT_OVF(::qgemm(M, N, K, &qa[0], K, &qb[0], N, &qc[0], N, &scale[0]));
+        NOT_OVF(::qgemv(M, K, &a[0], K, &x[0], &y[0], &scale[0]));
+        NOT_OVF(::qgemv(M, K, &qa[0], K, &qx[0], &qy[0], &scale[0]));
+        for (int i=0;i<M;i++)
+            for (int j=0;j<N;j++)
+            {
+                int64_t ref = 0, qref = 0;
+                for (int p=0;p<K;p++)
+                {
+                    ref += FractAccess::raw(a[i*K + p]) * FractAccess::raw(b[p*N + j]);
+                    qref += int64_t(FractAccess::raw(qa[i*K + p])) * FractAccess::raw(qb[p*N + j]);
+                }
+                QCOMPARE(c[i*N + j], F(ref * FractAccess::raw(scale[i]), 14 + 16));
+                QCOMPARE(qc[i*N + j], F(qref * FractAccess::raw(scale[i]), 30 + 16));
+                if (j == 0)
+                {
+                    QCOMPARE(y[i], c[i*N]);
+                    QCOMPARE(qy[i], qc[i*N]);
+                }
+            }
+
+        // Q15 x Q15 -> Q31, where only -1 * -1 does not fit
+        Q15 m1 = Q15(-1), h = Q15(0.5);
+        Fract<1,31> r;
+        ::qgemm(1, 1, 1, &m1, 1, &h, 1, &r, 1);
+        QCOMPARE(FractAccess::raw(r), int32_t(-0x40000000));
+        OVF(::qgemm(1, 1, 1, &m1, 1, &m1, 1, &r, 1));
+        ::qgemv(1, 1, &m1, 1, &m1, &r, FRACT_OVERFLOW_SATURATE);
+        QCOMPARE(FractAccess::raw(r), int32_t(0x7FFFFFFF));
+        ::qgemv(1, 1, &m1, 1, &m1, &r, FRACT_OVERFLOW_WRAP);
+        QCOMPARE(FractAccess::raw(r), int32_t(-0x7FFFFFFF - 1));
+
+        // Long sums of the largest products do not overflow the accumulators
+        std::vector<Q15> ones(40000, m1);
+        Fract<24,8> big;
+        ::qgemv(1, 40000, &ones[0], 40000, &ones[0], &big);
+        QCOMPARE(big, (Fract<24,8>(40000)));
+    }
+};
+
+class TestSignal : public QObject
+{
+    Q_OBJECT
+
+private:
+    static BiquadCoeffs lowpass(double fc, double q)
+    {
+        // RBJ cookbook low-pass, normalized by a0
+        double w = 2 * M_PI * fc, alpha = sin(w) / (2 * q), a0 = 1 + alpha;
+        BiquadCoeffs c = { (1 - cos(w)) / 2 / a0, (1 - cos(w)) / a0, (1 - cos(w)) / 2 / a0,
+                           -2 * cos(w) / a0, (1 - alpha) / a0 };
+        return c;
+    }
+
+    static double soft_clip(double x) { return tanh(x); }
+    static double gamma_curve(double x) { return x > 0 ? pow(x, 1 / 2.2) : 0; }
+    static double identity(double x) { return x; }
+
+private slots:
+    void fir(void)
+    {
+        typedef Fract<16,16> F;
+        enum { N = 3001, T = 37 };
+        std::vector<F> h(T), x(N), y(N);
+        for (int k=0;k<T;k++)
+            h[k] = F(int64_t(int32_t(k * 2654435761u)) >> 14, 16);
+        for (int i=0;i<N;i++)
+            x[i] = F(int64_t(int32_t(i * 2246822519u)) >> 10, 16);
+
+        // Exact sums rounded once, also across pieces and blocks
+        FirFilter<16,16> f(&h[0], T);
+        const int piece[4] = { 700, 1, 1500, 800 };
+        for (int i=0, c=0; i<N; i+=piece[c++])
+            f.process(&x[i], &y[i], std::min(int(piece[c]), N - i));
+        for (int i=0;i<N;i++)
+        {
+            int64_t acc = 0;
+            for (int k=0;k<T && k<=i;k++)
+                acc += int64_t(detail::FractAccess::raw(h[k])) * detail::FractAccess::raw(x[i-k]);
+            QCOMPARE(detail::FractAccess::raw(y[i]), int32_t(acc >> 16));
+        }
+
+        // Decimation keeps every factor-th output; interpolation filters the
+        // input with zeros in between
+        FirDecimator<16,16> d(&h[0], T, 3);
+        std::vector<F> yd(N);
+        int nd = d.process(&x[0], &yd[0], 1000);
+        nd += d.process(&x[1000], &yd[nd], N - 1000);
+        QCOMPARE(nd, (N + 2) / 3);
+        for (int i=0;i<nd;i++)
+            QCOMPARE(yd[i], y[i*3]);
+
+        FirInterpolator<16,16> up(&h[0], T, 4);
+        FirFilter<16,16> ref(&h[0], T);
+        std::vector<F> yu(4*N), xz(4*N), yz(4*N);
+        up.process(&x[0], &yu[0], 1200);
+        up.process(&x[1200], &yu[4*1200], N - 1200);
+        for (int i=0;i<N;i++)
+            xz[4*i] = x[i];
+        ref.process(&xz[0], &yz[0], 4*N);
+        QVERIFY(yu == yz);
+
+        // Overflow policies on the outputs, and taps too large for the accumulator
+        F big[2] = { F(20000), F(20000) }, in[2] = { F(2), F(-2) }, out[2];
+        typedef FirFilter<16,16> Fir;
+        typedef FirFilter<4,4> QFir;
+        OVF(Fir(big, 2).process(in, out, 2));
+        Fir(big, 2, FRACT_OVERFLOW_SATURATE).process(in, out, 2);
+        QCOMPARE(out[0], F(int64_t(0x7FFFFFFF), 16));
+        QCOMPARE(out[1], F(0));
+        big[0] = big[1] = F(-32768);
+        OVF(Fir(big, 2));
+        Fract<4,4> q[2] = { 7.5, -7.5 }, qx[3] = { -8, 7.9375, 1 }, qy[3];
+        QFir(q, 2, FRACT_OVERFLOW_SATURATE).process(qx, qy, 3);
+        QCOMPARE(qy[0], (Fract<4,4>(-8)));
+        QCOMPARE(qy[1], (Fract<4,4>(7.9375)));
+        QCOMPARE(qy[2], (Fract<4,4>(-8)));
+        q[0] = q[1] = -8;
+        OVF(QFir(q, 2));
+    }
+
+    void biquad(void)
+    {
+        typedef Fract<16,16> F;
+        BiquadCoeffs lp[2] = { lowpass(0.01, 0.54), lowpass(0.01, 1.31) };
+
+        // a1 is close to -2: the best format has two integer bits, and more
+        // bits move the poles less
+        BiquadQuantization q16 = biquad_quantize(lp, 2, 16), q10 = biquad_quantize(lp, 2, 10);
+        QCOMPARE(q16.frac, 14);
+        QCOMPARE(q10.frac, 8);
+        QVERIFY(q16.pole_shift < q10.pole_shift);
+        QVERIFY(q16.pole_shift < 0.01 && q16.pole_radius < 1);
+        int64_t raw[10];
+        biquad_quantize(lp, 2, 16, raw);
+        QCOMPARE(raw[3], int64_t(floor(lp[0].a1 * 16384 + 0.5)));
+        BiquadCoeffs huge = { 1e6, 0, 0, 0, 0 };
+        DOM(biquad_quantize(&huge, 1, 16));
+
+        // Interleaved channels give the same results as separate ones, in
+        // both forms and with error feedback, close to the exact filter
+        enum { N = 2000, C = 6 };
+        std::vector<F> x(N*C), y(N*C), xc(N), yc(N);
+        for (int i=0;i<N*C;i++)
+            x[i] = F(int64_t(int32_t(i * 2654435761u)) >> 12, 16);
+        for (int form=0; form<2; form++)
+            for (int ef=0; ef<2; ef++)
+            {
+                BiquadCascade<16,16> f(lp, 2, C, BiquadForm(form), ef);
+                QCOMPARE(f.quantization().bits, int(BiquadCascade<16,16>::COEFF_BITS));
+                f.process(&x[0], &y[0], 700);
+                f.process(&x[700*C], &y[700*C], N - 700);
+                for (int c=0;c<C;c++)
+                {
+                    BiquadCascade<16,16> g(lp, 2, 1, BiquadForm(form), ef);
+                    for (int i=0;i<N;i++)
+                        xc[i] = x[i*C + c];
+                    g.process(&xc[0], &yc[0], N);
+
+                    double s1[2] = { 0 }, s2[2] = { 0 }, err = 0;
+                    for (int i=0;i<N;i++)
+                    {
+                        QCOMPARE(y[i*C + c], yc[i]);
+                        double v = xc[i].toDouble();
+                        for (int k=0;k<2;k++)
+                        {
+                            double o = lp[k].b0 * v + s1[k];
+                            s1[k] = lp[k].b1 * v - lp[k].a1 * o + s2[k];
+                            s2[k] = lp[k].b2 * v - lp[k].a2 * o;
+                            v = o;
+                        }
+                        err = std::max(err, fabs(v - yc[i].toDouble()));
+                    }
+                    QVERIFY(err < 0.01);
+                }
+            }
+
+        // Error feedback lowers the noise of a narrow format
+        enum { M = 20000 };
+        std::vector<Fract<1,15> > u(M), w(M);
+        double e2[2];
+        for (int ef=0; ef<2; ef++)
+        {
+            BiquadCascade<1,15> f(lp, 2, 1, BIQUAD_DF1, ef);
+            for (int i=0;i<M;i++)
+                u[i] = Fract<1,15>(0.3 + 0.2 * sin(i * 0.001));
+            f.process(&u[0], &w[0], M);
+            double s1[2] = { 0 }, s2[2] = { 0 };
+            e2[ef] = 0;
+            for (int i=0;i<M;i++)
+            {
+                double v = u[i].toDouble();
+                for (int k=0;k<2;k++)
+                {
+                    double o = lp[k].b0 * v + s1[k];
+                    s1[k] = lp[k].b1 * v - lp[k].a1 * o + s2[k];
+                    s2[k] = lp[k].b2 * v - lp[k].a2 * o;
+                    v = o;
+                }
+                e2[ef] += (v - w[i].toDouble()) * (v - w[i].toDouble());
+            }
+        }
+        QVERIFY(e2[1] < e2[0] / 4);
+
+        // Outputs which do not fit follow the policy
+        BiquadCoeffs gain = { 4, 0, 0, 0, 0 };
+        Fract<1,15> in[2] = { 0.5, -0.5 }, out[2];
+        typedef BiquadCascade<1,15> Q15Cascade;
+        OVF(Q15Cascade(&gain, 1).process(in, out, 2));
+        Q15Cascade(&gain, 1, 1, BIQUAD_DF1, false, FRACT_OVERFLOW_SATURATE).process(in, out, 2);
+        QCOMPARE(out[0], (Fract<1,15>(int64_t(0x7FFF), 15)));
+        QCOMPARE(out[1], (Fract<1,15>(-1)));
+    }
+
+    void fft(void)
+    {
+        typedef Fract<1,15> F;
+        typedef FractFFT<1,15> FFT;
+        DOM(FFT(12));
+        DOM(FFT(1));
+
+        // Full-scale noise against a DFT in double, at all the sizes (odd and
+        // even numbers of stages, scalar and vector butterflies): the results
+        // are within one unit of the output, and the inverse transforms give
+        // back the input within the precision of the spectrum
+        for (int n=2;n<=1024;n*=2)
+        {
+            FFT plan(n);
+            QCOMPARE(plan.size(), n);
+            std::vector<F> x(n), y(n), re(n), im(n), xr(n/2+1), xi(n/2+1);
+            for (int i=0;i<n;i++)
+            {
+                re[i] = x[i] = F(int64_t(int16_t((i * 2654435761u) >> 16)), 15);
+                im[i] = y[i] = F(int64_t(int16_t(i * 40503u + n)), 15);
+            }
+
+            int e = plan.forward(&re[0], &im[0]);
+            int er = plan.forward_real(&x[0], &xr[0], &xi[0]);
+            QVERIFY(e >= 0 && e <= AnyInt::Log2Ceil(n));
+            double err = 0, rerr = 0;
+            for (int k=0;k<n;k++)
+            {
+                double dr = 0, di = 0, xc = 0, xs = 0;
+                for (int j=0;j<n;j++)
+                {
+                    double t = -2 * M_PI * ((j * k) % n) / n;
+                    dr += x[j].toDouble() * cos(t) - y[j].toDouble() * sin(t);
+                    di += x[j].toDouble() * sin(t) + y[j].toDouble() * cos(t);
+                    xc += x[j].toDouble() * cos(t);
+                    xs += x[j].toDouble() * sin(t);
+                }
+                err = std::max(err, fabs(ldexp(re[k].toDouble(), e) - dr));
+                err = std::max(err, fabs(ldexp(im[k].toDouble(), e) - di));
+                if (k <= n/2)
+                {
+                    rerr = std::max(rerr, fabs(ldexp(xr[k].toDouble(), er) - xc));
+                    rerr = std::max(rerr, fabs(ldexp(xi[k].toDouble(), er) - xs));
+                }
+            }
+            QVERIFY(err <= ldexp(1.0, e - 15));
+            QVERIFY(rerr <= ldexp(1.0, er - 15));
+
+            std::vector<F> z(n);
+            QCOMPARE(plan.inverse(&re[0], &im[0]) + e, 0);
+            QCOMPARE(plan.inverse_real(&xr[0], &xi[0], &z[0]) + er, 0);
+            double ierr = 0;
+            for (int i=0;i<n;i++)
+            {
+                ierr = std::max(ierr, fabs(re[i].toDouble() - x[i].toDouble()));
+                ierr = std::max(ierr, fabs(im[i].toDouble() - y[i].toDouble()));
+                ierr = std::max(ierr, fabs(z[i].toDouble() - x[i].toDouble()));
+            }
+            QVERIFY(ierr <= ldexp(1.0, e - 15));
+        }
+
+        // A constant goes exactly into the first bin, and the output is
+        // normalized to the whole format
+        typedef Fract<16,16> G;
+        FractFFT<16,16> plan(64);
+        std::vector<G> re(64, G(-3.75)), im(64, G(0.5)), x(64, G(-3.75)), xr(33), xi(33);
+        int e = plan.forward(&re[0], &im[0]);
+        QCOMPARE(e, -7);
+        QCOMPARE(re[0], G(-3.75 * 64 * 128));
+        QCOMPARE(im[0], G(0.5 * 64 * 128));
+        QCOMPARE(plan.forward_real(&x[0], &xr[0], &xi[0]), -7);
+        QCOMPARE(xr[0], G(-3.75 * 64 * 128));
+        for (int k=1;k<64;k++)
+        {
+            QCOMPARE(re[k], G(0));
+            QCOMPARE(im[k], G(0));
+            if (k <= 32)
+                QCOMPARE(xr[k], G(0));
+        }
+        e += plan.inverse(&re[0], &im[0]);
+        QCOMPARE(e, -13);
+        QCOMPARE(ldexp(re[17].toDouble(), e), -3.75);
+        QCOMPARE(ldexp(im[17].toDouble(), e), 0.5);
+
+        // Zero stays zero, without scaling
+        std::fill(re.begin(), re.end(), G(0));
+        std::fill(im.begin(), im.end(), G(0));
+        QCOMPARE(plan.forward(&re[0], &im[0]), 0);
+        QCOMPARE(re[5], G(0));
+    }
+
+    void cordic(void)
+    {
+        // Within about one unit of the exact functions, for formats computed
+        // with int32_t and with int64_t
+        typedef Fract<4,12> F;
+        typedef Cordic<4,12> C;
+        typedef Cordic<16,16> C2;
+        const double ulp = 1.0 / 4096;
+        enum { N = 1000 };
+        std::vector<F> z(N), s(N), c(N), x(N), y(N), r(N), p(N);
+        for (int i=0;i<N;i++)
+        {
+            z[i] = F(int64_t(i * 64 - 32000), 12);
+            C::sincos(z[i], s[i], c[i]);
+            double t = z[i].toDouble();
+            QVERIFY(fabs(s[i].toDouble() - sin(t)) <= ulp);
+            QVERIFY(fabs(c[i].toDouble() - cos(t)) <= ulp);
+
+            Fract<16,16> a(int64_t(i - 500) * 1000, 16), s2, c2, r2, p2;
+            C2::sincos(a, s2, c2);
+            QVERIFY(fabs(s2.toDouble() - sin(a.toDouble())) <= 1.0 / 65536);
+            C2::polar(c2 * Fract<16,16>(300), s2 * Fract<16,16>(300), r2, p2);
+            QVERIFY(fabs(r2.toDouble() - 300 * hypot(c2.toDouble(), s2.toDouble())) <= 1.0 / 65536);
+            QVERIFY(fabs(p2.toDouble() - atan2(s2.toDouble(), c2.toDouble())) <= 1.0 / 65536);
+
+            x[i] = F(int64_t(i * 37 % 2000 - 1000) * 3, 12);
+            y[i] = F(int64_t(i * 53 % 2000 - 1000) * 3, 12);
+            F xr = x[i], yr = y[i];
+            C::rotate(xr, yr, z[i]);
+            double xd = x[i].toDouble(), yd = y[i].toDouble();
+            QVERIFY(fabs(xr.toDouble() - (xd * cos(t) - yd * sin(t))) <= ulp);
+            QVERIFY(fabs(yr.toDouble() - (xd * sin(t) + yd * cos(t))) <= ulp);
+            C::polar(x[i], y[i], r[i], p[i]);
+            QVERIFY(fabs(r[i].toDouble() - hypot(xd, yd)) <= ulp);
+            QVERIFY(fabs(p[i].toDouble() - atan2(yd, xd)) <= ulp);
+
+            F h(int64_t(i * 17 - 8500), 12), sh, ch;
+            C::sinhcosh(h, sh, ch);
+            QVERIFY(fabs(sh.toDouble() - sinh(h.toDouble())) <= 2 * ulp);
+            QVERIFY(fabs(ch.toDouble() - cosh(h.toDouble())) <= 2 * ulp);
+        }
+
+        // The arrays give the same results as the scalar functions
+        std::vector<F> s1(N), c1(N), r1(N), p1(N);
+        C::sincos(&z[0], &s1[0], &c1[0], N);
+        C::polar(&x[0], &y[0], &r1[0], &p1[0], N);
+        for (int i=0;i<N;i++)
+        {
+            QCOMPARE(s1[i], s[i]);
+            QCOMPARE(c1[i], c[i]);
+            QCOMPARE(r1[i], r[i]);
+            QCOMPARE(p1[i], p[i]);
+        }
+
+        // Results which do not fit follow the policy
+        typedef Fract<1,15> Q;
+        Q qs, qc;
+        typedef Cordic<1,15> QC;
+        OVF(QC::sincos(Q(0), qs, qc));
+        QC::sincos(Q(0), qs, qc, FRACT_OVERFLOW_SATURATE);
+        QCOMPARE(qc, (Q(int64_t(0x7FFF), 15)));
+        QCOMPARE(qs, Q(0));
+        F big(7), sh, ch;
+        OVF(C::sinhcosh(big, sh, ch));
+
+        // The phase of the null vector is zero
+        C::polar(F(0), F(0), sh, ch);
+        QCOMPARE(sh, F(0));
+        QCOMPARE(ch, F(0));
+    }
+
+    void function_table(void)
+    {
+        // Within the interpolation error (plus one unit) of the function,
+        // over the whole input range; arrays give the same results
+        typedef Fract<4,12> F;
+        typedef Fract<1,15> Q;
+        typedef FunctionTable<F, 64, Q> Clip;
+        Clip lin(soft_clip), quad(soft_clip, TABLE_QUADRATIC);
+        QCOMPARE(quad.interpolation(), TABLE_QUADRATIC);
+        std::vector<F> x(65536);
+        std::vector<Q> yl(65536), yq(65536);
+        for (int i=0;i<65536;i++)
+            x[i] = F(int64_t(i - 32768), 12);
+        lin(&x[0], &yl[0], 65536);
+        quad(&x[0], &yq[0], 65536);
+        for (int i=0;i<65536;i++)
+        {
+            double t = tanh(x[i].toDouble());
+            QVERIFY(fabs(yl[i].toDouble() - t) <= 0.0061);
+            QVERIFY(fabs(yq[i].toDouble() - t) <= 0.0005);
+            QCOMPARE(lin(x[i]), yl[i]);
+            QCOMPARE(quad(x[i]), yq[i]);
+        }
+
+        // f(1) is one unit above the largest output, which is fine for the
+        // last sample
+        FunctionTable<Q, 256> gamma(gamma_curve);
+        for (int i=-32768;i<32767;i++)
+        {
+            Q a(int64_t(i), 15), b(int64_t(i+1), 15);
+            QVERIFY(gamma(a).toDouble() <= gamma(b).toDouble());
+            if (i >= 8192)
+                QVERIFY(fabs(gamma(a).toDouble() - gamma_curve(a.toDouble())) <= 0.0001);
+        }
+        QCOMPARE(gamma(Q(0)), Q(0));
+
+        // int8_t formats; with N = 2^bits every input has its own sample
+        typedef Fract<4,4> B;
+        typedef Fract<2,6> C;
+        FunctionTable<B, 16, C> b16(soft_clip, TABLE_QUADRATIC);
+        FunctionTable<B, 256, C> b256(soft_clip);
+        std::vector<B> bx(256);
+        std::vector<C> by(256), bz(256);
+        for (int i=0;i<256;i++)
+            bx[i] = B(int64_t(i - 128), 4);
+        b16(&bx[0], &by[0], 256);
+        b256(&bx[0], &bz[0], 256);
+        for (int i=0;i<256;i++)
+        {
+            double t = tanh(bx[i].toDouble());
+            QCOMPARE(b16(bx[i]), by[i]);
+            QVERIFY(fabs(by[i].toDouble() - t) <= 0.03);
+            QVERIFY(bz[i].toDouble() <= t && t - bz[i].toDouble() < 1.0 / 64);
+        }
+
+        // Tables from given samples (here, with int64_t entries)
+        typedef Fract<8,8> G;
+        typedef Fract<16,16> H;
+        H s[17];
+        for (int k=0;k<=16;k++)
+            s[k] = H(k * 16 - 128);
+        FunctionTable<G, 16, H> id(s);
+        for (int i=-32768;i<32768;i+=7)
+            QCOMPARE(id(G(int64_t(i), 8)).toDouble(), G(int64_t(i), 8).toDouble());
+
+        // Samples and results which do not fit follow the policy
+        typedef FunctionTable<F, 16, Fract<2,14> > Narrow;
+        OVF(Narrow n(identity));
+        Narrow sat(identity, TABLE_LINEAR, FRACT_OVERFLOW_SATURATE);
+        Narrow wrap(identity, TABLE_LINEAR, FRACT_OVERFLOW_WRAP);
+        QCOMPARE(sat(F(3)), (Fract<2,14>(int64_t(0x7FFF), 14)));
+        QCOMPARE(sat(F(-3)), (Fract<2,14>(-2)));
+        QCOMPARE(wrap(F(3)), (Fract<2,14>(-1)));
+        QCOMPARE(sat(F(1)), (Fract<2,14>(1)));
+
+        typedef Fract<1,7> D;
+        D q[5];
+        q[0] = D(0);
+        q[1] = q[2] = q[3] = q[4] = D(int64_t(0x7F), 7);
+        typedef FunctionTable<B, 2, D> Over;
+        Over over(q, TABLE_QUADRATIC), over_sat(q, TABLE_QUADRATIC, FRACT_OVERFLOW_SATURATE);
+        std::vector<D> dy(256);
+        OVF(over(B(-2)));
+        OVF(over(&bx[0], &dy[0], 256));
+        over_sat(&bx[0], &dy[0], 256);
+        QCOMPARE(dy[128 - 32], D(int64_t(0x7F), 7));
+        QCOMPARE(dy[0], D(0));
+    }
+};
+
+class TestBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void gemm_benchmark_data(void)
+    {
+        QTest::addColumn<int>("impl");
+        QTest::newRow("naive") << 0;
+        QTest::newRow("gemm") << 1;
+        QTest::newRow("float") << 2;
+    }
+
+    void gemm_benchmark(void)
+    {
+        QFETCH(int, impl);
+        typedef Fract<16,16> F;
+        enum { N = 256 };
+        std::vector<F> a(N*N), b(N*N), c(N*N);
+        std::vector<float> fa(N*N), fb(N*N), fc(N*N);
+        for (int i=0;i<N*N;i++)
+        {
+            a[i] = F(int64_t(i * 2654435761u % 65536) - 32768, 16);
+            b[i] = F(int64_t(i * 2246822519u % 65536) - 32768, 16);
+            fa[i] = a[i].toFloat();
+            fb[i] = b[i].toFloat();
+        }
+
+        switch (impl)
+        {
+        case 0:
+            QBENCHMARK {
+                for (int i=0;i<N;i++)
+                    for (int j=0;j<N;j++)
+                    {
+                        F s = 0;
+                        for (int p=0;p<N;p++)
+                            s += a[i*N + p] * b[p*N + j];
+                        c[i*N + j] = s;
+                    }
+            }
+            break;
+        case 1:
+            QBENCHMARK {
+                ::gemm(N, N, N, &a[0], N, &b[0], N, &c[0], N);
+            }
+            break;
+        case 2:
+            // Reference SGEMM loop (i-p-j order, which the compiler vectorizes)
+            QBENCHMARK {
+                std::fill(fc.begin(), fc.end(), 0.0f);
+                for (int i=0;i<N;i++)
+                    for (int p=0;p<N;p++)
+                    {
+                        float x = fa[i*N + p];
+                        for (int j=0;j<N;j++)
+                            fc[i*N + j] += x * fb[p*N + j];
+                    }
+            }
+            break;
+        }
+    }
+
+    void sort_benchmark_data(void)
+    {
+        QTest::addColumn<int>("impl");
+        QTest::newRow("std::sort") << 0;
+        QTest::newRow("radix_sort") << 1;
+    }
+
+    void sort_benchmark(void)
+    {
+        QFETCH(int, impl);
+        typedef Fract<16,16> F;
+        enum { N = 1 << 20 };
+        std::vector<F> a(N), b(N);
+        for (int i=0;i<N;i++)
+            a[i] = F(int64_t(int32_t(i * 2654435761u)) >> (i % 7), 16);
+
+        QBENCHMARK {
+            b = a;
+            if (impl == 0)
+                std::sort(b.begin(), b.end());
+            else
+                radix_sort(&b[0], N);
+        }
+    }
 };
 
 int main(int argc, char *argv[])
@@ -350,6 +2145,18 @@ int main(int argc, char *argv[])
 
     TestGeom t3;
     QTest::qExec(&t3);
+
+    TestArray t4;
+    QTest::qExec(&t4);
+
+    TestLinalg t5;
+    QTest::qExec(&t5);
+
+    TestSignal t6;
+    QTest::qExec(&t6);
+
+    TestBench t7;
+    QTest::qExec(&t7);
 }
 
 #include "test.moc"
@@ -15,6 +15,29 @@ HEADERS += ../fixedpoint.h \
     ../fixedpoint/anyint.h \
     ../fixedpoint/lazyfract.h \
     ../fixedpoint/reciprocal.h \
+    ../fixedpoint/rsqrt.h \
+    ../fixedpoint/simd.h \
+    ../fixedpoint/parallel.h \
+    ../fixedpoint/dispatch.h \
+    ../fixedpoint/dispatch_kernels.h \
     ../fixedpoint_config.h \
-    ../fixedgeom.h
+    ../fixedgeom.h \
+    ../fixedray.h \
+    ../fixedgrid.h \
+    ../fixedpred.h \
+    ../fixedparticle.h \
+    ../fixedraster.h \
+    ../fixedarray.h \
+    ../fixedgemm.h \
+    ../fixedsort.h \
+    ../fixedfilter.h \
+    ../fixedfft.h \
+    ../fixedcordic.h \
+    ../fixedtable.h
 SOURCES += test.cpp
+
+# "qmake CONFIG+=simd" builds the same tests with the AVX2 kernels and OpenMP
+simd {
+    QMAKE_CXXFLAGS += -mavx2 -fopenmp
+    QMAKE_LFLAGS += -fopenmp
+}
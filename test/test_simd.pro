@@ -0,0 +1,10 @@
+# #####################################################################
+# The tests of test.pro, built with AVX2 and OpenMP: the vectorized kernels must
+# give the same results as the scalar ones, and the parallel kernels must not
+# depend on the number of threads (run it with different OMP_NUM_THREADS).
+# #####################################################################
+CONFIG += simd
+include(test.pro)
+TARGET = test_simd
+OBJECTS_DIR = simd
+MOC_DIR = simd